@@ -0,0 +1,388 @@
+/*
+ * bench.c: renders a fixed set of scenes offscreen with each program in our stack, and reports
+ *          how long they take, so that the cost of the shaders can be compared.  There's no
+ *          window; the GL context comes from EGL (without a display, on Mesa), so this runs on
+ *          machines without a GPU or X server (e.g. with LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe)
+ */
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "spot.h"
+#include "types.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#  define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#ifndef GL_TIME_ELAPSED
+#  define GL_TIME_ELAPSED 0x88BF
+#endif
+
+// NOTE: how many frames are drawn (and not timed) before the timed ones, so that shader
+//       compilation finishing, texture uploads etc. aren't counted
+#define BENCH_WARMUP 5
+#define BENCH_SIZE_MAX 8
+
+// NOTE: the programs of our stack (see contextGLInit in proj3.c), by their ID_* index
+static const char *benchNames[NUM_PROGRAMS] = {
+  [ID_CUBE] = "cube", [ID_SIMPLE] = "simple", [ID_PHONG] = "phong", [ID_TEXTURE] = "texture",
+  [ID_BUMP] = "bump", [ID_PARALLAX] = "parallax", [ID_SPOTLIGHT] = "spotlight"};
+
+enum BenchScenes {
+  SceneFull,   // one object covering the whole viewport: per-fragment cost
+  SceneMany,   // a grid of many small spheres: per-vertex and per-draw cost
+  SCENE_NUM
+};
+static const char *benchSceneNames[SCENE_NUM] = {"full", "many"};
+
+typedef struct {
+  int frames, grid;           // timed frames per measurement; spheres per side of the grid
+  int sizeNum, size[BENCH_SIZE_MAX]; // viewport sizes (square)
+  spotGeom *square, *sphere;
+  spotImage *rgb, *norm, *cube;
+  GLuint fbo, rbo[2];
+  GLuint irradiance;          // uniform buffer for the "Irradiance" block
+  int timer;                  // can use GL_TIME_ELAPSED queries
+} bench_t;
+
+// NOTE: makes a GL 3.2 core context current, without any window or surface; drawing goes to the
+//       framebuffer object from benchResize
+static int benchGLInit(void) {
+  const char me[]="benchGLInit";
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+  EGLDisplay dpy;
+  EGLContext egc;
+  EGLint major, minor;
+  EGLint attr[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+                   EGL_CONTEXT_MINOR_VERSION, 2,
+                   EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                   EGL_NONE};
+
+  getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+    eglGetProcAddress("eglGetPlatformDisplayEXT");
+  dpy = EGL_NO_DISPLAY;
+  if (getPlatformDisplay) {
+    dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (EGL_NO_DISPLAY == dpy) {
+    dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (EGL_NO_DISPLAY == dpy || !eglInitialize(dpy, &major, &minor)) {
+    spotErrorAdd("%s: couldn't initialize EGL (error 0x%x)", me, eglGetError());
+    return 1;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    spotErrorAdd("%s: EGL %d.%d can't do desktop OpenGL", me, major, minor);
+    return 1;
+  }
+  // NOTE: with EGL_KHR_no_config_context and EGL_KHR_surfaceless_context, which Mesa has, no
+  //       config or surface is needed
+  egc = eglCreateContext(dpy, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attr);
+  if (EGL_NO_CONTEXT == egc || !eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, egc)) {
+    spotErrorAdd("%s: couldn't create a surfaceless GL 3.2 core context (error 0x%x)", me,
+                 eglGetError());
+    return 1;
+  }
+  return 0;
+}
+
+// NOTE: (re)allocates the offscreen color and depth buffers at size x size
+static int benchResize(bench_t *bn, int size) {
+  const char me[]="benchResize";
+
+  if (!bn->fbo) {
+    glGenFramebuffers(1, &bn->fbo);
+    glGenRenderbuffers(2, bn->rbo);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, bn->fbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, bn->rbo[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, bn->rbo[0]);
+  glBindRenderbuffer(GL_RENDERBUFFER, bn->rbo[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, bn->rbo[1]);
+  if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER)) {
+    spotErrorAdd("%s: %dx%d framebuffer incomplete", me, size, size);
+    return 1;
+  }
+  glViewport(0, 0, size, size);
+  return 0;
+}
+
+static spotImage *benchImage(char *fname, int cubeMap) {
+  const char me[]="benchImage";
+  spotImage *image;
+
+  if (!( (image = spotImageNew())
+         && !spotImageLoadPNG(image, fname)
+         && !(cubeMap ? spotImageCubeMapGLInit(image) : spotImageGLInit(image)) )) {
+    spotErrorAdd("%s: couldn't set up \"%s\"", me, fname);
+    spotImageNix(image);
+    return NULL;
+  }
+  return image;
+}
+
+// NOTE: the same geometry, textures and (mostly) the same uniform values as proj3 uses, with an
+//       identity view and projection so that the scenes cover the viewport exactly
+static int benchSetup(bench_t *bn) {
+  const char me[]="benchSetup";
+  GLfloat sh[9][4];
+
+  if (!( (bn->square = spotGeomNewSquare()) && (bn->sphere = spotGeomNewSphere()) )) {
+    spotErrorAdd("%s: couldn't make geometry", me);
+    return 1;
+  }
+  spotGeomGLInit(bn->square);
+  spotGeomGLInit(bn->sphere);
+  if (!( (bn->rgb = benchImage("textimg/uchic-rgb.png", 0))
+         && (bn->norm = benchImage("textimg/uchic-norm08.png", 0))
+         && (bn->cube = benchImage("textimg/cube-sample.png", 1)) )) {
+    spotErrorAdd("%s: couldn't load textures (run from the proj3 directory)", me);
+    return 1;
+  }
+  // NOTE: the same texture units as contextRender uses, plus samplerB for the bump map
+  glActiveTexture(GL_TEXTURE0 + spotProj3Unit_cubeMap);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, bn->cube->textureId);
+  glActiveTexture(GL_TEXTURE0 + spotProj3Unit_samplerA);
+  glBindTexture(GL_TEXTURE_2D, bn->rgb->textureId);
+  glActiveTexture(GL_TEXTURE0 + spotProj3Unit_samplerB);
+  glBindTexture(GL_TEXTURE_2D, bn->norm->textureId);
+  glActiveTexture(GL_TEXTURE0);
+  // NOTE: white ambient light, which is what proj3 lights with when its cube map doesn't load
+  memset(sh, 0, sizeof(sh));
+  SPOT_V3_SET(sh[0], 1.0f, 1.0f, 1.0f);
+  bn->irradiance = spotProj3IrradianceNew(sizeof(sh), sh, GL_STATIC_DRAW);
+  bn->timer = (spotGLExtension("GL_ARB_timer_query")
+               || spotGLExtension("GL_EXT_timer_query"));
+  glEnable(GL_DEPTH_TEST);
+  return 0;
+}
+
+// NOTE: the uniforms that don't change from one object to the next
+static void benchUniforms(GLuint program) {
+  GLfloat ident[16], lightDir[3], len;
+
+  SPOT_M4_IDENTITY(ident);
+  glUniformMatrix4fv(glGetUniformLocation(program, "viewMatrix"), 1, GL_FALSE, ident);
+  glUniformMatrix4fv(glGetUniformLocation(program, "inverseViewMatrix"), 1, GL_FALSE, ident);
+  glUniformMatrix4fv(glGetUniformLocation(program, "projMatrix"), 1, GL_FALSE, ident);
+  SPOT_V3_SET(lightDir, 1.0f, 1.0f, 3.0f);
+  SPOT_V3_NORM(lightDir, lightDir, len);
+  glUniform3fv(glGetUniformLocation(program, "lightDir"), 1, lightDir);
+  glUniform3f(glGetUniformLocation(program, "lightColor"), 1.0f, 1.0f, 1.0f);
+  glUniform3f(glGetUniformLocation(program, "spotPoint"), 0.0f, 0.0f, 2.0f);
+  glUniform3f(glGetUniformLocation(program, "spotUp"), 0.0f, 1.0f, 0.0f);
+  glUniform1f(glGetUniformLocation(program, "penumbra"), 30.0f);
+  glUniform1f(glGetUniformLocation(program, "rStart"), 0.5f);
+  glUniform1f(glGetUniformLocation(program, "rEnd"), 4.0f);
+  glUniform3f(glGetUniformLocation(program, "objColor"), 0.8f, 0.6f, 0.4f);
+  glUniform1f(glGetUniformLocation(program, "Ka"), 0.2f);
+  glUniform1f(glGetUniformLocation(program, "Kd"), 0.6f);
+  glUniform1f(glGetUniformLocation(program, "Ks"), 0.4f);
+  glUniform1f(glGetUniformLocation(program, "shexp"), 50.0f);
+  // NOTE: as proj3 without -a: no texture array, so every object samples samplerA (the
+  //       samplers got their units from spotProj3ProgramLinked)
+  glUniform1i(glGetUniformLocation(program, "layer"), -1);
+}
+
+// NOTE: draws one frame of the given scene
+static void benchDraw(bench_t *bn, GLuint program, int scene) {
+  GLint mvpLoc, modelViewLoc, normalLoc, giLoc;
+  GLfloat model[16], normal[9], scl;
+  int ii, jj;
+
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  // NOTE: with identity view and projection, the model matrix is also the modelView and MVP
+  mvpLoc = glGetUniformLocation(program, "mvpMatrix");
+  modelViewLoc = glGetUniformLocation(program, "modelViewMatrix");
+  normalLoc = glGetUniformLocation(program, "normalMatrix");
+  giLoc = glGetUniformLocation(program, "gi");
+  SPOT_M3_IDENTITY(normal);
+  glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normal);
+  if (SceneFull == scene) {
+    SPOT_M4_IDENTITY(model);
+    glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, model);
+    glUniformMatrix4fv(modelViewLoc, 1, GL_FALSE, model);
+    glUniform1i(giLoc, 0);
+    spotGeomDraw(bn->square);
+    return;
+  }
+  // NOTE: z is scaled down so that the spheres stay inside the clip volume
+  scl = 0.9f/bn->grid;
+  for (jj=0; jj<bn->grid; jj++) {
+    for (ii=0; ii<bn->grid; ii++) {
+      SPOT_M4_SET(model,
+                  scl, 0.0f, 0.0f, -1.0f + (2*ii + 1)/(GLfloat)bn->grid,
+                  0.0f, scl, 0.0f, -1.0f + (2*jj + 1)/(GLfloat)bn->grid,
+                  0.0f, 0.0f, scl, 0.0f,
+                  0.0f, 0.0f, 0.0f, 1.0f);
+      glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, model);
+      glUniformMatrix4fv(modelViewLoc, 1, GL_FALSE, model);
+      glUniform1i(giLoc, (ii + jj) % 3);
+      spotGeomDraw(bn->sphere);
+    }
+  }
+}
+
+// NOTE: times bn->frames frames of the scene: on the GPU with timer queries (if there are any),
+//       on the CPU for issuing the GL calls, and in all (with a glFinish).  The results are in
+//       milliseconds per frame; gpu is -1 without timer queries
+static int benchMeasure(bench_t *bn, GLuint program, int scene,
+                        double *gpu, double *cpu, double *wall) {
+  const char me[]="benchMeasure";
+  GLuint *query;
+  GLuint64 elapsed;
+  double time0, time1;
+  int ff;
+
+  query = NULL;
+  if (bn->timer) {
+    if (!( query = (GLuint *)calloc(bn->frames, sizeof(GLuint)) )) {
+      spotErrorAdd("%s: allocation failure", me);
+      return 1;
+    }
+    glGenQueries(bn->frames, query);
+  }
+  glUseProgram(program);
+  benchUniforms(program);
+  for (ff=0; ff<BENCH_WARMUP; ff++) {
+    benchDraw(bn, program, scene);
+  }
+  glFinish();
+  *cpu = 0;
+  time0 = spotTime();
+  for (ff=0; ff<bn->frames; ff++) {
+    time1 = spotTime();
+    if (query) {
+      glBeginQuery(GL_TIME_ELAPSED, query[ff]);
+    }
+    benchDraw(bn, program, scene);
+    if (query) {
+      glEndQuery(GL_TIME_ELAPSED);
+    }
+    *cpu += spotTime() - time1;
+  }
+  glFinish();
+  *wall = 1000*(spotTime() - time0)/bn->frames;
+  *cpu = 1000*(*cpu)/bn->frames;
+  *gpu = -1;
+  if (query) {
+    *gpu = 0;
+    for (ff=0; ff<bn->frames; ff++) {
+      glGetQueryObjectui64v(query[ff], GL_QUERY_RESULT, &elapsed);
+      *gpu += elapsed/1000000.0;
+    }
+    *gpu /= bn->frames;
+    glDeleteQueries(bn->frames, query);
+    free(query);
+  }
+  if (GL_NO_ERROR != glGetError()) {
+    spotErrorAdd("%s: GL error drawing", me);
+    return 1;
+  }
+  return 0;
+}
+
+void usage(const char *me) {
+  fprintf(stderr, "usage: %s [-n <frames>] [-g <grid>] [-s <size>]... [<program>...]\n", me);
+  fprintf(stderr, "\tFor each of our programs (or just those named: cube, simple, phong,\n");
+  fprintf(stderr, "\ttexture, bump, parallax, spotlight), time <frames> frames (default 20)\n");
+  fprintf(stderr, "\tof an object covering the viewport, and of a <grid>x<grid> (default 8x8)\n");
+  fprintf(stderr, "\tgrid of spheres, at each square viewport <size> (default 256,\n");
+  fprintf(stderr, "\t512 and 1024). Times are milliseconds per frame: on the GPU (from\n");
+  fprintf(stderr, "\ttimer queries), on the CPU for issuing the GL calls, and overall.\n");
+}
+
+int main(int argc, const char *argv[]) {
+  const char *me;
+  bench_t bn;
+  int want[NUM_PROGRAMS], id, si, scene, any;
+  GLint program;
+  spotProgramJob *job;
+  double gpu, cpu, wall;
+  char gpuStr[32], vert[64], frag[64];
+
+  me = argv[0];
+  memset(&bn, 0, sizeof(bn));
+  bn.frames = 20;
+  bn.grid = 8;
+  memset(want, 0, sizeof(want));
+  any = 0;
+  for (argv++, argc--; argc > 0; argv++, argc--) {
+    if (argc > 1 && !strcmp(argv[0], "-n")) {
+      bn.frames = atoi((++argv)[0]); argc--;
+    } else if (argc > 1 && !strcmp(argv[0], "-g")) {
+      bn.grid = atoi((++argv)[0]); argc--;
+    } else if (argc > 1 && !strcmp(argv[0], "-s") && bn.sizeNum < BENCH_SIZE_MAX) {
+      bn.size[bn.sizeNum++] = atoi((++argv)[0]); argc--;
+    } else {
+      for (id=0; id<NUM_PROGRAMS && strcmp(argv[0], benchNames[id]); id++);
+      if (id == NUM_PROGRAMS) {
+        usage(me);
+        exit(1);
+      }
+      want[id] = any = 1;
+    }
+  }
+  if (bn.frames < 1 || bn.grid < 1) {
+    usage(me);
+    exit(1);
+  }
+  if (!bn.sizeNum) {
+    bn.size[bn.sizeNum++] = 256;
+    bn.size[bn.sizeNum++] = 512;
+    bn.size[bn.sizeNum++] = 1024;
+  }
+
+  if (benchGLInit() || benchSetup(&bn)) {
+    fprintf(stderr, "%s: set-up problem:\n", me);
+    spotErrorPrint(); spotErrorClear();
+    exit(1);
+  }
+  printf("# %s, %s\n", (const char *)glGetString(GL_RENDERER),
+         (const char *)glGetString(GL_VERSION));
+  printf("# %d frames each; ms/frame%s\n", bn.frames,
+         bn.timer ? "" : " (no timer queries, so no gpu times)");
+  printf("%-10s %-5s %9s %9s %9s %9s\n", "program", "scene", "size", "gpu", "cpu", "wall");
+  for (id=0; id<NUM_PROGRAMS; id++) {
+    if (any && !want[id]) {
+      continue;
+    }
+    sprintf(vert, "%s.vert", benchNames[id]);
+    sprintf(frag, "%s.frag", benchNames[id]);
+    // NOTE: built and set up as contextProgramSubmit and contextProgramLearn do
+    job = spotProj3ProgramSubmitTo(0, NULL, vert, frag);
+    program = job ? spotProgramFinish(job) : 0;
+    if (!program) {
+      fprintf(stderr, "%s: couldn't build %s, skipping it:\n", me, benchNames[id]);
+      spotErrorPrint(); spotErrorClear();
+      continue;
+    }
+    spotProj3ProgramLinked(program);
+    for (si=0; si<bn.sizeNum; si++) {
+      if (benchResize(&bn, bn.size[si])) {
+        fprintf(stderr, "%s: problem:\n", me);
+        spotErrorPrint(); spotErrorClear();
+        exit(1);
+      }
+      for (scene=0; scene<SCENE_NUM; scene++) {
+        if (benchMeasure(&bn, program, scene, &gpu, &cpu, &wall)) {
+          fprintf(stderr, "%s: trouble with %s:\n", me, benchNames[id]);
+          spotErrorPrint(); spotErrorClear();
+          continue;
+        }
+        if (gpu < 0) {
+          strcpy(gpuStr, "-");
+        } else {
+          sprintf(gpuStr, "%.3f", gpu);
+        }
+        printf("%-10s %-5s %4dx%-4d %9s %9.3f %9.3f\n", benchNames[id], benchSceneNames[scene],
+               bn.size[si], bn.size[si], gpuStr, cpu, wall);
+        fflush(stdout);
+      }
+    }
+    glDeleteProgram(program);
+  }
+  return 0;
+}
@@ -2,10 +2,8 @@
 
 // Vertex shader for bump mapping 
 
-uniform mat4 modelMatrix;
+uniform mat4 mvpMatrix;        // projMatrix * viewMatrix * modelMatrix
 uniform mat3 normalMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
 uniform vec3 objColor;
 
 in vec4 vertPos;
@@ -20,7 +18,7 @@ out vec3 vnrm;
 void main() {
 
   // transform vertices 
-  gl_Position = projMatrix * viewMatrix * modelMatrix * vertPos;
+  gl_Position = mvpMatrix * vertPos;
 
   // set texture coordinates
   texCoord = vertTex2;
@@ -16,11 +16,21 @@ extern context_t *gctx;
 extern void setScene(int i);
 extern int contextDraw(context_t *ctx);
 extern int perVertexTexturing();
-extern void setUnilocs();
-extern int programIds[NUM_PROGRAMS+1];
-extern const char *vertFnames[NUM_PROGRAMS], *fragFnames[NUM_PROGRAMS];
+extern int programIds[PROGRAM_SLOTS];
+extern const char *vertFnames[NUM_PROGRAMS+1], *fragFnames[NUM_PROGRAMS+1];
+extern GLuint contextProgram(context_t *ctx, int id);
 extern int updateTweakBarVars(int scene);
 extern int sceneGeomOffset;
+extern void contextInput(context_t *ctx, const input_t *ev);
+extern void contextRequest(context_t *ctx, int req);
+extern void contextLock(context_t *ctx);
+extern void contextUnlock(context_t *ctx);
+extern void contextWant(context_t *ctx, int stop);
+
+// NOTE: whether mouse motion is ours (since a mouse button went down outside the tweak bar) or
+//       AntTweakBar's; this mirrors gctx->buttonDown, but belongs to the thread getting the GLFW
+//       callbacks, since gctx->buttonDown may be changed later by the update thread
+static int appButton = 0;
 
 #include <AntTweakBar.h>
 
@@ -28,57 +38,53 @@ extern int sceneGeomOffset;
 #define DOWN 284
 #define LEFT 285
 #define RIGHT 286
+// NOTE: the GLFW callbacks below run wherever GLFW calls them (the main thread, which does the
+//       rendering). They give AntTweakBar first pass at each event, and pass on the rest, with
+//       whatever GLFW state they need, to contextInput, which either handles them right away with
+//       the handle* functions, or queues them for the update thread to handle
 void callbackKeyboard(int key, int action)
 {
+  input_t ev;
+  int handled;
+
+  // NOTE: any input may change what's on screen (even if only in the tweak bar)
+  gctx->dirty = 1;
   /* give AntTweakBar first pass at handling with key event */
-  if (TwEventKeyGLFW(key, action)) {
+  contextLock(gctx);
+  handled = TwEventKeyGLFW(key, action);
+  contextUnlock(gctx);
+  if (handled) {
     /* the event was handled by AntTweakBar; nothing more for us to do */
+    contextInput(gctx, NULL);
     return;
   }
+  ev.type = InputKey;
+  ev.a = key;
+  ev.b = action;
+  ev.time = spotTime();
+  contextInput(gctx, &ev);
+}
 
-  FILE *file;
-  spotImage *shot;
-  int test, testMax=99999;
-  char fname[128]; /* long enough to hold filename */
+void handleKey(const input_t *ev)
+{
+  spotGeom *geom;
+  int key=ev->a, action=ev->b;
     
+  // NOTE: this may run on the update thread, so anything needing the GL context or the tweak bar
+  //       goes through contextRequest; in particular, changing gctx->program is enough, since
+  //       contextRender swaps in the new program's uniform locations
   if (GLFW_PRESS != action) {
     GLfloat v;
     switch (key) {
+      // Save the next frame (contextCapture reads it back, on the render thread)
       case 'D':
-        shot = spotImageNew();
-        /* copy image from render window; last argument controls whether
-           image is retreived with (SPOT_TRUE) or without (SPOT_FALSE) an
-           alpha channel */
-        if (spotImageScreenshot(shot, SPOT_TRUE)) {
-          //fprintf(stderr, "%s: trouble getting image:\n", me);
-          spotErrorPrint(); spotErrorClear();
-          break;
-        }
-        /* find unused filename */
-        for (test=0, file=NULL; test<=testMax; test++) {
-          /* feel free to change the filename format used here! */
-          sprintf(fname, "%05d.png", test);
-          if (!(file = fopen(fname, "rb"))) {
-            /* couldn't open fname => it didn't exist => we can use fname, done */
-            break;
-          }
-          /* else we *could* open it => already used => close it try again */
-          fclose(file);
-          file = NULL;
-        }
-        if (test > testMax) {
-          //fprintf(stderr, "%s: unable to find unused filename to write to!", me);
-          spotImageNix(shot);
-          break;
-        }
-        /* save image */
-        if (spotImageSavePNG(fname, shot)) {
-          //fprintf(stderr, "%s: trouble saving to %s:\n", me, fname);
-          spotImageNix(shot); spotErrorPrint(); spotErrorClear();
-          break;
-        }
-        spotImageNix(shot);
-      break;
+        contextRequest(gctx, RequestScreenshot);
+        break;
+
+      // Start or stop saving every frame
+      case 'R':
+        contextRequest(gctx, RequestRecord);
+        break;
 
       // Quit the application
       case 'Q': gctx->running=0; break;
@@ -92,7 +98,7 @@ void callbackKeyboard(int key, int action)
       case 'P':
         gctx->camera.ortho ^= 1;
         fprintf(stderr, gctx->camera.ortho ? "Orthographic\n" : "Perspective\n");
-        callbackResize(gctx->winSizeX, gctx->winSizeY);
+        handleResize(gctx->winSizeX, gctx->winSizeY);
         break;
 
       // Enter View Mode
@@ -171,23 +177,25 @@ void callbackKeyboard(int key, int action)
       // Describe and display scene 1
       case '1':
         sceneGeomOffset=0;
-        gctx->program=programIds[ID_PHONG];
+        gctx->program=contextProgram(gctx, ID_PHONG);
         gctx->gouraudMode=1;
-        setUnilocs();
-        updateTweakBarVars(1);
+        gctx->tweakBarScene = 1;
+        contextRequest(gctx, RequestTweakBar);
         fprintf(stderr, "Setting scene 1: Demonstrating model, view and orthographic view transoforms\n");
         break;
 
       // Describe and display scene 2
       case '2':
-        gctx->geom[0]->Ka=0.3;
+        if ((geom = spotPoolGet(gctx->geom, gctx->objectH[Sphere]))) {
+          geom->Ka=0.3;
+        }
         sceneGeomOffset=0;
         gctx->seamFix = 0;
         gctx->perVertexTexturingMode = 1;
-        perVertexTexturing();
-        gctx->program=programIds[ID_SIMPLE];
-        setUnilocs();
-        updateTweakBarVars(2);
+        contextRequest(gctx, RequestPerVertexTexturing);
+        gctx->program=contextProgram(gctx, ID_SIMPLE);
+        gctx->tweakBarScene = 2;
+        contextRequest(gctx, RequestTweakBar);
         fprintf(stderr, "Setting scene 2: Demonstrating perspective transform\n");
         break;
 
@@ -197,18 +205,18 @@ void callbackKeyboard(int key, int action)
         gctx->magFilter = GL_NEAREST;
         sceneGeomOffset=1;
         gctx->filteringMode = Nearest;
-        gctx->program=programIds[ID_TEXTURE];
-        setUnilocs();
-        updateTweakBarVars(3);
+        gctx->program=contextProgram(gctx, ID_TEXTURE);
+        gctx->tweakBarScene = 3;
+        contextRequest(gctx, RequestTweakBar);
         fprintf(stderr, "Setting scene 3: filtering modes\n"); 
         break;
 
       case '4':
         sceneGeomOffset=0;
         gctx->bumpMappingMode=Disabled;
-        gctx->program=programIds[ID_TEXTURE];
-        setUnilocs();
-        updateTweakBarVars(4);
+        gctx->program=contextProgram(gctx, ID_TEXTURE);
+        gctx->tweakBarScene = 4;
+        contextRequest(gctx, RequestTweakBar);
         fprintf(stderr, "Setting scene 4");
         break;
 
@@ -224,24 +232,44 @@ void callbackKeyboard(int key, int action)
 #define HORIZONTAL 0
 void callbackMouseButton(int button, int action)
 {
+  input_t ev;
+  int handled;
+
+  gctx->dirty = 1;
   /* give AntTweakBar first pass at handling mouse event */
-  if (TwEventMouseButtonGLFW(button, action)) {
+  contextLock(gctx);
+  handled = TwEventMouseButtonGLFW(button, action);
+  contextUnlock(gctx);
+  if (handled) {
     /* AntTweakBar has handled event, nothing more for us to do,
        not even recording buttonDown */
+    contextInput(gctx, NULL);
     return;
   }
+  appButton = GLFW_PRESS == action;
+  ev.type = InputMouseButton;
+  ev.a = button;
+  ev.b = action;
+  ev.shift = GLFW_PRESS == glfwGetKey(GLFW_KEY_LSHIFT)
+          || GLFW_PRESS == glfwGetKey(GLFW_KEY_RSHIFT);
+  glfwGetMousePos(&ev.x, &ev.y);
+  ev.time = spotTime();
+  contextInput(gctx, &ev);
+}
 
-  (void)(button);
+void handleMouseButton(const input_t *ev)
+{
+  int action=ev->b;
   int xx, yy;
   float xf, yf;
   gctx->buttonDown = 1;
-  gctx->shiftDown = GLFW_PRESS == glfwGetKey(GLFW_KEY_LSHIFT)
-                 || GLFW_PRESS == glfwGetKey(GLFW_KEY_RSHIFT);
-  glfwGetMousePos(&xx, &yy);
+  gctx->shiftDown = ev->shift;
+  xx = ev->x;
+  yy = ev->y;
   gctx->lastX = xx;
   gctx->lastY = yy;
 
-  gctx->mouseFun.m = gctx->geom[0]->modelMatrix; // To be overwritten
+  gctx->mouseFun.m = NULL; // To be overwritten
   gctx->mouseFun.f = identity;
   gctx->mouseFun.offset = 0;
   gctx->mouseFun.multiplier = 1;
@@ -278,11 +306,12 @@ void callbackMouseButton(int button, int action)
       } else {
         if (gctx->modelMode) {
           printf(" ... (move M) translates object along N\n");
-          gctx->mouseFun.m = gctx->geom[gctx->gi]->modelMatrix;
+          gctx->mouseFun.m = NULL; // translate_model_N finds gctx->gi itself
           gctx->mouseFun.f = translate_model_N;
           gctx->mouseFun.multiplier = 4;
-          int j; for (j=0; j<gctx->geomNum; j++) {
-            updateNormals(gctx->geom[j]->normalMatrix, gctx->geom[j]->modelMatrix);
+          int j; for (j=0; j<gctx->geom->num; j++) {
+            spotGeom *geom = spotPoolItem(gctx->geom, j);
+            updateNormals(geom->normalMatrix, geom->modelMatrix);
           }
         } else if (gctx->viewMode) {
           printf(" ... (move V) translates eye and look-at along N\n");
@@ -300,7 +329,7 @@ void callbackMouseButton(int button, int action)
           gctx->mouseFun.f = scale_1D;
           gctx->mouseFun.offset = 1;
           gctx->mouseFun.multiplier = 0.25;
-          callbackResize(gctx->winSizeX, gctx->winSizeY);
+          handleResize(gctx->winSizeX, gctx->winSizeY);
         }
       } else {
         printf(" ... (mode V) shrinks or grows (far distance) - (near distance)\n");
@@ -345,7 +374,7 @@ void callbackMouseButton(int button, int action)
           gctx->mouseFun.multiplier = -4;
         } else if (gctx->modelMode) {
           printf(" ... (mode M) translates object along U and V\n");
-          gctx->mouseFun.m = gctx->geom[gctx->gi]->modelMatrix;
+          gctx->mouseFun.m = NULL; // translate_model_UV finds gctx->gi itself
           gctx->mouseFun.f = translate_model_UV;
           gctx->mouseFun.multiplier = 4;
         }
@@ -357,10 +386,30 @@ void callbackMouseButton(int button, int action)
 }
 
 void callbackMousePos(int xx, int yy)
+{
+  input_t ev;
+
+  gctx->dirty = 1;
+  if (appButton) {
+    ev.type = InputMousePos;
+    ev.x = xx;
+    ev.y = yy;
+    ev.time = spotTime();
+    contextInput(gctx, &ev);
+  } else {
+    contextLock(gctx);
+    TwEventMousePosGLFW(xx, yy);
+    contextUnlock(gctx);
+    contextInput(gctx, NULL);
+  }
+}
+
+void handleMousePos(const input_t *ev)
 {
   GLfloat s[5];
+  int xx=ev->x, yy=ev->y;
     // animation
-    double toc = spotTime();
+    double toc = ev->time;
     if (gctx->ticMouse == -1)
       gctx->ticMouse = toc;
 
@@ -411,30 +460,69 @@ void callbackMousePos(int xx, int yy)
     //       this produces better motion.
     gctx->lastX = xx;
     gctx->lastY = yy;
-  } else {
-    TwEventMousePosGLFW(xx, yy);
   }
 }
 
 void callbackResize(int w, int h)
 {
   const char me[]="callbackResize";
-  char buff[128];
-
-  // Recalculated w and h values (using camera aspect ratio and fov); for projection matrix
-  GLfloat wf, hf; 
+  input_t ev;
 
   // NOTE: glfwSetWindowSizeCallback sometimes sends negative numbers, causing the program to
   //       crash. To counteract this, clamp w and h above 0.
   // NOTE: Still doesn't fix it... seems to bug out only when glfwSwapBuffers gets called...
   if (w<=0) w = 1;
   if (h<=0) h = 1;
+  gctx->dirty = 1;
 
   /* Set Viewport to window dimensions */
   glViewport(0, 0, w, h);
   /* let AntTweakBar know about new window dimensions */
   TwWindowSize(w, h);
 
+  ev.type = InputResize;
+  ev.a = w;
+  ev.b = h;
+  ev.time = spotTime();
+  contextInput(gctx, &ev);
+
+  if (gctx->threaded) {
+    // NOTE: the new frame will come from the update thread soon enough
+    return;
+  }
+  /* redraw now with new window size to permit feedback during resizing */
+  if (contextDraw(gctx)) {
+    fprintf(stderr, "%s: trouble drawing during resize:\n", me);
+    spotErrorPrint();
+    spotErrorClear();
+    gctx->running = 0;
+  }
+  if (!TwDraw()) {
+    fprintf(stderr, "%s: AntTweakBar error: %s\n", me, TwGetLastError());
+    gctx->running = 0;
+  }
+  glfwSwapBuffers();
+  return;
+}
+
+// NOTE: the window was exposed or restored, so what's on screen is stale; in on-demand mode
+//       nothing else would redraw it. With -t, the update thread is asked for a frame too, so
+//       that the redraw isn't of one made before the window went away
+void callbackRefresh(void)
+{
+  gctx->dirty = 1;
+  if (gctx->threaded) {
+    contextWant(gctx, 0);
+  }
+}
+
+// NOTE: the part of resizing that doesn't involve GL; this is also called (with the current
+//       size) whenever something else about the projection changes
+void handleResize(int w, int h)
+{
+  // Recalculated w and h values (using camera aspect ratio and fov); for projection matrix
+  GLfloat wf, hf; 
+
   gctx->winSizeX = w;
   gctx->winSizeY = h;
 
@@ -455,6 +543,13 @@ void callbackResize(int w, int h)
   //hf = 1
   updateProj(gctx->camera.proj, wf, hf, gctx->camera.near, gctx->camera.far, gctx->camera.ortho);
 
+  contextRequest(gctx, RequestTweakBarPos);
+}
+
+void tweakBarPlace(void)
+{
+  char buff[128];
+
   /* By default the tweak bar maintains its position relative to the
      LEFT edge of the window, which we are using for camera control.
      So, move the tweak bar to a new position, fixed relative to RIGHT
@@ -464,20 +559,43 @@ void callbackResize(int w, int h)
           gctx->winSizeX - gctx->tbarSizeX - gctx->tbarMargin,
           gctx->tbarMargin);
   TwDefine(buff);
+}
 
-  /* redraw now with new window size to permit feedback during resizing */
-  if (contextDraw(gctx)) {
-    fprintf(stderr, "%s: trouble drawing during resize:\n", me);
-    spotErrorPrint();
-    spotErrorClear();
-    gctx->running = 0;
-  }
-  if (!TwDraw()) {
-    fprintf(stderr, "%s: AntTweakBar error: %s\n", me, TwGetLastError());
-    gctx->running = 0;
+void handleInput(const input_t *ev)
+{
+  switch (ev->type) {
+    case InputKey: handleKey(ev); break;
+    case InputMouseButton: handleMouseButton(ev); break;
+    case InputMousePos: handleMousePos(ev); break;
+    case InputResize: handleResize(ev->a, ev->b); break;
   }
-  glfwSwapBuffers();
-  return;
+}
+
+// NOTE: these just pass events on to AntTweakBar, noting that a redraw is needed
+void callbackMouseWheel(int pos)
+{
+  gctx->dirty = 1;
+  contextLock(gctx);
+  TwEventMouseWheelGLFW(pos);
+  contextUnlock(gctx);
+  contextInput(gctx, NULL);
+}
+
+void callbackChar(int character, int action)
+{
+  gctx->dirty = 1;
+  contextLock(gctx);
+  TwEventCharGLFW(character, action);
+  contextUnlock(gctx);
+  contextInput(gctx, NULL);
+}
+
+// NOTE: these scenes were written for a fixed array of objects; geoms are now pooled, so we
+//       address them by their current (dense) position, and the object is NULL when there
+//       aren't that many (which translateGeom* and friends ignore)
+static spotGeom *sceneGeom(int i)
+{
+  return spotPoolItem(gctx->geom, i);
 }
 
 void setScene(int sceneNum)
@@ -486,24 +604,24 @@ void setScene(int sceneNum)
 
   if (sceneNum == 1) {
 
-    for (i = 0; i < gctx->geomNum; i ++) {
+    for (i = 0; i < gctx->geom->num; i ++) {
       // set each object to be the same size
-      SPOT_M4_IDENTITY(gctx->geom[i]->modelMatrix);
-      scaleGeom(gctx->geom[i], 0.125);
+      SPOT_M4_IDENTITY(sceneGeom(i)->modelMatrix);
+      scaleGeom(sceneGeom(i), 0.125);
     }
 
     // set objects so that there is one on each axis
                                          // Red: is in the center
-    translateGeomN(gctx->geom[6],  2.5); // Yellow: placing in the back
-    translateGeomU(gctx->geom[2],  2.5); // Orange: placing on the right
-    translateGeomV(gctx->geom[3], -2.5); // Green: placing on the bottom
-    translateGeomU(gctx->geom[4], -2.5); // Blue: placing on left
-    translateGeomN(gctx->geom[5], -2.5); // Purple: placing in the front 
-    translateGeomV(gctx->geom[1],  2.5); // White: placing on top
+    translateGeomN(sceneGeom(6),  2.5); // Yellow: placing in the back
+    translateGeomU(sceneGeom(2),  2.5); // Orange: placing on the right
+    translateGeomV(sceneGeom(3), -2.5); // Green: placing on the bottom
+    translateGeomU(sceneGeom(4), -2.5); // Blue: placing on left
+    translateGeomN(sceneGeom(5), -2.5); // Purple: placing in the front 
+    translateGeomV(sceneGeom(1),  2.5); // White: placing on top
 
     // set to orthographic mode
     gctx->camera.ortho = 1;
-    callbackResize(gctx->winSizeX, gctx->winSizeY);
+    handleResize(gctx->winSizeX, gctx->winSizeY);
 
     // move from so that overlooks objects
     gctx->camera.from[0] = 1;
@@ -515,18 +633,18 @@ void setScene(int sceneNum)
 
   } else if (sceneNum == 2) {
 
-    for (i = 0; i < gctx->geomNum; i ++) {
+    for (i = 0; i < gctx->geom->num; i ++) {
       // set each object to be the same size
-      SPOT_M4_IDENTITY(gctx->geom[i]->modelMatrix);
-      scaleGeom(gctx->geom[i], 0.125);
+      SPOT_M4_IDENTITY(sceneGeom(i)->modelMatrix);
+      scaleGeom(sceneGeom(i), 0.125);
 
       // set each object farther and farther away
-      translateGeomN(gctx->geom[i], i*5);
+      translateGeomN(sceneGeom(i), i*5);
     }
 
     // set to perspective mode
     gctx->camera.ortho = 0;
-    callbackResize(gctx->winSizeX, gctx->winSizeY);
+    handleResize(gctx->winSizeX, gctx->winSizeY);
 
     // move from so that puts objects along a path
     gctx->camera.from[0] = 0.75;
@@ -537,31 +655,32 @@ void setScene(int sceneNum)
       "To ensure that prospective transform is correct, the best way to look at objects right behind each other. Thus the arrangement here is all of our objects in a row, one after another, looking at them almost head on. Note that each object is the same size, yet in the picture the objects get smaller as they are placed farther back.");
   } else if (sceneNum == 3) {
 
-    for (i = 0; i < gctx->geomNum; i ++) {
-      SPOT_M4_IDENTITY(gctx->geom[i]->modelMatrix);
+    for (i = 0; i < gctx->geom->num; i ++) {
+      SPOT_M4_IDENTITY(sceneGeom(i)->modelMatrix);
 
       // set each object except for the sphere and ellipsoid to dissapear 
       if (i != 0 && i != 1) {
-        scaleGeom(gctx->geom[i], 0);
+        scaleGeom(sceneGeom(i), 0);
       } else {
-        scaleGeom(gctx->geom[i], 0.125);
+        scaleGeom(sceneGeom(i), 0.125);
       }
     }
 
-    translateGeomV(gctx->geom[1], 1);
+    translateGeomV(sceneGeom(1), 1);
 
     // scale the sphere by 1.0 along the X, 0.5 along the Y, 0.2 along the Z
-    scaleGeomX(gctx->geom[1], 1);
-    scaleGeomY(gctx->geom[1], 0.5);
-    scaleGeomZ(gctx->geom[1], 0.2);
+    scaleGeomX(sceneGeom(1), 1);
+    scaleGeomY(sceneGeom(1), 0.5);
+    scaleGeomZ(sceneGeom(1), 0.2);
 
     // set both to the same color
-    SPOT_V3_SET(gctx->geom[0]->objColor, 1.0f, 0.0f, 0.0f); // Red
-    SPOT_V3_SET(gctx->geom[1]->objColor, 1.0f, 0.0f, 0.0f); // Red
+    for (i = 0; i < 2 && i < gctx->geom->num; i ++) {
+      SPOT_V3_SET(sceneGeom(i)->objColor, 1.0f, 0.0f, 0.0f); // Red
+    }
 
     // set to orthographic mode
     gctx->camera.ortho = 1;
-    callbackResize(gctx->winSizeX, gctx->winSizeY);
+    handleResize(gctx->winSizeX, gctx->winSizeY);
 
     // set from so that overlooks objects
     gctx->camera.from[0] = 0;
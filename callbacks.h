@@ -19,12 +19,24 @@ extern "C" {
 #define GLFW_NO_GLU /* Also, tell glfw.h not to include GLU header */
 #include <GL/glfw.h>
 
+#include "types.h"
+
 void callbackKeyboard(int key, int action);
 void callbackMouseButton(int button, int action);
 void callbackMousePos(int xx, int yy);
 void callbackResize(int w, int h);
+void callbackRefresh(void);
+void callbackMouseWheel(int pos);
+void callbackChar(int character, int action);
 void setScene(int sceneNum);
 
+void handleInput(const input_t *ev);
+void handleKey(const input_t *ev);
+void handleMouseButton(const input_t *ev);
+void handleMousePos(const input_t *ev);
+void handleResize(int w, int h);
+void tweakBarPlace(void);
+
 #ifdef __cplusplus
 }
 #endif
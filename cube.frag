@@ -4,8 +4,16 @@
 
 #define PI_INV 0.31830988618379067153776752674 
 
+#ifdef GOURAUD_MODE
+const int gouraudMode = GOURAUD_MODE;
+#else
 uniform int gouraudMode;
+#endif
+#ifdef SEAM_FIX
+const int seamFix = SEAM_FIX;
+#else
 uniform int seamFix;
+#endif
 uniform int gi;
 uniform vec3 lightDir;
 uniform vec3 lightColor;
@@ -31,7 +39,15 @@ uniform mat4 inverseViewMatrix;
 void main() {
 
 //	color = texture(cubeMap, texCoord);
-	color.rgb = texture(cubeMap, (inverseViewMatrix * vec4(reflect(fromEye, vnrm),1.0)).xyz).rgb;
+	vec3 dir = normalize((inverseViewMatrix * vec4(reflect(fromEye, vnrm),1.0)).xyz);
+	// level i of the cube map is prefiltered for GGX roughness i/(levels-1), so the roughness
+	// matching our Phong highlights picks the level: pow(N.R, shexp) is about a Blinn-Phong lobe
+	// with exponent 4*shexp, which is GGX with alpha^2 = 2/(4*shexp+2). Where the reflection
+	// changes quickly, the level is no finer than the footprint of the pixel
+	float size = float(textureSize(cubeMap, 0).x);
+	float roughness = sqrt(sqrt(2.0/(4.0*shexp + 2.0)));
+	float lodMin = log2(max(length(dFdx(dir)), length(dFdy(dir)))*0.5*size);
+	color.rgb = textureLod(cubeMap, dir, max(lodMin, roughness*log2(size))).rgb;
 
 }
 
@@ -4,13 +4,20 @@
 
 #define PI 3.14159265358979323846264338327
 
+#ifdef GOURAUD_MODE
+const int gouraudMode = GOURAUD_MODE;
+#else
 uniform int gouraudMode;
+#endif
+#ifdef SEAM_FIX
+const int seamFix = SEAM_FIX;
+#else
 uniform int seamFix;
-uniform mat4 modelMatrix;
+#endif
+uniform mat4 modelViewMatrix;  // viewMatrix * modelMatrix
+uniform mat4 mvpMatrix;        // projMatrix * viewMatrix * modelMatrix
 uniform mat3 normalMatrix;
-uniform mat4 viewMatrix;
 uniform mat4 inverseViewMatrix;
-uniform mat4 projMatrix;
 uniform vec3 lightDir;  // assumed to be unit-length (already normalized)
 uniform vec3 lightColor;
 uniform vec3 objColor;
@@ -33,7 +40,7 @@ out vec3 fromEye;
 void main() {
 
 	vnrm = normalMatrix * vertNorm;
-	vec4 vVert4 = viewMatrix * modelMatrix * vertPos;
+	vec4 vVert4 = modelViewMatrix * vertPos;
 	vec3 vEyeVertex = normalize(vVert4.xyz / vVert4.w);
 	vec4 vCoords = vec4(reflect(vEyeVertex, vnrm), 1.0);
 	vCoords = inverseViewMatrix * vCoords;
@@ -42,7 +49,7 @@ void main() {
 	fromEye = vEyeVertex;
 
   // transform vertices 
-  gl_Position = projMatrix * viewMatrix * modelMatrix * vertPos;
+  gl_Position = mvpMatrix * vertPos;
 
 //	texCoord = normalize(vertPos.xyz);
 
@@ -4,12 +4,18 @@
 
 #define PI_INV 0.31830988618379067153776752674 
 
+#ifdef GOURAUD_MODE
+const int gouraudMode = GOURAUD_MODE;
+#else
 uniform int gouraudMode;
+#endif
 uniform int gi;
 uniform vec3 lightDir;
 uniform vec3 lightColor;
 uniform vec3 objColor;
 uniform sampler2D samplerA;
+uniform sampler2DArray samplerArray; // with -a, all the textures, as layers
+uniform int layer;                   // the layer with this object's texture, or -1 for samplerA
 uniform sampler2D samplerB;
 uniform float Ka;
 uniform float Kd;
@@ -22,6 +28,20 @@ in vec3 vnrm;
 
 out vec4 color;
 
+// diffuse irradiance from the cube map (over pi, so white gives 1), as 9 spherical harmonic
+// coefficients with their constants folded in; see spotImageCubeMapSH
+layout(std140) uniform Irradiance {
+  vec4 irradianceSH[9];
+};
+
+vec3 irradiance(vec3 n) {
+  return irradianceSH[0].rgb
+    + irradianceSH[1].rgb*n.y + irradianceSH[2].rgb*n.z + irradianceSH[3].rgb*n.x
+    + irradianceSH[4].rgb*(n.x*n.y) + irradianceSH[5].rgb*(n.y*n.z)
+    + irradianceSH[6].rgb*(3.0*n.z*n.z - 1.0) + irradianceSH[7].rgb*(n.x*n.z)
+    + irradianceSH[8].rgb*(n.x*n.x - n.y*n.y);
+}
+
 void main() {
 
   vec4 c; // to store the color given by either texture or object color
@@ -40,7 +60,7 @@ void main() {
   switch (gi)
   {
     case 0:
-      c = texture(samplerA, tc);
+      c = (layer >= 0 ? texture(samplerArray, vec3(tc, layer)) : texture(samplerA, tc));
       break;
     case 1:
       c = texture(samplerB, tc);
@@ -54,7 +74,7 @@ void main() {
   }
   else { // in Phong mode
     vec3 diff = Kd * max(0.0, dot(vnrm, lightDir)) * objColor;
-    vec3 amb = Ka * c.rgb;
+    vec3 amb = Ka * c.rgb * irradiance(normalize(vnrm));
 
     vec3 r = normalize(reflect(-normalize(lightDir), normalize(vnrm)));
     float vnrmdotr = max(0.0, dot(normalize(vnrm), r));
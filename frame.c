@@ -0,0 +1,119 @@
+/*
+ * frame.c: the frame snapshots, triple buffer, and input queue that let the update and render
+ *          stages run on separate threads
+ */
+
+#include "spot.h"
+
+#include "frame.h"
+#include "types.h"
+
+// NOTE: makes sure frame has room for num objects; their contents are left for contextUpdate
+int frameReserve(frame_t *frame, unsigned int num) {
+  const char me[]="frameReserve";
+  frameObject_t *object;
+
+  if (num <= frame->objectCap) {
+    return 0;
+  }
+  object = (frameObject_t *)realloc(frame->object, num*sizeof(frameObject_t));
+  if (!object) {
+    spotErrorAdd("%s: couldn't allocate for %u objects", me, num);
+    return 1;
+  }
+  frame->object = object;
+  frame->objectCap = num;
+  return 0;
+}
+
+void frameTripleInit(frameTriple_t *ft) {
+  memset(ft->frame, 0, sizeof(ft->frame));
+  ft->back = 0;
+  atomic_init(&ft->middle, 1);
+  ft->front = 2;
+}
+
+// NOTE: the frame the writer may fill in; nobody else looks at it until frameTriplePublish
+frame_t *frameTripleBack(frameTriple_t *ft) {
+  return ft->frame + ft->back;
+}
+
+// NOTE: hands the back frame over to the reader, along with the enum Requests bits req, and
+//       takes whichever frame was in the middle (which the reader never got to, or has finished
+//       with) as the new back frame. If the reader never got to it, its requests are carried
+//       over to the new middle frame, so that none are lost
+void frameTriplePublish(frameTriple_t *ft, int req) {
+  unsigned int prev, next;
+
+  prev = atomic_load_explicit(&ft->middle, memory_order_relaxed);
+  do {
+    next = ft->back | FRAME_FRESH | ((unsigned int)req << FRAME_REQUEST_SHIFT);
+    if (prev & FRAME_FRESH) {
+      next |= prev & ~(FRAME_INDEX | FRAME_FRESH);
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&ft->middle, &prev, next,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+  ft->back = prev & FRAME_INDEX;
+}
+
+// NOTE: sets *frame to the most recently published frame, returning 1 if it wasn't seen by a
+//       previous call, in which case *req is set to the requests to be done before drawing it
+//       (otherwise 0); the frame stays valid (and unchanged) until the next call
+int frameTripleLatest(frameTriple_t *ft, frame_t **frame, int *req) {
+  unsigned int prev;
+  int fresh = 0;
+
+  *req = 0;
+  if (atomic_load_explicit(&ft->middle, memory_order_relaxed) & FRAME_FRESH) {
+    prev = atomic_exchange_explicit(&ft->middle, ft->front, memory_order_acq_rel);
+    ft->front = prev & FRAME_INDEX;
+    *req = prev >> FRAME_REQUEST_SHIFT;
+    fresh = 1;
+  }
+  *frame = ft->frame + ft->front;
+  return fresh;
+}
+
+void frameTripleDone(frameTriple_t *ft) {
+  unsigned int ii;
+
+  for (ii=0; ii<3; ii++) {
+    free(ft->frame[ii].object);
+    ft->frame[ii].object = NULL;
+    ft->frame[ii].objectNum = ft->frame[ii].objectCap = 0;
+  }
+}
+
+void inputQueueInit(inputQueue_t *q) {
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+}
+
+// NOTE: returns 1 (dropping the event) if the queue is full, which only happens if the update
+//       thread has stopped taking events
+int inputQueuePush(inputQueue_t *q, const input_t *ev) {
+  unsigned int head, tail;
+
+  tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  head = atomic_load_explicit(&q->head, memory_order_acquire);
+  if (tail - head == INPUT_QUEUE_LEN) {
+    return 1;
+  }
+  q->ev[tail % INPUT_QUEUE_LEN] = *ev;
+  atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+  return 0;
+}
+
+// NOTE: returns 1 if an event was copied to *ev, 0 if the queue was empty
+int inputQueuePop(inputQueue_t *q, input_t *ev) {
+  unsigned int head, tail;
+
+  head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  if (head == tail) {
+    return 0;
+  }
+  *ev = q->ev[head % INPUT_QUEUE_LEN];
+  atomic_store_explicit(&q->head, head + 1, memory_order_release);
+  return 1;
+}
@@ -0,0 +1,36 @@
+/*
+ * frame.h: the frame snapshots, triple buffer, and input queue that let the update and render
+ *          stages run on separate threads (see types.h for the structs)
+ */
+#ifndef FRAME_HAS_BEEN_INCLUDED
+#define FRAME_HAS_BEEN_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+// NOTE: set in frameTriple_t->middle when the middle frame hasn't been picked up by the reader;
+//       the bits above FRAME_REQUEST_SHIFT are the requests that go with it
+#define FRAME_INDEX 3
+#define FRAME_FRESH 4
+#define FRAME_REQUEST_SHIFT 3
+
+int frameReserve(frame_t *frame, unsigned int num);
+
+void frameTripleInit(frameTriple_t *ft);
+frame_t *frameTripleBack(frameTriple_t *ft);
+void frameTriplePublish(frameTriple_t *ft, int req);
+int frameTripleLatest(frameTriple_t *ft, frame_t **frame, int *req);
+void frameTripleDone(frameTriple_t *ft);
+
+void inputQueueInit(inputQueue_t *q);
+int inputQueuePush(inputQueue_t *q, const input_t *ev);
+int inputQueuePop(inputQueue_t *q, input_t *ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_HAS_BEEN_INCLUDED */
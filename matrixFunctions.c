@@ -167,6 +167,9 @@ void rotate_model(spotGeom *obj, GLfloat t, size_t i)
 {
   GLfloat angle, axis[3], quat[4], newquat[4];
 
+  // nothing to do if the object has been removed
+  if (!obj) return;
+
   // calculate angle of rotation
   angle = M_PI * 2.0f * t;
 
@@ -181,17 +184,17 @@ void rotate_model(spotGeom *obj, GLfloat t, size_t i)
 
 void rotate_model_N(GLfloat t)
 {
-  rotate_model(gctx->geom[gctx->gi], -t, 2);
+  rotate_model(spotPoolGet(gctx->geom, gctx->gi), -t, 2);
 }
 
 void rotate_model_V(GLfloat t)
 {
-  rotate_model(gctx->geom[gctx->gi], -t, 1);
+  rotate_model(spotPoolGet(gctx->geom, gctx->gi), -t, 1);
 }
 
 void rotate_model_U(GLfloat t)
 {
-  rotate_model(gctx->geom[gctx->gi], -t, 0);
+  rotate_model(spotPoolGet(gctx->geom, gctx->gi), -t, 0);
 }
 
 void rotate_model_UV(GLfloat x, GLfloat y)
@@ -288,7 +291,9 @@ void translate(GLfloat xyzw[4*4], GLfloat v[3])
 
 void translate_model_UV(GLfloat *t, GLfloat *s, size_t i)
 {
-  t=gctx->geom[gctx->gi]->modelMatrix;
+  spotGeom *obj=spotPoolGet(gctx->geom, gctx->gi);
+  if (!obj) return;
+  t=obj->modelMatrix;
   GLfloat u[3], v[3], m[3], l;
   copy_1st_V3(u, gctx->camera.uvn);
   SPOT_V3_NORM(m, u, l);
@@ -306,7 +311,9 @@ void translate_model_UV(GLfloat *t, GLfloat *s, size_t i)
 
 void translate_model_N(GLfloat *t, GLfloat *s, size_t i)
 {
-  t=gctx->geom[gctx->gi]->modelMatrix;
+  spotGeom *obj=spotPoolGet(gctx->geom, gctx->gi);
+  if (!obj) return;
+  t=obj->modelMatrix;
   GLfloat n[3], m[3], l;
   SPOT_V3_SUB(n, gctx->camera.from, gctx->camera.at);
   SPOT_V3_NORM(m, n, l);
@@ -416,7 +423,7 @@ void scale_near_far(GLfloat *t, GLfloat *s, size_t i)
     gctx->camera.far - gctx->camera.near,
     gctx->camera.fov);
 
-  callbackResize(gctx->winSizeX, gctx->winSizeY);
+  handleResize(gctx->winSizeX, gctx->winSizeY);
 
 }
 
@@ -438,11 +445,12 @@ void scale_1D(GLfloat t[1], GLfloat *s, size_t i)
   t[0] *= s[i];
   if (t[0] >= 3.14) t[0] = 3.14;
   if (t[0] <= 0) t[0] = 0.1;
-  callbackResize(gctx->winSizeX, gctx->winSizeY);
+  handleResize(gctx->winSizeX, gctx->winSizeY);
 }
 
 void translateGeomU(spotGeom *g, GLfloat s)
 {
+  if (!g) return;
   GLfloat t[2];
   t[0]=s;t[1]=0;
   translate_1st_3D(g->modelMatrix, t, 0);
@@ -450,6 +458,7 @@ void translateGeomU(spotGeom *g, GLfloat s)
 
 void translateGeomV(spotGeom *g, GLfloat s)
 {
+  if (!g) return;
   GLfloat t[2];
   t[0]=s;t[1]=0;
   translate_2nd_3D(g->modelMatrix, t, 0);
@@ -457,6 +466,7 @@ void translateGeomV(spotGeom *g, GLfloat s)
 
 void translateGeomN(spotGeom *g, GLfloat s)
 {
+  if (!g) return;
   GLfloat t[2];
   t[0]=s;t[1]=0;
   translate_3rd_3D(g->modelMatrix, t, 0);
@@ -464,6 +474,7 @@ void translateGeomN(spotGeom *g, GLfloat s)
 
 void scaleGeom(spotGeom *g, GLfloat s)
 {
+  if (!g) return;
   GLfloat t[2];
   t[0]=s;t[1]=0;
   scale(g->modelMatrix, t);
@@ -471,6 +482,7 @@ void scaleGeom(spotGeom *g, GLfloat s)
 
 void scaleGeomX(spotGeom *g, GLfloat s)
 {
+  if (!g) return;
   GLfloat scale[4*4], t[4*4];
   SPOT_M4_IDENTITY(scale);
   scale[0] = s;
@@ -480,6 +492,7 @@ void scaleGeomX(spotGeom *g, GLfloat s)
 
 void scaleGeomY(spotGeom *g, GLfloat s)
 {
+  if (!g) return;
   GLfloat scale[4*4], t[4*4];
   SPOT_M4_IDENTITY(scale);
   scale[5] = s;
@@ -489,6 +502,7 @@ void scaleGeomY(spotGeom *g, GLfloat s)
 
 void scaleGeomZ(spotGeom *g, GLfloat s)
 {
+  if (!g) return;
   GLfloat scale[4*4], t[4*4];
   SPOT_M4_IDENTITY(scale);
   scale[10] = s;
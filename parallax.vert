@@ -2,11 +2,14 @@
 
 // Sample vertex shader for Project 2.  Hack away!
 
+#ifdef GOURAUD_MODE
+const int gouraudMode = GOURAUD_MODE;
+#else
 uniform int gouraudMode;
-uniform mat4 modelMatrix;
+#endif
+uniform mat4 mvpMatrix;        // projMatrix * viewMatrix * modelMatrix
 uniform mat3 normalMatrix;
 uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
 uniform vec3 lightDir;  // assumed to be unit-length (already normalized)
 uniform vec3 lightColor;
 uniform vec3 objColor;
@@ -34,7 +37,7 @@ void main() {
   texCoord = vertTex2 + texture(samplerC, vertTex2).r * v.xy;
 
   // set position
-  gl_Position = projMatrix * viewMatrix * modelMatrix * vertPos;
+  gl_Position = mvpMatrix * vertPos;
 
   // set texture coordinates
   texCoord = vertTex2;
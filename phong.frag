@@ -19,11 +19,25 @@ in vec3 vnrm;
 
 out vec4 color;
 
+// diffuse irradiance from the cube map (over pi, so white gives 1), as 9 spherical harmonic
+// coefficients with their constants folded in; see spotImageCubeMapSH
+layout(std140) uniform Irradiance {
+  vec4 irradianceSH[9];
+};
+
+vec3 irradiance(vec3 n) {
+  return irradianceSH[0].rgb
+    + irradianceSH[1].rgb*n.y + irradianceSH[2].rgb*n.z + irradianceSH[3].rgb*n.x
+    + irradianceSH[4].rgb*(n.x*n.y) + irradianceSH[5].rgb*(n.y*n.z)
+    + irradianceSH[6].rgb*(3.0*n.z*n.z - 1.0) + irradianceSH[7].rgb*(n.x*n.z)
+    + irradianceSH[8].rgb*(n.x*n.x - n.y*n.y);
+}
+
 void main() {
 
   // implement Phong shading
   vec3 diff = Kd * max(0.0, dot(vnrm, lightDir)) * objColor;
-  vec3 amb = Ka * objColor;
+  vec3 amb = Ka * objColor * irradiance(normalize(vnrm));
 
   vec3 r = normalize(reflect(-normalize(lightDir), normalize(vnrm)));
   float vnrmdotr = max(0.0, dot(normalize(vnrm), r));
@@ -2,10 +2,8 @@
 
 // Vertex shader for phong/gouraud shading 
 
-uniform mat4 modelMatrix;
+uniform mat4 mvpMatrix;        // projMatrix * viewMatrix * modelMatrix
 uniform mat3 normalMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
 uniform vec3 lightDir;  // assumed to be unit-length (already normalized)
 uniform vec3 lightColor;
 uniform vec3 objColor;
@@ -24,7 +22,7 @@ out vec3 vnrm;
 void main() {
 
   // transform vertices 
-  gl_Position = projMatrix * viewMatrix * modelMatrix * vertPos;
+  gl_Position = mvpMatrix * vertPos;
   
   // calculate surface normal in view coords
   vnrm = normalize(normalMatrix * vertNorm);
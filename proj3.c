@@ -4,6 +4,7 @@
 //
 //
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h> // For UCHAR_MAX and friends...
@@ -18,6 +19,7 @@
 
 // Local includes
 #include "callbacks.h"
+#include "frame.h"
 #include "matrixFunctions.h"
 #include "spot.h"
 #include "types.h"
@@ -25,9 +27,15 @@
 // NOTE: this is how we support our stack of shaders; we define each we want to load in
 //       `glInitContext()' of our program, load them once, and leave them attached until the app
 //       terminates
-const char *vertFnames[NUM_PROGRAMS], // Our list of shaders (populated in `contextGLInit()');
-           *fragFnames[NUM_PROGRAMS]; // see `types.h' for the definition of NUM_PROGRAMS
-int programIds[NUM_PROGRAMS+1];       // List of corresponding program ids (for `glUseProgram()')
+const char *vertFnames[NUM_PROGRAMS+1], // Our list of shaders (populated in `contextGLInit()');
+           *fragFnames[NUM_PROGRAMS+1]; // see `types.h' for the definition of NUM_PROGRAMS
+int programIds[PROGRAM_SLOTS];        // List of corresponding program ids (for `glUseProgram()'),
+                                      // followed by those of their variants
+
+// NOTE: frames saved are read back this many frames later, and this many more can be waiting
+//       to be encoded before saving another one waits for them
+#define CAPTURE_SLOTS 3
+#define CAPTURE_SAVES 8
 
 // Global context
 context_t *gctx = NULL;
@@ -46,7 +54,8 @@ TwEnumVal twBumpMappingModesEV[]={{Disabled, "Disabled"},
 																	{Cube, "Cube"}},
 					twCubeMapsEV[]				={{CubeSample, "cube-sample.png"},
 																	{CubeCool, "cube-cool.png"},
-																	{CubePlace, "cube-place.png"}},
+																	{CubePlace, "cube-place.png"},
+																	{CubeFaces, "{pos,neg}_{x,y,z}.png"}},
 					twShadersEV[]					={{PhongShader, "phong.{vert,frag}"},
 																	{CubeShader, "cube.{vert,frag}"},
 																	{SpotlightShader, "spotlight.{vert,frag}"}};
@@ -57,31 +66,54 @@ TwEnumVal twBumpMappingModesEV[]={{Disabled, "Disabled"},
 //       that...
 int sceneGeomOffset=0;
 
+// NOTE: uniform locations with no program (or none learned yet): every location is -1, so
+//       nothing is set
+static uniloc_t unilocNone;
+static unishadow_t unishadowNone;
+
+context_t *contextNix(context_t *ctx);
+int contextAnimating(context_t *ctx);
+void unilocsClear(uniloc_t *uniloc);
+void unilocsLearn(uniloc_t *uniloc, GLuint program);
+int updateTweakBarVars(int scene);
+GLuint contextProgramUsable(context_t *ctx, GLuint program);
+void contextLock(context_t *ctx);
+void contextUnlock(context_t *ctx);
+void contextRequest(context_t *ctx, int req);
+
 // NOTE: the following supports per-vertex texturing. We set the RGB values at each vertex, and
 //       our shaders linearly interpolate the values, giving it a (sick) low-res look
 int perVertexTexturing() {
   int i, v;
+  spotGeom *geom;
+  spotImage *image;
   if (gctx->perVertexTexturingMode) {
-    // We are coloring the vertices for each geom
-    for (i=0; i<gctx->geomNum; i++) {
-      int sizeC=gctx->image[i]->sizeC,            // channel size (e.g., 8- or 16-bit?)
+    // We are coloring the vertices for each object, using the texture of the same index
+    for (i=0; i<3; i++) {
+      geom=spotPoolGet(gctx->geom, gctx->objectH[i]);
+      image=spotPoolGet(gctx->image, gctx->textureH[i]);
+      if (!geom || !image) {
+        // object or texture has since been removed; nothing to color
+        continue;
+      }
+      int sizeC=image->sizeC,                     // channel size (e.g., 8- or 16-bit?)
           maxVal=sizeC==1?UCHAR_MAX:USHRT_MAX,    // max value of a channel (e.g. 255)
-          sizeX=gctx->image[i]->sizeX,            // width of image, aka number of columns
-          sizeY=gctx->image[i]->sizeY,            // height of image, aka number of rows
-          sizeP=gctx->image[i]->sizeP,            // sizeP == number of channels (e.g., 3 for RGB)
+          sizeX=image->sizeX,                     // width of image, aka number of columns
+          sizeY=image->sizeY,                     // height of image, aka number of rows
+          sizeP=image->sizeP,                     // sizeP == number of channels (e.g., 3 for RGB)
           sizeOfPixel=sizeP*sizeC,                // sizeOfPixel == num of channels * channel size
           sizeOfRow=sizeX*sizeOfPixel;            // sizeOfRow (for the img_y offset)
       // NOTE: even though we are casting data.us to an array of unsigned chars, we explicitly
       //       handle the memory locations, so this is not a trip-up
-      unsigned char *data = sizeC==1 ? gctx->image[i]->data.uc
-        : (unsigned char*) gctx->image[i]->data.us;
+      unsigned char *data = sizeC==1 ? image->data.uc
+        : (unsigned char*) image->data.us;
       // NOTE: now we cycle through the vertices of the i-th geom, converting each vertex's
       //       texture coordinates into pixel coordinates, and finally into in-image memory
       //       locations; then we write the vertex's RGB component, transformed from the range of
       //       (0,maxVal) to (0.0,1.0)
-      for (v=0; v<gctx->geom[i]->vertNum; v++) {
-        GLfloat s=gctx->geom[i]->tex2[2*v],       // (s,t) texture coordinates of a vertex, v
-                t=gctx->geom[i]->tex2[2*v+1];
+      for (v=0; v<geom->vertNum; v++) {
+        GLfloat s=geom->tex2[2*v],                // (s,t) texture coordinates of a vertex, v
+                t=geom->tex2[2*v+1];
         int x=s*(sizeX-1),                        // (x,y) location of a pixel in the image
             y=t*(sizeY-1),
             img_x=x*sizeOfPixel,                  // memory location of the (x,y) pixel, given the
@@ -93,31 +125,350 @@ int perVertexTexturing() {
                 g=(float)(*(data+img_y+img_x+sizeC*1))/maxVal, // to (0.0,1.0)
                 b=(float)(*(data+img_y+img_x+sizeC*2))/maxVal;
         // Set the vertex-specific RGB values
-        gctx->geom[i]->rgb[v*3+0]=r;
-        gctx->geom[i]->rgb[v*3+1]=g;
-        gctx->geom[i]->rgb[v*3+2]=b;
+        geom->rgb[v*3+0]=r;
+        geom->rgb[v*3+1]=g;
+        geom->rgb[v*3+2]=b;
+      }
+      // NOTE: the shaders only see this once it gets to the GPU; the colors only change when the
+      //       mode is toggled, so they're written over the static rgb buffer once, here (without
+      //       re-allocating it), rather than sent every frame
+      if (gctx->glReady) {
+        spotGeomGLUpdate(geom, 1u << spotVertAttrIndx_rgb);
       }
-      // NOTE: we need to update the OpenGL buffer location for this geom's per-vertex RGB values,
-      //       otherwise none of this work will be evident in the shaders
-      glBindBuffer(GL_ARRAY_BUFFER, gctx->geom[i]->rgbBuffId);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*gctx->geom[i]->vertNum*3, gctx->geom[i]->rgb,
-          GL_STATIC_DRAW);
     }
   } else {
     // NOTE: we reset the per-vertex RGB values for each geom to 1
-    for (i=0; i<gctx->geomNum; i++) {
-      for (v=0; v<gctx->geom[i]->vertNum; v++)
-        gctx->geom[i]->rgb[v*3+0]=gctx->geom[i]->rgb[v*3+1]=gctx->geom[i]->rgb[v*3+2]=1;
-      // NOTE: we need to update the OpenGL buffer location for this geom's per-vertex RGB values,
-      //       otherwise none of this work will be evident in the shaders
-      glBindBuffer(GL_ARRAY_BUFFER, gctx->geom[i]->rgbBuffId);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*gctx->geom[i]->vertNum*3, gctx->geom[i]->rgb,
-          GL_STATIC_DRAW);
+    for (i=0; i<gctx->geom->num; i++) {
+      geom=spotPoolItem(gctx->geom, i);
+      for (v=0; v<geom->vertNum; v++)
+        geom->rgb[v*3+0]=geom->rgb[v*3+1]=geom->rgb[v*3+2]=1;
+      if (gctx->glReady) {
+        spotGeomGLUpdate(geom, 1u << spotVertAttrIndx_rgb);
+      }
     }
   }
   return gctx->perVertexTexturingMode;
 }
 
+// NOTE: objects and images live in pools, so that they can come and go at runtime without
+//       invalidating the handles held elsewhere (e.g. gctx->gi); the following add a new spotGeom
+//       (taking ownership of it) or remove one (freeing it). Once contextGLInit has run (i.e. once
+//       ctx->glReady is set), the GL side of that is left to contextGeomsSettle, on the render
+//       thread: the handlers calling these may be on the update thread, and the frame being
+//       drawn may still have the geom. A new geom isn't drawn until it's set up
+// NOTE: once the last geom from ctx->arena (i.e. the scene made in contextNew) is gone, the
+//       whole arena is freed at once, ready for the next scene. New geoms come from the arena
+//       with the context locked (as are the input handlers), since it isn't thread-safe
+static void contextArenaTrim(context_t *ctx) {
+  unsigned int ii;
+
+  for (ii=0; ii<ctx->geom->num; ii++) {
+    if (spotGeomAllocArena == ((spotGeom *)spotPoolItem(ctx->geom, ii))->alloc) {
+      return;
+    }
+  }
+  spotArenaReset(ctx->arena);
+}
+
+spotHandle contextGeomAdd(context_t *ctx, spotGeom *geom) {
+  const char me[]="contextGeomAdd";
+  spotHandle hh;
+
+  if (!geom) {
+    spotErrorAdd("%s: got NULL geom", me);
+    return SPOT_HANDLE_NONE;
+  }
+  if (SPOT_HANDLE_NONE == (hh = spotPoolAdd(ctx->geom, geom))) {
+    spotErrorAdd("%s: couldn't add to pool", me);
+    return SPOT_HANDLE_NONE;
+  }
+  if (ctx->glReady) {
+    contextRequest(ctx, RequestGeoms);
+  }
+  return hh;
+}
+
+int contextGeomRemove(context_t *ctx, spotHandle hh) {
+  const char me[]="contextGeomRemove";
+  spotHandle *newRemove;
+  spotGeom *geom;
+
+  if (!ctx->glReady) {
+    if (!( geom = spotPoolRemove(ctx->geom, hh) )) {
+      spotErrorAdd("%s: stale handle %08x", me, hh);
+      return 1;
+    }
+    spotGeomNix(geom);
+    contextArenaTrim(ctx);
+    return 0;
+  }
+  if (!spotPoolGet(ctx->geom, hh)) {
+    spotErrorAdd("%s: stale handle %08x", me, hh);
+    return 1;
+  }
+  if (ctx->geomRemoveNum == ctx->geomRemoveCap) {
+    newRemove = (spotHandle *)realloc(ctx->geomRemove,
+                                      (ctx->geomRemoveCap ? 2*ctx->geomRemoveCap : 4)
+                                      *sizeof(spotHandle));
+    if (!newRemove) {
+      spotErrorAdd("%s: couldn't queue removal", me);
+      return 1;
+    }
+    ctx->geomRemove = newRemove;
+    ctx->geomRemoveCap = ctx->geomRemoveCap ? 2*ctx->geomRemoveCap : 4;
+  }
+  ctx->geomRemove[ctx->geomRemoveNum++] = hh;
+  contextRequest(ctx, RequestGeoms);
+  return 0;
+}
+
+// NOTE: for RequestGeoms, on the render thread (with the context to itself): frees the geoms
+//       contextGeomRemove was asked to remove, and sets up any new ones. Frames made before
+//       the removal still have the handles, but contextRender won't find them any more
+void contextGeomsSettle(context_t *ctx) {
+  const char me[]="contextGeomsSettle";
+  unsigned int ii;
+  spotGeom *geom;
+
+  for (ii=0; ii<ctx->geomRemoveNum; ii++) {
+    // NOTE: NULL if it was asked to be removed twice
+    if ((geom = spotPoolRemove(ctx->geom, ctx->geomRemove[ii]))) {
+      spotGeomGLDone(geom);
+      spotGeomNix(geom);
+    }
+  }
+  if (ctx->geomRemoveNum) {
+    contextArenaTrim(ctx);
+  }
+  ctx->geomRemoveNum = 0;
+  for (ii=0; ii<ctx->geom->num; ii++) {
+    geom = spotPoolItem(ctx->geom, ii);
+    if (!geom->vaoId && spotGeomGLInit(geom)) {
+      fprintf(stderr, "%s: trouble with geom %08x\n", me, ctx->geom->handle[ii]);
+      spotErrorPrint(); spotErrorClear();
+    }
+  }
+}
+
+// NOTE: GL set-up of an image of the given kind (enum ImageKinds); 2D textures get all their mip
+//       levels, for the *WithMipmap filtering modes, made with a Kaiser-windowed sinc (sharper
+//       than glGenerateMipmap's box) from the (sRGB) colors in linear, or the renormalized normals.
+//       Cube maps get levels convolved with ever rougher GGX lobes, which cube.frag picks by
+//       shexp; these are cached next to PNG fname (if not NULL), since they take a while to make
+int contextImageGLInit(spotImage *image, int kind, const char *fname) {
+  if (ImageCubeMap == kind) {
+    return (spotImageCubeMapGLInit(image)
+            || spotImageCubeMapMipGLInit(image, &fname, fname ? 1 : 0, spotCubeLobeGGX));
+  }
+  return (spotImageGLInit(image)
+          || spotImageMipGLInit(image, spotMipFilterKaiser,
+                                ImageNormal == kind ? spotMipKindNormal : spotMipKindColor));
+}
+
+// NOTE: reads the header of PNG fname into image, ahead of loading it. With -z, this also picks
+//       how it is block compressed: normals as BC5, which keeps only x and y (z is dropped, since
+//       bump.frag and parallax.frag read only those two), colors with alpha as BC3, the rest as
+//       BC1 (16-bit images are narrowed to 8 bits first, which is more than the blocks keep), but
+//       only if the GL can use the format
+int contextImageHeader(context_t *ctx, spotImage *image, const char *fname, int kind) {
+  int format;
+
+  if (spotImageLoadPNGInfo(image, fname)) {
+    return 1;
+  }
+  if (!ctx->compress) {
+    return 0;
+  }
+  if (ImageNormal == kind) {
+    format = spotBC5;
+  } else if (2 == image->sizeP || 4 == image->sizeP) {
+    format = spotBC3;
+  } else {
+    format = spotBC1;
+  }
+  image->bcFormat = spotBCGLCan(format) ? format : spotBCNone;
+  return 0;
+}
+
+// NOTE: with -a, the 2D textures (ctx->textureH) of the most common size are packed as layers
+//       of one texture array (ctx->texArray), so that all of them are sampled with one bind,
+//       and each object picks its texture with the "layer" uniform; the others (and any that
+//       are block compressed) get their own texture as usual. kind[ii] is the enum ImageKinds
+//       of textureH[ii]
+int contextTexturesPack(context_t *ctx, const int *kind) {
+  const char me[]="contextTexturesPack";
+  spotImage *image[4], *layer[4];
+  unsigned int ii, jj, best, count, bestCount, layerNum;
+
+  for (ii=0; ii<4; ii++) {
+    image[ii] = spotPoolGet(ctx->image, ctx->textureH[ii]);
+    ctx->texLayer[ii] = -1;
+  }
+  best = 0;
+  bestCount = 0;
+  for (ii=0; ii<4; ii++) {
+    count = 0;
+    for (jj=0; jj<4 && image[ii] && !image[ii]->bcFormat; jj++) {
+      count += (image[jj] && !image[jj]->bcFormat && image[jj]->sizeX == image[ii]->sizeX
+                && image[jj]->sizeY == image[ii]->sizeY);
+    }
+    if (count > bestCount) {
+      best = ii;
+      bestCount = count;
+    }
+  }
+  layerNum = 0;
+  for (ii=0; ii<4 && bestCount; ii++) {
+    if (image[ii] && !image[ii]->bcFormat && image[ii]->sizeX == image[best]->sizeX
+        && image[ii]->sizeY == image[best]->sizeY) {
+      ctx->texLayer[ii] = layerNum;
+      layer[layerNum++] = image[ii];
+    }
+  }
+  if (layerNum) {
+    if (!( ctx->texArray = spotImageArrayNew() )
+        || spotImageArrayGLInit(ctx->texArray, layer, layerNum)) {
+      spotErrorAdd("%s: couldn't make texture array of %u", me, layerNum);
+      ctx->texArray = spotImageArrayNix(ctx->texArray);
+      return 1;
+    }
+  }
+  for (ii=0; ii<4; ii++) {
+    if (!image[ii]) {
+      continue;
+    }
+    // NOTE: the same mip levels as contextImageGLInit makes
+    if (-1 != ctx->texLayer[ii]
+        ? spotImageArrayMipGLInit(ctx->texArray, ctx->texLayer[ii], image[ii],
+                                  spotMipFilterKaiser, (ImageNormal == kind[ii]
+                                                        ? spotMipKindNormal
+                                                        : spotMipKindColor))
+        : contextImageGLInit(image[ii], kind[ii], NULL)) {
+      spotErrorAdd("%s: trouble with texture %u", me, ii);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// NOTE: kind[ii] (enum ImageKinds) says whether image ii is a cube map (six faces stacked along
+//       Y) or a 2D texture of colors or of normals, which determines how it is set up for GL. Before contextGLInit, GL set-up is
+//       left to contextGLInit, which handles the images named in ctx->textureH and ctx->cubeMapH.
+//       All num PNGs are decoded in parallel (spotImageLoadPNGAsync), and set up for GL here, on
+//       the GL thread, as each finishes. hh[ii] is SPOT_HANDLE_NONE for any image that failed.
+//       Once GL is ready, cube maps are decoded straight into a mapped pixel buffer and uploaded
+//       from there, so they never have a copy in image->data; 2D textures keep theirs, since
+//       perVertexTexturing samples them on the CPU (and their mip levels are made from it).
+//       With -z (ctx->compress), images are uploaded block compressed, with the blocks cached
+//       next to each PNG so that they're only encoded when the PNG changes. With -a (ctx->pack),
+//       GL set-up of 2D textures is left to contextTexturesPack
+int contextImagesAdd(context_t *ctx, spotHandle *hh, char **fname, const int *kind,
+                     unsigned int num) {
+  const char me[]="contextImagesAdd";
+  spotImage *image[num];
+  spotImageLoad *load[num];
+  unsigned int ii, bad;
+  void *dest;
+
+  for (ii=0; ii<num; ii++) {
+    load[ii] = NULL;
+    dest = NULL;
+    if (!( image[ii] = spotImageNew() )) {
+      spotErrorAdd("%s: couldn't allocate image", me);
+    } else if (ctx->glReady && (ImageCubeMap == kind[ii] || ctx->compress)
+               && contextImageHeader(ctx, image[ii], fname[ii], kind[ii])) {
+      spotErrorAdd("%s: couldn't read header of \"%s\"", me, fname[ii]);
+    } else if (ctx->glReady && ImageCubeMap == kind[ii]
+               && !( dest = spotImageGLBufferMap(image[ii]) )) {
+      spotErrorAdd("%s: couldn't set up pixel buffer for \"%s\"", me, fname[ii]);
+    } else if (!( load[ii] = spotImageLoadPNGAsync(image[ii], fname[ii], dest) )) {
+      spotErrorAdd("%s: couldn't start loading \"%s\"", me, fname[ii]);
+    }
+  }
+  bad = 0;
+  for (ii=0; ii<num; ii++) {
+    hh[ii] = SPOT_HANDLE_NONE;
+    if (!load[ii] || spotImageLoadWait(load[ii])) {
+      if (load[ii]) {
+        spotErrorAdd("%s: trouble loading \"%s\"", me, fname[ii]);
+      }
+      if (ctx->glReady && image[ii]) {
+        spotImageGLDone(image[ii]);
+      }
+      spotImageNix(image[ii]);
+      bad++; continue;
+    }
+    if (ctx->glReady && !(ctx->pack && ImageCubeMap != kind[ii])
+        && contextImageGLInit(image[ii], kind[ii], fname[ii])) {
+      spotErrorAdd("%s: trouble with GL set-up of \"%s\"", me, fname[ii]);
+      spotImageGLDone(image[ii]);
+      spotImageNix(image[ii]);
+      bad++; continue;
+    }
+    if (SPOT_HANDLE_NONE == (hh[ii] = spotPoolAdd(ctx->image, image[ii]))) {
+      spotErrorAdd("%s: couldn't add to pool", me);
+      if (ctx->glReady) {
+        spotImageGLDone(image[ii]);
+      }
+      spotImageNix(image[ii]);
+      bad++; continue;
+    }
+  }
+  return !!bad;
+}
+
+spotHandle contextImageAdd(context_t *ctx, char *fname, int kind) {
+  spotHandle hh;
+
+  contextImagesAdd(ctx, &hh, &fname, &kind, 1);
+  return hh;
+}
+
+// NOTE: adds a cube map made from six face images (fname, in +X,-X,+Y,-Y,+Z,-Z order) rather than
+//       one tall one. The faces are decoded in parallel, and each is uploaded from its own decode
+//       buffer, so the tall image is never put together. The prefiltered levels are cached next
+//       to the first face. Returns SPOT_HANDLE_NONE if that didn't work
+spotHandle contextCubeMapFacesAdd(context_t *ctx, const char *const fname[6]) {
+  const char me[]="contextCubeMapFacesAdd";
+  spotImage *image;
+  spotHandle hh;
+
+  if (!( image = spotImageNew() )) {
+    spotErrorAdd("%s: couldn't allocate image", me);
+    return SPOT_HANDLE_NONE;
+  }
+  // NOTE: with -z, the header of the first face picks the compression of all of them
+  if ((ctx->compress && contextImageHeader(ctx, image, fname[0], ImageCubeMap))
+      || spotImageCubeMapFacesGLInit(image, fname)
+      || spotImageCubeMapMipGLInit(image, fname, 6, spotCubeLobeGGX)) {
+    spotErrorAdd("%s: trouble with cube map faces \"%s\" ...", me, fname[0]);
+    spotImageGLDone(image);
+    spotImageNix(image);
+    return SPOT_HANDLE_NONE;
+  }
+  if (SPOT_HANDLE_NONE == (hh = spotPoolAdd(ctx->image, image))) {
+    spotErrorAdd("%s: couldn't add to pool", me);
+    spotImageGLDone(image);
+    spotImageNix(image);
+  }
+  return hh;
+}
+
+int contextImageRemove(context_t *ctx, spotHandle hh) {
+  const char me[]="contextImageRemove";
+  spotImage *image;
+
+  if (!( image = spotPoolRemove(ctx->image, hh) )) {
+    spotErrorAdd("%s: stale handle %08x", me, hh);
+    return 1;
+  }
+  if (ctx->glReady) {
+    spotImageGLDone(image);
+  }
+  spotImageNix(image);
+  return 0;
+}
+
 /* Creates a context around geomNum spotGeom's and
    imageNum spotImage's */
 context_t *contextNew(unsigned int geomNum, unsigned int imageNum) {
@@ -133,36 +484,57 @@ context_t *contextNew(unsigned int geomNum, unsigned int imageNum) {
 
   ctx->vertFname = NULL;
   ctx->fragFname = NULL;
-  if (geomNum) {
-    ctx->geom = (spotGeom **)calloc(geomNum, sizeof(spotGeom*));
-    if (!ctx->geom) {
-      spotErrorAdd("%s: couldn't alloc %u geoms", me, geomNum);
-      free(ctx); return NULL;
-    }
-    for (gi=0; gi<geomNum; gi++) {
-      ctx->geom[gi] = NULL;
-    }
-  } else {
-    ctx->geom = NULL;
+  // NOTE: geomNum and imageNum are only initial capacities; the pools grow as needed
+  ctx->geom = spotPoolNew(geomNum);
+  ctx->image = spotPoolNew(imageNum);
+  // NOTE: one chunk is enough for the scene's geometry; the whole scene is freed at once
+  ctx->arena = spotArenaNew(0);
+  if (!( ctx->geom && ctx->image && ctx->arena )) {
+    spotErrorAdd("%s: couldn't alloc pools for %u geoms, %u images", me, geomNum, imageNum);
+    spotPoolNix(ctx->geom); spotPoolNix(ctx->image); spotArenaNix(ctx->arena);
+    free(ctx); return NULL;
   }
-  ctx->geomNum = geomNum;
-  if (imageNum) {
-    ctx->image = (spotImage **)calloc(imageNum, sizeof(spotImage*));
-    if (!ctx->image) {
-      spotErrorAdd("%s: couldn't alloc %u images", me, imageNum);
-      free(ctx); return NULL;
-    }
-    for (gi=0; gi<imageNum; gi++) {
-      ctx->image[gi] = spotImageNew();
-    }
-  } else {
-    ctx->image = NULL;
-  }
-  ctx->imageNum = imageNum;
+  ctx->glReady = 0;
   SPOT_V3_SET(ctx->bgColor, 0.2f, 0.25f, 0.3f);
   SPOT_V3_SET(ctx->lightDir, 1.0f, 0.0f, 0.0f);
   SPOT_V3_SET(ctx->lightColor, 1.0f, 1.0f, 1.0f);
   ctx->running = 1;
+  ctx->dirty = 1;
+  ctx->continuous = 0;
+  ctx->stream = NULL;
+  ctx->capture = NULL;
+  ctx->captureNext = ctx->recording = 0;
+  ctx->captureNum = -1;
+  ctx->threaded = 0;
+  ctx->pack = 0;
+  ctx->texArray = NULL;
+  for (gi=0; gi<4; gi++) {
+    ctx->texLayer[gi] = -1;
+  }
+  // NOTE: every object shows TexRgb, since that's what the shaders sample with samplerA
+  for (gi=0; gi<3; gi++) {
+    ctx->objectTex[gi] = TexRgb;
+  }
+  ctx->irradianceBuffer = 0;
+  ctx->irradianceId = -1;
+  frameTripleInit(&ctx->frames);
+  inputQueueInit(&ctx->input);
+  atomic_init(&ctx->inputSent, 0);
+  ctx->requestNext = 0;
+  ctx->geomRemove = NULL;
+  ctx->geomRemoveNum = ctx->geomRemoveCap = 0;
+  ctx->drawGeom = NULL;
+  ctx->drawGeomCap = 0;
+  ctx->unilocProgram = 0;
+  unilocsClear(&unilocNone);
+  ctx->uniloc = &unilocNone;
+  ctx->attrMask = SPOT_VERT_ATTR_ALL;
+  ctx->unishadow = &unishadowNone;
+  ctx->uniformMiss = ctx->uniformHit = 0;
+  pthread_mutex_init(&ctx->lock, NULL);
+  pthread_mutex_init(&ctx->wantLock, NULL);
+  pthread_cond_init(&ctx->wantCond, NULL);
+  ctx->want = ctx->updateStop = 0;
   ctx->program = 0;
   ctx->winSizeX = 900;
   ctx->winSizeY = 700;
@@ -174,53 +546,38 @@ context_t *contextNew(unsigned int geomNum, unsigned int imageNum) {
   ctx->shiftDown = 0;
   ctx->Zspread = 0.003;
 
-    // create the objects
-    //ctx->geom[0] = spotGeomNewSoftcube();
-    ctx->geom[0] = spotGeomNewSphere();
-    ctx->geom[1] = spotGeomNewSoftcube();
-    ctx->geom[2] = spotGeomNewCube1();
+    // create the objects, all allocated from the scene's arena
+    //ctx->objectH[Sphere] = contextGeomAdd(ctx, spotGeomNewSoftcubeIn(ctx->arena));
+    ctx->objectH[Sphere] = contextGeomAdd(ctx, spotGeomNewSphereIn(ctx->arena));
+    ctx->objectH[Softcube] = contextGeomAdd(ctx, spotGeomNewSoftcubeIn(ctx->arena));
+    ctx->objectH[Cube] = contextGeomAdd(ctx, spotGeomNewCube1In(ctx->arena));
+    for (gi=0; gi<3; gi++) {
+      if (SPOT_HANDLE_NONE == ctx->objectH[gi]) {
+        spotErrorAdd("%s: couldn't create object %u", me, gi);
+        return contextNix(ctx);
+      }
+    }
 
-    // scale the objects
-    scaleGeom(ctx->geom[0], 0.15);
-    scaleGeom(ctx->geom[1], 0.15);
-    scaleGeom(ctx->geom[2], 0.15);
+    for (gi=0; gi<ctx->geom->num; gi++) {
+      spotGeom *geom = spotPoolItem(ctx->geom, gi);
+      // scale the objects
+      scaleGeom(geom, 0.15);
+      // set orientation
+      SPOT_V4_SET(geom->quaternion, 1.0f, 0.0f, 0.0f, 0.0f);
+      // set lighting constants
+      geom->Kd = 0.4;
+      geom->Ks = 0.3;
+      geom->Ka = 0.3;
+    }
 
     // color the objects
-    SPOT_V3_SET(ctx->geom[0]->objColor, 1, 0, 0);
-    SPOT_V3_SET(ctx->geom[1]->objColor, 0, 1, 0);
-    SPOT_V3_SET(ctx->geom[2]->objColor, 0, 0, 1);
+    SPOT_V3_SET(((spotGeom *)spotPoolGet(ctx->geom, ctx->objectH[Sphere]))->objColor, 1, 0, 0);
+    SPOT_V3_SET(((spotGeom *)spotPoolGet(ctx->geom, ctx->objectH[Softcube]))->objColor, 0, 1, 0);
+    SPOT_V3_SET(((spotGeom *)spotPoolGet(ctx->geom, ctx->objectH[Cube]))->objColor, 0, 0, 1);
 
     // translate the objects
-    translateGeomU(ctx->geom[1], 2.0f);
-    translateGeomU(ctx->geom[2], -2.0f);
-
-    // set orientation
-    SPOT_V4_SET(ctx->geom[0]->quaternion, 1.0f, 0.0f, 0.0f, 0.0f);
-    SPOT_V4_SET(ctx->geom[1]->quaternion, 1.0f, 0.0f, 0.0f, 0.0f);
-    SPOT_V4_SET(ctx->geom[2]->quaternion, 1.0f, 0.0f, 0.0f, 0.0f);
-
-    // load images
-    spotImageLoadPNG(ctx->image[0], "textimg/uchic-rgb.png");     // texture
-    spotImageLoadPNG(ctx->image[1], "textimg/uchic-norm08.png");  // bump map
-    //spotImageLoadPNG(ctx->image[2], "textimg/uchic-hght08.png");
-    spotImageLoadPNG(ctx->image[2], "textimg/uchic-norm08.png");
-    spotImageLoadPNG(ctx->image[3], "textimg/check-rgb.png");
-
-		//spotImageLoadPNG(ctx->image[4], "textimg/cube-sample.png");
-		spotImageLoadPNG(ctx->image[4], "textimg/cube-sample.png");
-		spotImageLoadPNG(ctx->image[5], "textimg/cube-cool.png");
-		spotImageLoadPNG(ctx->image[6], "textimg/cube-place.png");
-
-    // set lighting constants
-    ctx->geom[0]->Kd = 0.4;
-    ctx->geom[0]->Ks = 0.3;
-    ctx->geom[0]->Ka = 0.3;
-    ctx->geom[1]->Kd = 0.4;
-    ctx->geom[1]->Ks = 0.3;
-    ctx->geom[1]->Ka = 0.3;
-    ctx->geom[2]->Kd = 0.4;
-    ctx->geom[2]->Ks = 0.3;
-    ctx->geom[2]->Ka = 0.3;
+    translateGeomU(spotPoolGet(ctx->geom, ctx->objectH[Softcube]), 2.0f);
+    translateGeomU(spotPoolGet(ctx->geom, ctx->objectH[Cube]), -2.0f);
 
   ctx->ticDraw = -1;
   ctx->ticMouse = -1;
@@ -235,55 +592,408 @@ context_t *contextNew(unsigned int geomNum, unsigned int imageNum) {
   ctx->angleV = 0;
   ctx->angleN = 0;
 
-	ctx->gi = 1;
+	ctx->gi = ctx->objectH[Softcube];
 
   return ctx;
 }
 
-// NOTE: it makes sense to let this be its own function, since we need to call it upon changing
-//       gctx->program in our shaders
-void setUnilocs() {
-  /* Learn (once) locations of uniform variables that we will
-     frequently set */
-#define SET_UNILOC(V) gctx->uniloc.V = glGetUniformLocation(gctx->program, #V)
-      SET_UNILOC(lightDir);
-      SET_UNILOC(spotPoint);
-      SET_UNILOC(penumbra);
-      SET_UNILOC(rStart);
-      SET_UNILOC(rEnd);
-			SET_UNILOC(spotUp);
-      SET_UNILOC(lightColor);
-      SET_UNILOC(modelMatrix);
-      SET_UNILOC(normalMatrix);
-      SET_UNILOC(viewMatrix);
-      SET_UNILOC(inverseViewMatrix);
-      SET_UNILOC(projMatrix);
-      SET_UNILOC(objColor);
-      SET_UNILOC(gi);
-      SET_UNILOC(Ka);
-      SET_UNILOC(Kd);
-      SET_UNILOC(Ks);
-      SET_UNILOC(gouraudMode);
-      SET_UNILOC(seamFix);
-      SET_UNILOC(shexp);
-      SET_UNILOC(samplerA);
-      SET_UNILOC(samplerB);
-      SET_UNILOC(samplerC);
-      SET_UNILOC(cubeMap);
-      SET_UNILOC(samplerD);
-      SET_UNILOC(Zu);
-      SET_UNILOC(Zv);
-      SET_UNILOC(Zspread);
-#undef SET_UNILOC;
+// NOTE: the uniforms we set, by name, and where their locations go in a uniloc_t
+#define UNILOC(V) {#V, offsetof(uniloc_t, V)}
+static const struct {
+  const char *name;
+  size_t offset;
+} unilocNames[] = {
+  UNILOC(lightDir), UNILOC(spotPoint), UNILOC(penumbra), UNILOC(rStart), UNILOC(rEnd),
+  UNILOC(spotUp), UNILOC(lightColor), UNILOC(modelMatrix), UNILOC(normalMatrix),
+  UNILOC(viewMatrix), UNILOC(inverseViewMatrix), UNILOC(projMatrix), UNILOC(modelViewMatrix),
+  UNILOC(mvpMatrix), UNILOC(objColor),
+  UNILOC(gi), UNILOC(Ka), UNILOC(Kd), UNILOC(Ks), UNILOC(gouraudMode), UNILOC(seamFix),
+  UNILOC(shexp), UNILOC(samplerA), UNILOC(samplerB), UNILOC(samplerC), UNILOC(cubeMap),
+  UNILOC(samplerD), UNILOC(Zu), UNILOC(Zv), UNILOC(Zspread), UNILOC(samplerArray),
+  UNILOC(layer),
+};
+#undef UNILOC
+#define UNILOC_NUM (sizeof(unilocNames)/sizeof(unilocNames[0]))
+#define UNILOC_AT(U, I) (*(GLint *)((char *)(U) + unilocNames[I].offset))
+
+void unilocsClear(uniloc_t *uniloc) {
+  unsigned int ii;
+
+  for (ii=0; ii<UNILOC_NUM; ii++) {
+    UNILOC_AT(uniloc, ii) = -1;
+  }
+}
+
+// NOTE: called once per program, when it has linked: rather than asking for each of our
+//       uniforms by name, we ask the program which uniforms it has, and only look up the
+//       locations of those that we set.  Uniforms the program doesn't use stay -1
+void unilocsLearn(uniloc_t *uniloc, GLuint program) {
+  GLint num, ii, size, jj;
+  GLenum type;
+  GLsizei len;
+  GLchar name[128], *bracket;
+
+  unilocsClear(uniloc);
+  num = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &num);
+  for (ii=0; ii<num; ii++) {
+    glGetActiveUniform(program, ii, sizeof(name), &len, &size, &type, name);
+    // NOTE: an array is listed as "name[0]"
+    if ((bracket = strchr(name, '['))) {
+      *bracket = '\0';
+    }
+    for (jj=0; jj<(GLint)UNILOC_NUM; jj++) {
+      if (!strcmp(name, unilocNames[jj].name)) {
+        UNILOC_AT(uniloc, jj) = glGetUniformLocation(program, name);
+        break;
+      }
+    }
+  }
+}
+
+// NOTE: called once programIds[i] has linked, to learn what it needs from us: the locations of
+//       its uniforms, and which vertex attributes it reads.  Its irradiance block and sampler
+//       units are set up here too, once, as bench does (see spotProj3ProgramLinked)
+static void contextProgramLearn(context_t *ctx, unsigned int i, GLuint program) {
+
+  unilocsLearn(ctx->unilocs + i, program);
+  spotProj3ProgramLinked(program);
+  ctx->programAttrs[i] = spotProgramAttrMask(program);
+  // NOTE: a newly linked program has none of the values we've set
+  memset(ctx->unishadows[i].known, 0, sizeof(ctx->unishadows[i].known));
+}
+
+// NOTE: contextRender switches to what contextProgramLearn learned about the program (from
+//       contextProgramUsable or contextProgramVariant) that it draws with
+static void contextProgramSwitch(context_t *ctx, GLuint program) {
+  unsigned int i;
+
+  ctx->unilocProgram = program;
+  for (i=0; program && i<PROGRAM_SLOTS; i++) {
+    if (programIds[i] == (GLint)program && ProgramReady == ctx->programState[i]) {
+      ctx->uniloc = ctx->unilocs + i;
+      ctx->attrMask = ctx->programAttrs[i];
+      ctx->unishadow = ctx->unishadows + i;
+      return;
+    }
+  }
+  ctx->uniloc = &unilocNone;
+  ctx->unishadow = &unishadowNone;
+  ctx->attrMask = SPOT_VERT_ATTR_ALL;
+}
+
+// NOTE: asks for program programIds[id], which is only built (in contextProgramsPoll) once it
+//       has been asked for; this is safe to call from the update thread.  Until it's ready,
+//       contextRender draws with the fallback in its place
+GLuint contextProgram(context_t *ctx, int id) {
+  atomic_fetch_or(&ctx->programWant, 1ull << id);
+  return programIds[id];
+}
+
+// NOTE: called when programIds[i] can't be built: its slot is set to 0, which draws with the
+//       fallback
+static void contextProgramBroken(context_t *ctx, unsigned int i) {
+  fprintf(stderr, "%s: couldn't create shader program (%s,%s):\n", "contextProgramsPoll",
+          vertFnames[PROGRAM_BASE(i)], fragFnames[PROGRAM_BASE(i)]);
+  spotErrorPrint(); spotErrorClear();
+  contextLock(ctx);
+  if (ctx->program == programIds[i]) {
+    ctx->program = 0;
+  }
+  programIds[i] = 0;
+  contextUnlock(ctx);
+  ctx->programState[i] = ProgramBroken;
+}
+
+// NOTE: starts building programIds[i]: into program `into' if that's non-zero, else into a new
+//       program.  We use `spotProj3ProgramSubmitTo' to handle all the `glLinkProgram' specifics,
+//       with the per-vertex attributes we need.  A variant gets its uniforms as defines
+static spotProgramJob *contextProgramSubmit(unsigned int i, GLuint into) {
+  char gouraud[32], seamFix[32];
+  const char *defines[3];
+  unsigned int bits;
+
+  defines[0] = NULL;
+  if (i >= PROGRAM_STRIDE) {
+    bits = i/PROGRAM_STRIDE - 1;
+    sprintf(gouraud, "GOURAUD_MODE %d", !!(bits & VariantGouraud));
+    sprintf(seamFix, "SEAM_FIX %d", !!(bits & VariantSeamFix));
+    defines[0] = gouraud;
+    defines[1] = seamFix;
+    defines[2] = NULL;
+  }
+  return spotProj3ProgramSubmitTo(into, defines, vertFnames[PROGRAM_BASE(i)],
+                                  fragFnames[PROGRAM_BASE(i)]);
+}
+
+// NOTE: with -r, called when a shader file of programIds[i] has been saved: the program is
+//       built again, from scratch into a new program, which contextProgramReloaded swaps in
+//       once it links; until then (or if it doesn't), we keep drawing with the old one
+static void contextProgramReload(context_t *ctx, unsigned int i) {
+  GLint program;
+
+  if (ProgramUnbuilt == ctx->programState[i]) {
+    // NOTE: it'll be built from the new source when first asked for anyway
+    return;
+  }
+  if (ProgramBuilding == ctx->programState[i]) {
+    // NOTE: too late for the first build to matter, but the slot has to settle before a reload
+    //       can replace it
+    program = spotProgramFinish(ctx->programJob[i]);
+    ctx->programJob[i] = NULL;
+    ctx->programPending--;
+    if (program) {
+      contextProgramLearn(ctx, i, program);
+      ctx->programState[i] = ProgramReady;
+    } else {
+      contextProgramBroken(ctx, i);
+    }
+  }
+  if (ctx->programReload[i]) {
+    // NOTE: saved again before the last reload finished; that one is out of date
+    if ((program = spotProgramFinish(ctx->programReload[i]))) {
+      glDeleteProgram(program);
+    }
+    spotErrorClear();
+    ctx->programReload[i] = NULL;
+    ctx->programPending--;
+  }
+  printf("Reloading program (%s,%s)...\n", vertFnames[PROGRAM_BASE(i)], fragFnames[PROGRAM_BASE(i)]);
+  if ((ctx->programReload[i] = contextProgramSubmit(i, 0))) {
+    ctx->programPending++;
+  } else {
+    fprintf(stderr, "%s: couldn't reload shader program (%s,%s):\n", "contextProgramsPoll",
+            vertFnames[PROGRAM_BASE(i)], fragFnames[PROGRAM_BASE(i)]);
+    spotErrorPrint(); spotErrorClear();
+  }
+}
+
+// NOTE: finishes a reload of programIds[i].  If it worked, the new program takes the old one's
+//       place in programIds (and in ctx->program, if it was in use); the old one is kept until
+//       the next reload, since frames already made may still name it (see contextProgramUsable)
+static void contextProgramReloaded(context_t *ctx, unsigned int i) {
+  GLint program, old;
+
+  program = spotProgramFinish(ctx->programReload[i]);
+  ctx->programReload[i] = NULL;
+  ctx->programPending--;
+  if (!program) {
+    // NOTE: errors in the shaders are reported, but the session carries on with the old program
+    fprintf(stderr, "%s: couldn't reload shader program (%s,%s), keeping the old one:\n",
+            "contextProgramsPoll", vertFnames[PROGRAM_BASE(i)], fragFnames[PROGRAM_BASE(i)]);
+    spotErrorPrint(); spotErrorClear();
+    return;
+  }
+  contextProgramLearn(ctx, i, program);
+  contextLock(ctx);
+  old = programIds[i];
+  if (old && ctx->program == old) {
+    ctx->program = program;
+  }
+  programIds[i] = program;
+  contextUnlock(ctx);
+  if (ctx->programRetired[i]) {
+    glDeleteProgram(ctx->programRetired[i]);
+  }
+  ctx->programRetired[i] = old;
+  ctx->programState[i] = ProgramReady;
+  if (i < PROGRAM_STRIDE) {
+    // NOTE: the edit may have changed which uniforms are used
+    ctx->programVariable[i] = -1;
+  }
+  // NOTE: the locations have to be swapped in again even if GL happens to reuse an id
+  ctx->unilocProgram = 0;
+  ctx->dirty = 1;
+  printf("%d: Program (%s,%s) reloaded...\n", program, vertFnames[PROGRAM_BASE(i)],
+         fragFnames[PROGRAM_BASE(i)]);
+}
+
+// NOTE: starts building programs that have been asked for, and finishes whichever of them are
+//       done compiling.  Without KHR_parallel_shader_compile there's no asking, so then one
+//       program is finished (and maybe waited for) per call, to spread the waiting over several
+//       frames.  Returns the number of programs still pending
+unsigned int contextProgramsPoll(context_t *ctx) {
+  unsigned int i;
+  unsigned long long want;
+  int ready, waited=0;
+  GLint program;
+
+  if (ctx->watch && spotWatchPoll(ctx->watch)) {
+    for (i=0; i<PROGRAM_SLOTS; i++) {
+      if (PROGRAM_BASE(i) < ctx->programNum
+          && (ctx->watch->changed[ctx->programWatch[PROGRAM_BASE(i)][0]]
+              || ctx->watch->changed[ctx->programWatch[PROGRAM_BASE(i)][1]])) {
+        contextProgramReload(ctx, i);
+      }
+    }
+    memset(ctx->watch->changed, 0, ctx->watch->num*sizeof(int));
+  }
+  want = atomic_exchange(&ctx->programWant, 0);
+  for (i=0; i<PROGRAM_SLOTS && want; i++) {
+    if (!( (want & (1ull << i)) && ProgramUnbuilt == ctx->programState[i] )) {
+      continue;
+    }
+    // NOTE: built into the program object that contextGLInit already handed out as programIds[i]
+    ctx->programJob[i] = contextProgramSubmit(i, programIds[i]);
+    if (ctx->programJob[i]) {
+      ctx->programState[i] = ProgramBuilding;
+      ctx->programPending++;
+    } else {
+      contextProgramBroken(ctx, i);
+    }
+  }
+  for (i=0; i<PROGRAM_SLOTS && ctx->programPending; i++) {
+    if (ctx->programReload[i]) {
+      ready = spotProgramReady(ctx->programReload[i]);
+      if (ready && !(-1 == ready && waited)) {
+        waited = 1;
+        contextProgramReloaded(ctx, i);
+      }
+    }
+    if (!ctx->programJob[i]) {
+      continue;
+    }
+    ready = spotProgramReady(ctx->programJob[i]);
+    if (!ready || (-1 == ready && waited)) {
+      continue;
+    }
+    waited = 1;
+    program = spotProgramFinish(ctx->programJob[i]);
+    ctx->programJob[i] = NULL;
+    ctx->programPending--;
+    if (program) {
+      contextProgramLearn(ctx, i, program);
+      ctx->programState[i] = ProgramReady;
+      if (i < PROGRAM_STRIDE) {
+        printf("%d: Program (%s,%s) loaded...\n", program, vertFnames[i], fragFnames[i]);
+      } else {
+        printf("%d: Program (%s,%s) variant %u loaded...\n", program, vertFnames[PROGRAM_BASE(i)],
+               fragFnames[PROGRAM_BASE(i)], i/PROGRAM_STRIDE - 1);
+      }
+    } else {
+      contextProgramBroken(ctx, i);
+    }
+    // NOTE: whatever was drawn with the fallback should now be drawn again
+    if (ctx->programFallback) {
+      ctx->programFallback = 0;
+      ctx->dirty = 1;
+    }
+    if (!ctx->programPending && ctx->programTime) {
+      printf("%s: startup programs ready in %g sec\n", "contextGLInit",
+             spotTime() - ctx->programTime);
+      ctx->programTime = 0;
+    }
+  }
+  return ctx->programPending;
+}
+
+// NOTE: with -p, asks for the next program nobody has asked for yet (only the variants that
+//       would differ from each other); returns 0 if there's none
+int contextProgramsPrewarm(context_t *ctx) {
+  unsigned int i, base, bits;
+
+  for (i=0; i<PROGRAM_SLOTS; i++) {
+    if (ProgramUnbuilt != ctx->programState[i]) {
+      continue;
+    }
+    base = PROGRAM_BASE(i);
+    if (i >= PROGRAM_STRIDE) {
+      bits = i/PROGRAM_STRIDE - 1;
+      if (!( ctx->variants && ctx->programVariable[base] > 0
+             && !(bits & ~ctx->programVariable[base]) )) {
+        continue;
+      }
+    }
+    contextProgram(ctx, i);
+    return 1;
+  }
+  return 0;
+}
+
+// NOTE: the program to actually draw with when asked for the given one: the fallback if it's
+//       not built yet, or if it's not (any longer) one of programIds, and its replacement if it
+//       has been reloaded
+GLuint contextProgramUsable(context_t *ctx, GLuint program) {
+  unsigned int i;
+
+  for (i=0; program && i<PROGRAM_STRIDE; i++) {
+    if (programIds[i] == (GLint)program) {
+      if (ProgramReady == ctx->programState[i]) {
+        return program;
+      }
+      // NOTE: e.g. a program set directly from programIds, without `contextProgram'
+      if (ProgramUnbuilt == ctx->programState[i]) {
+        contextProgram(ctx, i);
+      }
+      break;
+    }
+    // NOTE: a frame made before a reload still names the program it replaced
+    if (ctx->programRetired[i] == program && ProgramReady == ctx->programState[i]) {
+      return programIds[i];
+    }
+  }
+  ctx->programFallback = 1;
+  return programIds[ID_FALLBACK];
+}
+
+// NOTE: given a (ready) program from contextProgramUsable, and the values of the uniforms named
+//       by enum VariantBits, returns the variant of the program that has those values built in,
+//       so that the shaders don't branch on them for every vertex and fragment.  The variant is
+//       asked for the first time it's wanted, and until it's ready the program itself (the
+//       "uber-shader") stands in for it
+GLuint contextProgramVariant(context_t *ctx, GLuint program, int gouraudMode, int seamFix) {
+  unsigned int i, v, bits;
+
+  for (i=0; i<PROGRAM_STRIDE; i++) {
+    if (programIds[i] == (GLint)program) {
+      break;
+    }
+  }
+  if (!ctx->variants || i == PROGRAM_STRIDE) {
+    return program;
+  }
+  if (-1 == ctx->programVariable[i]) {
+    // NOTE: only the uniforms the program actually uses are worth building variants for
+    ctx->programVariable[i] = ((-1 != ctx->unilocs[i].gouraudMode ? VariantGouraud : 0)
+                               | (-1 != ctx->unilocs[i].seamFix ? VariantSeamFix : 0));
+  }
+  if (!ctx->programVariable[i]) {
+    return program;
+  }
+  bits = ((gouraudMode ? VariantGouraud : 0) | (seamFix ? VariantSeamFix : 0));
+  v = i + PROGRAM_STRIDE*(1 + (bits & ctx->programVariable[i]));
+  if (ProgramReady == ctx->programState[v]) {
+    return programIds[v];
+  }
+  if (ProgramUnbuilt == ctx->programState[v]) {
+    contextProgram(ctx, v);
+  }
+  return program;
 }
 
 int contextGLInit(context_t *ctx) {
   const char me[]="contextGLInit";
+  // NOTE: the first four are the 2D textures (enum Textures), the last three the cube maps
+  //       (enum CubeMaps); TexHght should be "textimg/uchic-hght08.png"
+  char *imageName[7] = {"textimg/uchic-rgb.png", "textimg/uchic-norm08.png",
+                        "textimg/uchic-norm08.png", "textimg/check-rgb.png",
+                        "textimg/cube-sample.png", "textimg/cube-cool.png",
+                        "textimg/cube-place.png"};
+  int imageKind[7] = {ImageColor, ImageNormal, ImageNormal, ImageColor,
+                      ImageCubeMap, ImageCubeMap, ImageCubeMap};
+  // NOTE: the faces of CubeFaces, in the order of the GL cube map targets
+  const char *faceName[6] = {"textimg/pos_x.png", "textimg/neg_x.png",
+                             "textimg/pos_y.png", "textimg/neg_y.png",
+                             "textimg/pos_z.png", "textimg/neg_z.png"};
+  spotHandle imageH[7];
   unsigned int ii, i;
 
   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   glDisable(GL_CULL_FACE); // No backface culling for now
   glEnable(GL_DEPTH_TEST); // Yes, do depth testing
+  // NOTE: so the coarse (rough) levels of the cube maps filter across the edges of faces, rather
+  //       than showing each face's border
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
   /* Create shader program.  Note that the names of per-vertex attributes
      are specified here.  This includes  vertPos and vertNorm from last project
@@ -307,80 +1017,135 @@ int contextGLInit(context_t *ctx) {
   vertFnames[ID_SPOTLIGHT]="spotlight.vert";
   fragFnames[ID_SPOTLIGHT]="spotlight.frag";
 
-  // NOTE: we loop for as many shaders as are in our "stack" (NUM_PROGRAMS), and then once more
-  //       to pull in whatever shader was passed in via the terminal (or not, if we have
+  // NOTE: consider this the "invoked" or default shader paseed via the terminal; it will be
+  //       loaded last, and thus the first shader visible
+  vertFnames[NUM_PROGRAMS]=ctx->vertFname;
+  fragFnames[NUM_PROGRAMS]=ctx->fragFname;
+
+  // NOTE: linked programs are kept in SHADER_CACHE_DIR, so that only the first run (or the first
+  //       run after editing a shader or updating the driver) pays for compiling all of them
+  spotProgramCacheDirSet(SHADER_CACHE_DIR);
+  ctx->programTime = spotTime();
+  ctx->programPending = 0;
+  atomic_init(&ctx->programWant, 0);
+  // NOTE: we have a slot for as many shaders as are in our "stack" (NUM_PROGRAMS), and then one
+  //       more for whatever shader was passed in via the terminal (or not, if we have
   //       ctx->vertName==NULL)
-  const char *vertFname, *fragFname;
-  for (i=0; i<=NUM_PROGRAMS-(ctx->vertFname==NULL?1:0); i++) {
-    // NOTE: consider this the "invoked" or default shader paseed via the terminal; it will be
-    //       loaded last, and thus the first shader visible
-    if (i==NUM_PROGRAMS) {
-      vertFname=ctx->vertFname;
-      fragFname=ctx->fragFname;
-    // otherwise, we want to load our "stack" of shaders
-    } else {
-      vertFname = vertFnames[i];
-      fragFname = fragFnames[i];
-    }
-    // NOTE: use `spotProgramNew' to handle all the `glLinkProgram' specifics; we also specify the
-    //       per-vertex attributes we need
-    ctx->program = spotProgramNew(vertFname, fragFname,
-                                  "vertPos", spotVertAttrIndx_xyz,
-                                  "vertNorm", spotVertAttrIndx_norm,
-                                  "vertTex2", spotVertAttrIndx_tex2,
-                                  "vertRgb", spotVertAttrIndx_rgb,
-                                  "vertTang", spotVertAttrIndx_tang,
-                                  /* input name, attribute index pairs
-                                     MUST BE TERMINATED with NULL */
-                                  NULL);
+  ctx->programNum = NUM_PROGRAMS + (ctx->vertFname==NULL?0:1);
+  for (i=0; i<PROGRAM_SLOTS; i++) {
     // NOTE: we save the program id for easy retrieval from our callbacks; i here corresponds to
-    //       one of ID_SIMPLE, ID_PHONG, etc., so we can reset the gctx->program to
-    //       programIds[ID_${shader}] to switch shaders
-    programIds[i]=ctx->program;
-    if (!ctx->program) {
-      spotErrorAdd("%s: couldn't create shader program", me);
-      return 1;
+    //       one of ID_SIMPLE, ID_PHONG, etc. (or a variant of one), so we can reset the
+    //       gctx->program to contextProgram(gctx, ID_${shader}) to switch shaders.  Only the
+    //       (empty) program object is made here; nothing is compiled until the program is first
+    //       asked for.  Slots without shaders are left Broken, so they're never built
+    if (PROGRAM_BASE(i) < ctx->programNum) {
+      programIds[i] = glCreateProgram();
+      ctx->programState[i] = ProgramUnbuilt;
     } else {
-      printf("%d: Program (%s,%s) loaded...\n", ctx->program, vertFname, fragFname);
+      programIds[i] = 0;
+      ctx->programState[i] = ProgramBroken;
+    }
+    ctx->programJob[i] = NULL;
+  }
+  for (i=0; i<PROGRAM_STRIDE; i++) {
+    ctx->programVariable[i] = -1;
+  }
+  // NOTE: with -r, saving any of the shader files rebuilds the programs that use it
+  if (ctx->reload) {
+    if (!( ctx->watch = spotWatchNew() )) {
+      spotErrorAdd("%s: couldn't watch shader files", me);
+      return 1;
+    }
+    for (i=0; i<ctx->programNum; i++) {
+      ctx->programWatch[i][0] = spotWatchAdd(ctx->watch, vertFnames[i]);
+      ctx->programWatch[i][1] = spotWatchAdd(ctx->watch, fragFnames[i]);
+      if (-1 == ctx->programWatch[i][0] || -1 == ctx->programWatch[i][1]) {
+        spotErrorAdd("%s: couldn't watch (%s,%s)", me, vertFnames[i], fragFnames[i]);
+        return 1;
+      }
     }
   }
+  // NOTE: startup only builds the default program and the fallback, and only waits for the
+  //       fallback
+  ctx->program = contextProgram(ctx, ctx->programNum-1);
+  contextProgram(ctx, ID_FALLBACK);
+  contextProgramsPoll(ctx);
+  if (ctx->programJob[ID_FALLBACK]) {
+    if (!spotProgramFinish(ctx->programJob[ID_FALLBACK])) {
+      ctx->programJob[ID_FALLBACK] = NULL;
+      spotErrorAdd("%s: couldn't create fallback shader program", me);
+      return 1;
+    }
+    ctx->programJob[ID_FALLBACK] = NULL;
+    ctx->programPending--;
+    contextProgramLearn(ctx, ID_FALLBACK, programIds[ID_FALLBACK]);
+    ctx->programState[ID_FALLBACK] = ProgramReady;
+    printf("%d: Program (%s,%s) loaded...\n", programIds[ID_FALLBACK],
+           vertFnames[ID_FALLBACK], fragFnames[ID_FALLBACK]);
+  }
+  if (ProgramReady != ctx->programState[ID_FALLBACK]) {
+    spotErrorAdd("%s: couldn't create fallback shader program", me);
+    return 1;
+  }
 
   // NOTE: the following is equivalent to hitting '1' on the keyboard; i.e. default
   //       scene
   if (ctx->vertFname==NULL) {
-    gctx->program=programIds[ID_SPOTLIGHT];
+    gctx->program=contextProgram(gctx, ID_SPOTLIGHT);
   }
-
-  // NOTE: this sets the uniform locations for the _invoked_ shader
-  setUnilocs();
   
-  if (ctx->geom) {
-    for (ii=0; ii<ctx->geomNum; ii++) {
-      if (spotGeomGLInit(ctx->geom[ii])) {
-        spotErrorAdd("%s: trouble with geom[%u]", me, ii);
-        return 1;
-      }
+  for (ii=0; ii<ctx->geom->num; ii++) {
+    if (spotGeomGLInit(spotPoolItem(ctx->geom, ii))) {
+      spotErrorAdd("%s: trouble with geom %08x", me, ctx->geom->handle[ii]);
+      return 1;
     }
   }
-  if (ctx->image) {
-    for (ii=0; ii<ctx->imageNum; ii++) {
-				printf("ii: %d\n", ii);
-      if (ctx->image[ii]->data.v) {
-        // Only bother with GL init when image data has been set
-				if (ii==4 || ii==5 || ii==6) { // 5 is our cubemap
-					if (spotImageCubeMapGLInit(ctx->image[ii])) {
-						spotErrorAdd("%s: trouble with image[%u]", me, ii);
-						return 1;
-					} else {
-						printf("cubeMap: %d\n", ii);
-					}
-				} else if (spotImageGLInit(ctx->image[ii])) {
-          spotErrorAdd("%s: trouble with image[%u]", me, ii);
-          return 1;
-        }
+  // NOTE: with alpha, which is 0 where the background shows (see contextRender)
+  if (!( ctx->capture = spotCaptureNew(CAPTURE_SLOTS, CAPTURE_SAVES, SPOT_TRUE) )) {
+    spotErrorAdd("%s: couldn't set up saving frames", me);
+    return 1;
+  }
+  ctx->glReady = 1;
+
+  // load images
+  // NOTE: this waits for GL so the cube maps can be decoded straight into pixel buffers; all
+  //       seven are decoded at once, so this takes about as long as the biggest one
+  contextImagesAdd(ctx, imageH, imageName, imageKind, 7);
+  for (ii=0; ii<4; ii++) {
+    ctx->textureH[ii] = imageH[ii];
+  }
+  for (ii=0; ii<3; ii++) {
+    ctx->cubeMapH[ii] = imageH[4+ii];
+  }
+  ctx->cubeMapH[CubeFaces] = contextCubeMapFacesAdd(ctx, faceName);
+  if (ctx->pack) {
+    contextTexturesPack(ctx, imageKind);
+  }
+  // NOTE: the ambient light is the irradiance from the cube map being shown. Each cube map is
+  //       projected onto 9 spherical harmonics here, once; contextRender uploads the ones of
+  //       ctx->cubeMapId to irradianceBuffer only when that changes. Our Ka were chosen for a
+  //       white ambient light of 1, so the coefficients are scaled to keep the average (the
+  //       luminance of the constant term) at 1: the cube map gives the ambient light its color
+  //       and direction, not its brightness. A cube map that didn't load lights with white,
+  //       which is the constant ambient light we had before
+  for (ii=0; ii<4; ii++) {
+    spotImage *image = spotPoolGet(ctx->image, ctx->cubeMapH[ii]);
+    GLfloat *sh = ctx->cubeMapSH[ii][0], lum;
+    if (!image || spotImageCubeMapSH(ctx->cubeMapSH[ii], image)
+        || !( lum = 0.2126f*sh[0] + 0.7152f*sh[1] + 0.0722f*sh[2] )) {
+      memset(ctx->cubeMapSH[ii], 0, sizeof(ctx->cubeMapSH[ii]));
+      SPOT_V3_SET(sh, 1, 1, 1);
+    } else {
+      for (i=0; i<9*4; i++) {
+        sh[i] /= lum;
       }
     }
   }
+  ctx->irradianceBuffer = spotProj3IrradianceNew(sizeof(ctx->cubeMapSH[0]), NULL,
+                                                 GL_DYNAMIC_DRAW);
+  ctx->irradianceId = -1;
+  // NOTE: a missing image is reported but not fatal (as before); it just won't be drawn
+  spotErrorPrint(); spotErrorClear();
 
   // NOTE: set to view mode (default)
   gctx->viewMode = 1;
@@ -391,6 +1156,7 @@ int contextGLInit(context_t *ctx) {
   gctx->spinning = 0;
   gctx->minFilter = GL_NEAREST;
   gctx->magFilter = GL_NEAREST;
+  gctx->filterTex = 0;
   gctx->perVertexTexturingMode=1; // start in perVertexTexturingMode
   perVertexTexturing();
 
@@ -451,7 +1217,7 @@ int contextGLInit(context_t *ctx) {
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, ctx->image[3]->sizeX, ctx->image[3]->sizeY, 0,
       GL_RGB, GL_UNSIGNED_BYTE, ctx->image[3]->data.v);
   glGenerateMipmap(GL_TEXTURE_2D);
-  glUniform1i(ctx->uniloc.samplerD, 3);*/
+  glUniform1i(ctx->uniloc->samplerD, 3);*/
 
   return 0;
 }
@@ -464,18 +1230,48 @@ int contextGLDone(context_t *ctx) {
     spotErrorAdd("%s: got NULL pointer", me);
     return 1;
   }
-  if (ctx->geom) {
-    for (ii=0; ii<ctx->geomNum; ii++) {
-      spotGeomGLDone(ctx->geom[ii]);
+  for (ii=0; ii<ctx->geom->num; ii++) {
+    spotGeomGLDone(spotPoolItem(ctx->geom, ii));
+  }
+  for (ii=0; ii<ctx->image->num; ii++) {
+    if (((spotImage *)spotPoolItem(ctx->image, ii))->textureId) {
+      spotImageGLDone(spotPoolItem(ctx->image, ii));
     }
   }
-  if (ctx->image) {
-    for (ii=0; ii<ctx->imageNum; ii++) {
-      if (ctx->image[ii]->data.v) {
-        spotImageGLDone(ctx->image[ii]);
-      }
+  // NOTE: programs still compiling at exit are finished only to free their jobs
+  for (ii=0; ii<PROGRAM_SLOTS; ii++) {
+    if (ctx->programJob[ii]) {
+      spotProgramFinish(ctx->programJob[ii]);
+      ctx->programJob[ii] = NULL;
     }
+    if (ctx->programReload[ii]) {
+      glDeleteProgram(spotProgramFinish(ctx->programReload[ii]));
+      ctx->programReload[ii] = NULL;
+    }
+    if (ctx->programRetired[ii]) {
+      glDeleteProgram(ctx->programRetired[ii]);
+      ctx->programRetired[ii] = 0;
+    }
+  }
+  if (ctx->texArray) {
+    spotImageArrayGLDone(ctx->texArray);
+    ctx->texArray = spotImageArrayNix(ctx->texArray);
   }
+  if (ctx->irradianceBuffer) {
+    glDeleteBuffers(1, &(ctx->irradianceBuffer));
+    ctx->irradianceBuffer = 0;
+    ctx->irradianceId = -1;
+  }
+  ctx->watch = spotWatchNix(ctx->watch);
+  ctx->programPending = 0;
+  ctx->stream = spotStreamNix(ctx->stream);
+  // NOTE: frames still being saved are finished first
+  if (spotCapturePoll(ctx->capture, SPOT_TRUE)) {
+    fprintf(stderr, "%s: trouble saving frames:\n", me);
+    spotErrorPrint(); spotErrorClear();
+  }
+  ctx->capture = spotCaptureNix(ctx->capture);
+  ctx->glReady = 0;
   return 0;
 }
 
@@ -486,26 +1282,43 @@ context_t *contextNix(context_t *ctx) {
     return NULL;
   }
   if (ctx->geom) {
-    for (ii=0; ii<ctx->geomNum; ii++) {
-      spotGeomNix(ctx->geom[ii]);
+    // NOTE: this is a no-op for geoms from the arena, but not for any others
+    for (ii=0; ii<ctx->geom->num; ii++) {
+      spotGeomNix(spotPoolItem(ctx->geom, ii));
     }
-    free(ctx->geom);
+    spotPoolNix(ctx->geom);
   }
+  spotArenaNix(ctx->arena);
+  free(ctx->geomRemove);
+  free(ctx->drawGeom);
+  frameTripleDone(&ctx->frames);
+  pthread_mutex_destroy(&ctx->lock);
+  pthread_mutex_destroy(&ctx->wantLock);
+  pthread_cond_destroy(&ctx->wantCond);
   if (ctx->image) {
-    for (ii=0; ii<ctx->imageNum; ii++) {
-      spotImageNix(ctx->image[ii]);
+    for (ii=0; ii<ctx->image->num; ii++) {
+      spotImageNix(spotPoolItem(ctx->image, ii));
     }
-    free(ctx->image);
+    spotPoolNix(ctx->image);
   }
   free(ctx);
   return NULL;
 }
 
-int contextDraw(context_t *ctx) {
-  const char me[]="contextDraw";
-  unsigned int gi;
-  GLfloat modelMat[16];
-  GLfloat thetaPerSecU, thetaPerSecV, thetaPerSecN;
+// NOTE: the update stage: everything about the next frame that doesn't involve OpenGL
+//       (animation, camera and model transforms, copying out materials) goes into frame, for
+//       contextRender. With a separate update thread this is all it runs, and it has the
+//       context to itself (holding ctx->lock)
+int contextUpdate(context_t *ctx, frame_t *frame) {
+  const char me[]="contextUpdate";
+  unsigned int gi, oi;
+  spotGeom *geom;
+  spotImage *image;
+  frameObject_t *obj;
+  GLfloat thetaPerSecU, thetaPerSecV, thetaPerSecN, viewProj[16];
+
+  // NOTE: we update UVN every step
+  updateUVN(ctx->camera.uvn, ctx->camera.at, ctx->camera.from, ctx->camera.up);
 
   if (ctx->buttonDown) {
     /* When the mouse is down, use a velocity of zero */
@@ -531,16 +1344,199 @@ int contextDraw(context_t *ctx) {
   rotate_model_UV(gctx->angleU, -gctx->angleV);
 	rotate_model_N(-gctx->angleN);
 
+  // NOTE: we must normalize our UVN matrix
+  norm_M4(gctx->camera.uvn);
+	inverseUVN(gctx->camera.inverse_uvn, gctx->camera.uvn);
+
+  frame->program = ctx->program;
+  image = spotPoolGet(ctx->image, ctx->cubeMapH[ctx->cubeMapId]);
+  frame->cubeMapTex = image ? image->textureId : 0;
+  frame->cubeMapId = ctx->cubeMapId;
+  // NOTE: recall that textureH[TexRgb] is "uchic-rgb.png"
+  image = spotPoolGet(ctx->image, ctx->textureH[TexRgb]);
+  frame->rgbTex = image ? image->textureId : 0;
+  frame->arrayTex = ctx->texArray ? ctx->texArray->textureId : 0;
+  frame->minFilter = ctx->minFilter;
+  frame->magFilter = ctx->magFilter;
+  SPOT_V3_COPY(frame->bgColor, ctx->bgColor);
+  SPOT_M4_SET_2(frame->viewMatrix, gctx->camera.uvn);
+  SPOT_M4_SET_2(frame->inverseViewMatrix, gctx->camera.inverse_uvn);
+  SPOT_M4_SET_2(frame->projMatrix, gctx->camera.proj);
+  SPOT_V3_COPY(frame->lightDir, ctx->lightDir);
+  SPOT_V3_COPY(frame->lightColor, ctx->lightColor);
+  SPOT_V3_COPY(frame->spotPoint, ctx->spotlight.from);
+  SPOT_V3_COPY(frame->spotUp, ctx->spotlight.up);
+  frame->penumbra = ctx->spotlight.fov;
+  frame->rStart = ctx->spotlight.near;
+  frame->rEnd = ctx->spotlight.far;
+  frame->gouraudMode = ctx->gouraudMode;
+  frame->seamFix = ctx->seamFix;
+  frame->sceneGeomOffset = sceneGeomOffset;
+
+  if (frameReserve(frame, ctx->geom->num)) {
+    spotErrorAdd("%s: couldn't make room for %u objects", me, ctx->geom->num);
+    return 1;
+  }
+  // NOTE: the shaders get each object's full transforms, multiplied out once here instead of
+  //       once per vertex
+  SPOT_M4_MUL(viewProj, frame->projMatrix, frame->viewMatrix);
+  // NOTE: only live objects are in the pool, densely packed, so this touches nothing else
+  for (gi=0; gi<ctx->geom->num; gi++) {
+    geom = spotPoolItem(ctx->geom, gi);
+    obj = frame->object + gi;
+    obj->geomH = ctx->geom->handle[gi];
+    // NOTE: the slot of an object's handle doesn't change while it lives, unlike its position gi
+    //       in the pool, so the shaders get that
+    obj->slot = SPOT_HANDLE_SLOT(ctx->geom->handle[gi]);
+    // NOTE: -1 for objects whose texture isn't in the texture array (or that aren't one of
+    //       enum Objects), which the shaders sample with samplerA as before
+    obj->layer = -1;
+    for (oi=0; oi<3; oi++) {
+      if (ctx->geom->handle[gi] == ctx->objectH[oi]) {
+        obj->layer = ctx->texLayer[ctx->objectTex[oi]];
+      }
+    }
+    set_model_transform(obj->modelMatrix, geom);
+    updateNormals(obj->normalMatrix, obj->modelMatrix);
+    // NOTE: we normalize the model matrix; while we may not need to, it is cheap to do so
+    SPOT_M4_SET_2(obj->modelMatrixN, obj->modelMatrix);
+    norm_M4(obj->modelMatrixN);
+    // NOTE: we update normals in our `matrixFunctions.c' functions on a case-by-case basis
+    updateNormals(obj->normalMatrixN, obj->modelMatrixN);
+    SPOT_M4_MUL(obj->modelViewMatrix, frame->viewMatrix, obj->modelMatrix);
+    SPOT_M4_MUL(obj->mvpMatrix, viewProj, obj->modelMatrix);
+    SPOT_M4_MUL(obj->modelViewMatrixN, frame->viewMatrix, obj->modelMatrixN);
+    SPOT_M4_MUL(obj->mvpMatrixN, viewProj, obj->modelMatrixN);
+    SPOT_V3_COPY(obj->objColor, geom->objColor);
+    obj->Ka = geom->Ka;
+    obj->Kd = geom->Kd;
+    obj->Ks = geom->Ks;
+    obj->shexp = geom->shexp;
+  }
+  frame->objectNum = ctx->geom->num;
+  frame->running = ctx->running;
+  frame->animating = contextAnimating(ctx);
+  return 0;
+}
+
+// NOTE: whether the uniform at location loc (the idx'th of uniloc_t) of the current program needs
+//       to be given value (of size bytes): not if the program doesn't have it (its location is
+//       -1), and not if that's the value we last gave it
+static int uniformChanged(context_t *ctx, GLint loc, unsigned int idx,
+                          const void *value, size_t size) {
+  unishadow_t *shadow;
+
+  if (-1 == loc) {
+    return 0;
+  }
+  shadow = ctx->unishadow;
+  if (shadow->known[idx] && !memcmp(shadow->value[idx], value, size)) {
+    ctx->uniformHit++;
+    return 0;
+  }
+  memcpy(shadow->value[idx], value, size);
+  shadow->known[idx] = 1;
+  ctx->uniformMiss++;
+  return 1;
+}
+
+// NOTE: set uniform V of the current program, if it has it and doesn't already have that value
+#define UNIFORM_CHANGED(V, P, SIZE) \
+  uniformChanged(ctx, ctx->uniloc->V, offsetof(uniloc_t, V)/sizeof(GLint), (P), (SIZE))
+#define UNIFORM_1I(V, X) \
+  do { GLint val_ = (X); \
+    if (UNIFORM_CHANGED(V, &val_, sizeof(val_))) glUniform1i(ctx->uniloc->V, val_); } while (0)
+#define UNIFORM_1F(V, X) \
+  do { GLfloat val_ = (X); \
+    if (UNIFORM_CHANGED(V, &val_, sizeof(val_))) glUniform1f(ctx->uniloc->V, val_); } while (0)
+#define UNIFORM_3FV(V, P) \
+  do { if (UNIFORM_CHANGED(V, (P), 3*sizeof(GLfloat))) \
+      glUniform3fv(ctx->uniloc->V, 1, (P)); } while (0)
+#define UNIFORM_M3(V, P) \
+  do { if (UNIFORM_CHANGED(V, (P), 9*sizeof(GLfloat))) \
+      glUniformMatrix3fv(ctx->uniloc->V, 1, GL_FALSE, (P)); } while (0)
+#define UNIFORM_M4(V, P) \
+  do { if (UNIFORM_CHANGED(V, (P), 16*sizeof(GLfloat))) \
+      glUniformMatrix4fv(ctx->uniloc->V, 1, GL_FALSE, (P)); } while (0)
+
+// NOTE: the render stage: issues the GL calls to draw frame, without looking at anything in
+//       ctx that the update stage might be changing
+// NOTE: nothing of ours changes every frame (the per-vertex colors go to their static buffers,
+//       see perVertexTexturing), so the stream is only made once some geom to be drawn sets a
+//       streamMask, with 3 regions so the CPU can fill one while the GPU may still be reading the
+//       previous two. The regions grow (between frames) to fit whatever is streamed, so a bigger
+//       geom added later doesn't make every frame fail
+static int contextStreamReserve(context_t *ctx, const frame_t *frame) {
+  const char me[]="contextStreamReserve";
+  unsigned int gi;
+  GLsizeiptr size;
+
+  size = 0;
+  for (gi=0; gi<frame->objectNum; gi++) {
+    if (ctx->drawGeom[gi] && ctx->drawGeom[gi]->streamMask) {
+      size += spotGeomStreamSize(ctx->drawGeom[gi], ctx->drawGeom[gi]->streamMask);
+    }
+  }
+  if (!size) {
+    return 0;
+  }
+  if (!ctx->stream) {
+    if (!( ctx->stream = spotStreamNew(size, 3) )) {
+      spotErrorAdd("%s: couldn't create %ld-byte vertex stream", me, (long)size);
+      return 1;
+    }
+  } else if (spotStreamGrow(ctx->stream, size)) {
+    spotErrorAdd("%s: couldn't grow vertex stream to %ld bytes", me, (long)size);
+    return 1;
+  }
+  return 0;
+}
+
+int contextRender(context_t *ctx, const frame_t *frame) {
+  const char me[]="contextRender";
+  unsigned int gi;
+  const frameObject_t *obj;
+  spotGeom *geom, **newGeom;
+  GLuint program, filterTex;
+  GLenum filterTarget;
+
+  // NOTE: the frame only has its objects' handles. The update thread may be changing the pool
+  //       meanwhile, so they're looked up with it locked out; the geoms themselves are only freed
+  //       on this thread (by contextGeomsSettle), so what's found stays valid while we draw
+  if (frame->objectNum > ctx->drawGeomCap) {
+    if (!( newGeom = (spotGeom **)realloc(ctx->drawGeom,
+                                          frame->objectNum*sizeof(spotGeom *)) )) {
+      spotErrorAdd("%s: couldn't make room for %u objects", me, frame->objectNum);
+      return 1;
+    }
+    ctx->drawGeom = newGeom;
+    ctx->drawGeomCap = frame->objectNum;
+  }
+  contextLock(ctx);
+  for (gi=0; gi<frame->objectNum; gi++) {
+    geom = spotPoolGet(ctx->geom, frame->object[gi].geomH);
+    // NOTE: NULL for one removed since the frame was made, or not yet set up
+    ctx->drawGeom[gi] = geom && geom->vaoId ? geom : NULL;
+  }
+  contextUnlock(ctx);
+
+  program = contextProgramUsable(ctx, frame->program);
+  program = contextProgramVariant(ctx, program, frame->gouraudMode, frame->seamFix);
+  // NOTE: uniform locations and vertex attributes are per-program; each program's were learned
+  //       when it linked
+  if (program != ctx->unilocProgram) {
+    contextProgramSwitch(ctx, program);
+  }
+
   /* re-assert which program is being used (AntTweakBar uses its own) */
-  glUseProgram(ctx->program); 
+  glUseProgram(program); 
 
   /* background color; setting alpha=0 means that we'll see the
-     background color in the render window, but upon doing
-     "spotImageScreenshot(img, SPOT_TRUE)" (SPOT_TRUE for "withAlpha")
-     we'll get a meaningful alpha channel, so that the image can
-     recomposited with a different background, or used in programs
+     background color in the render window, but the frames saved
+     (by contextCapture, with alpha) get a meaningful alpha channel,
+     so that the image can be recomposited with a different background, or used in programs
      (including web browsers) that respect the alpha channel */
-  glClearColor(ctx->bgColor[0], ctx->bgColor[1], ctx->bgColor[2], 0.0f);
+  glClearColor(frame->bgColor[0], frame->bgColor[1], frame->bgColor[2], 0.0f);
   /* Clear the window and the depth buffer */
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   
@@ -552,72 +1548,114 @@ int contextDraw(context_t *ctx) {
      pg 279.  Also, http://tinyurl.com/7bvnej3 is amusing and
      informative */
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, ctx->image[4+ctx->cubeMapId]->textureId);
-  glUniform1i(ctx->uniloc.cubeMap, 0);
+  // NOTE: the samplers were given their units (spotProj3Unit_*) when their programs linked
+  glActiveTexture(GL_TEXTURE0 + spotProj3Unit_cubeMap);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, frame->cubeMapTex);
+  // NOTE: the buffer stays bound to SPOT_PROJ3_IRRADIANCE_BINDING, so it's only written when the
+  //       cube map changes
+  if (frame->cubeMapId != ctx->irradianceId) {
+    glBindBuffer(GL_UNIFORM_BUFFER, ctx->irradianceBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ctx->cubeMapSH[0]),
+                    ctx->cubeMapSH[frame->cubeMapId]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ctx->irradianceId = frame->cubeMapId;
+  }
 
-  // NOTE: recall that image[0] is "uchic-rgb.png"
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, ctx->image[0]->textureId);
-  glUniform1i(ctx->uniloc.samplerA, 1);
+  glActiveTexture(GL_TEXTURE0 + spotProj3Unit_samplerA);
+  glBindTexture(GL_TEXTURE_2D, frame->rgbTex);
+  // NOTE: with -a, one bind of the texture array covers every object's texture
+  if (frame->arrayTex) {
+    glActiveTexture(GL_TEXTURE0 + spotProj3Unit_samplerArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, frame->arrayTex);
+  }
+  // NOTE: the filtering mode is state of the texture itself, so it is only set when it changes;
+  //       TexRgb is in the texture array when there is one
+  filterTex = frame->arrayTex ? frame->arrayTex : frame->rgbTex;
+  filterTarget = frame->arrayTex ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+  if (filterTex && (filterTex != ctx->filterTex || frame->minFilter != ctx->filterMin
+                    || frame->magFilter != ctx->filterMag)) {
+    glTexParameteri(filterTarget, GL_TEXTURE_MIN_FILTER, frame->minFilter);
+    glTexParameteri(filterTarget, GL_TEXTURE_MAG_FILTER, frame->magFilter);
+    ctx->filterTex = filterTex;
+    ctx->filterMin = frame->minFilter;
+    ctx->filterMag = frame->magFilter;
+  }
+  if (frame->arrayTex) {
+    glActiveTexture(GL_TEXTURE0 + spotProj3Unit_samplerA);
+  }
 
   // NOTE: recall that image[0] is "uchic-norm08.png"
 /*  glActiveTexture(GL_TEXTURE2);
   glBindTexture(GL_TEXTURE_2D, ctx->image[1]->textureId);
-  glUniform1i(ctx->uniloc.samplerB, 2);
+  UNIFORM_1I(samplerB, 2);
 
   glActiveTexture(GL_TEXTURE3);
   glBindTexture(GL_TEXTURE_2D, ctx->image[2]->textureId);
-  glUniform1i(ctx->uniloc.samplerC, 3); */
-
-  // NOTE: we must normalize our UVN matrix
-  norm_M4(gctx->camera.uvn);
-	inverseUVN(gctx->camera.inverse_uvn, gctx->camera.uvn);
+  UNIFORM_1I(samplerC, 3); */
 
   // NOTE: update our unilocs
-  glUniformMatrix4fv(ctx->uniloc.viewMatrix, 1, GL_FALSE, gctx->camera.uvn);
-  glUniformMatrix4fv(ctx->uniloc.inverseViewMatrix, 1, GL_FALSE, gctx->camera.inverse_uvn);
-  glUniformMatrix4fv(ctx->uniloc.projMatrix, 1, GL_FALSE, gctx->camera.proj);
-  glUniform3fv(ctx->uniloc.lightDir, 1, ctx->lightDir);
-  glUniform3fv(ctx->uniloc.spotPoint, 1, ctx->spotlight.from);
-  glUniform3fv(ctx->uniloc.spotUp, 1, ctx->spotlight.up);
-	glUniform1f(ctx->uniloc.penumbra, ctx->spotlight.fov);
-	glUniform1f(ctx->uniloc.rStart, ctx->spotlight.near);
-	glUniform1f(ctx->uniloc.rEnd, ctx->spotlight.far);
-  glUniform3fv(ctx->uniloc.lightColor, 1, ctx->lightColor);
-  glUniform1i(ctx->uniloc.gouraudMode, ctx->gouraudMode);
-  glUniform1i(ctx->uniloc.seamFix, ctx->seamFix);
-
-  for (gi=0; gi<ctx->geomNum; gi++) {
-    set_model_transform(modelMat, ctx->geom[gi]);
-    glUniformMatrix4fv(ctx->uniloc.modelMatrix, 
-                       1, GL_FALSE, modelMat);
-    updateNormals(gctx->geom[gi]->normalMatrix, modelMat);
-    glUniformMatrix3fv(ctx->uniloc.normalMatrix,
-                       1, GL_FALSE, ctx->geom[gi]->normalMatrix);
-    glUniform3fv(ctx->uniloc.objColor, 1, ctx->geom[gi]->objColor);
-    glUniform1f(ctx->uniloc.Ka, ctx->geom[gi]->Ka);
-    glUniform1f(ctx->uniloc.Kd, ctx->geom[gi]->Kd);
-    spotGeomDraw(ctx->geom[gi]);
+  UNIFORM_M4(viewMatrix, frame->viewMatrix);
+  UNIFORM_M4(inverseViewMatrix, frame->inverseViewMatrix);
+  UNIFORM_M4(projMatrix, frame->projMatrix);
+  UNIFORM_3FV(lightDir, frame->lightDir);
+  UNIFORM_3FV(spotPoint, frame->spotPoint);
+  UNIFORM_3FV(spotUp, frame->spotUp);
+	UNIFORM_1F(penumbra, frame->penumbra);
+	UNIFORM_1F(rStart, frame->rStart);
+	UNIFORM_1F(rEnd, frame->rEnd);
+  UNIFORM_3FV(lightColor, frame->lightColor);
+  UNIFORM_1I(gouraudMode, frame->gouraudMode);
+  UNIFORM_1I(seamFix, frame->seamFix);
+
+  // NOTE: per-frame vertex data goes to the GPU before any drawing; it stays valid until the
+  //       spotStreamFrameEnd below
+  if (contextStreamReserve(ctx, frame)) {
+    spotErrorAdd("%s: trouble with vertex stream", me);
+    return 1;
+  }
+  for (gi=0; ctx->stream && gi<frame->objectNum; gi++) {
+    if (ctx->drawGeom[gi] && spotGeomStream(ctx->drawGeom[gi], ctx->stream)) {
+      spotErrorAdd("%s: trouble streaming object %u", me, gi);
+      return 1;
+    }
+  }
+
+  for (gi=0; gi<frame->objectNum; gi++) {
+    if (!ctx->drawGeom[gi]) {
+      continue;
+    }
+    obj = frame->object + gi;
+    UNIFORM_M4(modelMatrix, obj->modelMatrix);
+    UNIFORM_M4(modelViewMatrix, obj->modelViewMatrix);
+    UNIFORM_M4(mvpMatrix, obj->mvpMatrix);
+    UNIFORM_M3(normalMatrix, obj->normalMatrix);
+    UNIFORM_3FV(objColor, obj->objColor);
+    UNIFORM_1F(Ka, obj->Ka);
+    UNIFORM_1F(Kd, obj->Kd);
+    UNIFORM_1F(shexp, obj->shexp);
+    UNIFORM_1I(layer, obj->layer);
+    spotGeomDrawMask(ctx->drawGeom[gi], ctx->attrMask);
   }
 
   // NOTE: update our geom-specific unilocs
-  for (gi=sceneGeomOffset; gi<ctx->geomNum; gi++) {
-    set_model_transform(modelMat, ctx->geom[gi]);
-    // NOTE: we normalize the model matrix; while we may not need to, it is cheap to do so
-    norm_M4(modelMat);
-    glUniformMatrix4fv(ctx->uniloc.modelMatrix, 1, GL_FALSE, modelMat);
-    // NOTE: we update normals in our `matrixFunctions.c' functions on a case-by-case basis
-    updateNormals(gctx->geom[gi]->normalMatrix, modelMat);
-    glUniformMatrix3fv(ctx->uniloc.normalMatrix, 1, GL_FALSE, ctx->geom[gi]->normalMatrix);
+  for (gi=frame->sceneGeomOffset; gi<frame->objectNum; gi++) {
+    if (!ctx->drawGeom[gi]) {
+      continue;
+    }
+    obj = frame->object + gi;
+    UNIFORM_M4(modelMatrix, obj->modelMatrixN);
+    UNIFORM_M4(modelViewMatrix, obj->modelViewMatrixN);
+    UNIFORM_M4(mvpMatrix, obj->mvpMatrixN);
+    UNIFORM_M3(normalMatrix, obj->normalMatrixN);
     //
-    glUniform3fv(ctx->uniloc.objColor, 1, ctx->geom[gi]->objColor);
-    glUniform1f(ctx->uniloc.Ka, ctx->geom[gi]->Ka);
-    glUniform1f(ctx->uniloc.Kd, ctx->geom[gi]->Kd);
-    glUniform1f(ctx->uniloc.Ks, ctx->geom[gi]->Ks);
-    glUniform1i(ctx->uniloc.gi, gi);
-    glUniform1f(ctx->uniloc.shexp, ctx->geom[gi]->shexp);
-    spotGeomDraw(ctx->geom[gi]);
+    UNIFORM_3FV(objColor, obj->objColor);
+    UNIFORM_1F(Ka, obj->Ka);
+    UNIFORM_1F(Kd, obj->Kd);
+    UNIFORM_1F(Ks, obj->Ks);
+    UNIFORM_1I(gi, obj->slot);
+    UNIFORM_1I(layer, obj->layer);
+    UNIFORM_1F(shexp, obj->shexp);
+    spotGeomDrawMask(ctx->drawGeom[gi], ctx->attrMask);
   }
   
   /* These lines are also related to using textures.  We finish by
@@ -628,10 +1666,18 @@ int contextDraw(context_t *ctx) {
   glActiveTexture(GL_TEXTURE2);
   glBindTexture(GL_TEXTURE_2D, 2);
   glActiveTexture(GL_TEXTURE1); */
-  glBindTexture(GL_TEXTURE_2D, 1);
+  // NOTE: this used to bind texture name 1, which is only a 2D texture if that happened to be
+  //       made first (with -a it's a cube map); unit 1 is bound again at the start of each frame
+  glBindTexture(GL_TEXTURE_2D, 0);
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, 0);
 
+  // NOTE: done with this frame's region of the stream
+  if (ctx->stream && spotStreamFrameEnd(ctx->stream)) {
+    spotErrorAdd("%s: trouble ending stream frame", me);
+    return 1;
+  }
+
   /* You are welcome to do error-checking with higher granularity than
      just once per render, in which case this error checking loop
      should be repackaged into its own function. */
@@ -646,19 +1692,31 @@ int contextDraw(context_t *ctx) {
   return 0;
 }
 
+// NOTE: update and render in one go, for when there is no separate update thread
+int contextDraw(context_t *ctx) {
+  const char me[]="contextDraw";
+  frame_t *frame;
+
+  frame = frameTripleBack(&ctx->frames);
+  if (contextUpdate(ctx, frame)) {
+    spotErrorAdd("%s: trouble updating", me);
+    return 1;
+  }
+  return contextRender(ctx, frame);
+}
+
 // NOTE: we use a callback here, since toggling perVertexTexturing requires the loading
-//       of different shaders (and thus updating unilocs)
+//       of different shaders
 static void TW_CALL setPerVertexTexturingCallback(const void *value, void *clientData) {
   gctx->perVertexTexturingMode = *((const int *) value);
   fprintf(stderr, gctx->perVertexTexturingMode ? "Per-vertex Texturing: ON\n" : "Per-vertex Texturing: OFF\n");
   if (perVertexTexturing()) {
     printf("\tLoading shader 'simple' with id=%d\n", programIds[ID_SIMPLE]);
-    gctx->program=programIds[ID_SIMPLE];
+    gctx->program=contextProgram(gctx, ID_SIMPLE);
   } else {
     printf("\tLoading shader 'texture' with id=%d\n", programIds[ID_TEXTURE]);
-    gctx->program=programIds[ID_TEXTURE];
+    gctx->program=contextProgram(gctx, ID_TEXTURE);
   }
-  setUnilocs();
 }
 
 static void TW_CALL getPerVertexTexturingCallback(void *value, void *clientData) {
@@ -666,24 +1724,23 @@ static void TW_CALL getPerVertexTexturingCallback(void *value, void *clientData)
 }
 
 // NOTE: we use a callback here, since toggling bumpMapping requires the loading
-//       of different shaders (and thus updating unilocs); additionally, we ensure
+//       of different shaders; additionally, we ensure
 //       parallaxMapping is off
 static void TW_CALL setBumpMappingCallback(const void *value, void *clientData) {
   gctx->bumpMappingMode = *((const enum BumpMappingModes *) value);
   switch (gctx->bumpMappingMode) {
     case Bump:
       printf("\tLoading shader 'bump' with id=%d\n", programIds[ID_BUMP]);
-      gctx->program=programIds[ID_BUMP];
+      gctx->program=contextProgram(gctx, ID_BUMP);
       break;
     case Parallax:
       printf("\tLoading shader 'parallax' with id=%d\n", programIds[ID_PARALLAX]);
-      gctx->program=programIds[ID_PARALLAX];
+      gctx->program=contextProgram(gctx, ID_PARALLAX);
       break;
     default: // Disabled
       printf("\tLoading shader 'texture' with id=%d\n", programIds[ID_TEXTURE]);
-      gctx->program=programIds[ID_TEXTURE];
+      gctx->program=contextProgram(gctx, ID_TEXTURE);
   }
-  setUnilocs();
 }
 
 static void TW_CALL getBumpMappingCallback(void *value, void *clientData) {
@@ -702,6 +1759,9 @@ static void TW_CALL setCubeMapCallback(const void *value, void *clientData) {
 		case CubePlace:
 			gctx->cubeMapId = 2;
 			break;
+		case CubeFaces:
+			gctx->cubeMapId = 3;
+			break;
 	}
 }
 
@@ -712,16 +1772,13 @@ static void TW_CALL setShaderCallback(const void *value, void *clientData) {
 	enum Shaders shader = *((const enum Shaders *) value);
 	switch (shader) {
 		case PhongShader:
-			gctx->program = programIds[ID_PHONG];
-			setUnilocs();
+			gctx->program = contextProgram(gctx, ID_PHONG);
 			break;
 		case CubeShader:
-			gctx->program = programIds[ID_CUBE];
-			setUnilocs();
+			gctx->program = contextProgram(gctx, ID_CUBE);
 			break;
 		case SpotlightShader:
-			gctx->program = programIds[ID_SPOTLIGHT];
-			setUnilocs();
+			gctx->program = contextProgram(gctx, ID_SPOTLIGHT);
 			break;
 	}
 }
@@ -740,21 +1797,17 @@ static void TW_CALL getShaderCallback(void *value, void *clientData) {
 
 static void TW_CALL setObjectCallback(const void *value, void *clientData) {
 	enum Objects object = *((const enum Objects *) value);
-	switch (object) {
-		case Sphere:
-			gctx->gi = 0;
-			break;
-		case Softcube:
-			gctx->gi = 1;
-			break;
-		case Cube:
-			gctx->gi = 2;
-			break;
-	}
+	gctx->gi = gctx->objectH[object];
 }
 
 static void TW_CALL getObjectCallback(void *value, void *clientData) {
-  *((int *) value) = gctx->gi;
+	int object;
+	for (object=Sphere; object<Cube; object++) {
+		if (gctx->gi == gctx->objectH[object]) {
+			break;
+		}
+	}
+  *((int *) value) = object;
 }
 
 
@@ -784,7 +1837,6 @@ static void TW_CALL setFilteringCallback(const void *value, void *clientData) {
     default:
       printf("\tDEFAULT\n");
   }
-  setUnilocs();
 }
 
 static void TW_CALL getFilteringCallback(void *value, void *clientData) {
@@ -794,19 +1846,24 @@ static void TW_CALL getFilteringCallback(void *value, void *clientData) {
 // NOTE: here are our tweak bar definitions
 int updateTweakBarVars(int scene) {
   int EE=0;
+  spotGeom *sphere=spotPoolGet(gctx->geom, gctx->objectH[Sphere]);
   if (!EE) EE |= !TwRemoveAllVars(gctx->tbar);
+  // NOTE: the tweak bar holds on to these pointers, which is fine since pooled objects don't
+  //       move; just don't remove the sphere without calling this again
+  if (sphere) {
   if (!EE) EE |= !TwAddVarRW(gctx->tbar, "Ka",
-                             TW_TYPE_FLOAT, &(gctx->geom[0]->Ka),
+                             TW_TYPE_FLOAT, &(sphere->Ka),
                              " label='Ka' min=0.0 max=1.0 step=0.005");
   if (!EE) EE |= !TwAddVarRW(gctx->tbar, "Kd",
-                             TW_TYPE_FLOAT, &(gctx->geom[0]->Kd),
+                             TW_TYPE_FLOAT, &(sphere->Kd),
                              " label='Kd' min=0.0 max=1.0 step=0.005");
   if (!EE) EE |= !TwAddVarRW(gctx->tbar, "Ks",
-                             TW_TYPE_FLOAT, &(gctx->geom[0]->Ks),
+                             TW_TYPE_FLOAT, &(sphere->Ks),
                              " label='Ks' min=0.0 max=1.0 step=0.005");
   if (!EE) EE |= !TwAddVarRW(gctx->tbar, "shexp",
-                             TW_TYPE_FLOAT, &(gctx->geom[0]->shexp),
+                             TW_TYPE_FLOAT, &(sphere->shexp),
                              " label='shexp' min=0.0 max=100.0 step=0.05");
+  }
   if (!EE) EE |= !TwAddVarCB(gctx->tbar, "shader",
 														 twShaders, setShaderCallback,
 														 getShaderCallback, &(gctx->program),
@@ -871,7 +1928,7 @@ int createTweakBar(context_t *ctx, int scene) {
   twBumpMappingModes=TwDefineEnum("BumpMappingModes", twBumpMappingModesEV, 3);
   twFilteringModes=TwDefineEnum("FilteringModes", twFilteringModesEV, 4);
   twObjects=TwDefineEnum("Objects", twObjectsEV, 3);
-  twCubeMaps=TwDefineEnum("CubeMap", twCubeMapsEV, 3);
+  twCubeMaps=TwDefineEnum("CubeMap", twCubeMapsEV, 4);
   twShaders=TwDefineEnum("Shader", twShadersEV, 3);
   
   /* Create a tweak bar for interactive parameter adjustment */
@@ -912,15 +1969,216 @@ int createTweakBar(context_t *ctx, int scene) {
   return 0;
 }
 
+// NOTE: with a separate update thread, the context is shared, so the render thread takes this
+//       around anything (like AntTweakBar) that reads or writes it; otherwise this does nothing
+void contextLock(context_t *ctx) {
+  if (ctx->threaded) {
+    pthread_mutex_lock(&ctx->lock);
+  }
+}
+
+void contextUnlock(context_t *ctx) {
+  if (ctx->threaded) {
+    pthread_mutex_unlock(&ctx->lock);
+  }
+}
+
+// NOTE: prints how many uniform uploads uniformChanged let through and how many it saved, since
+//       the last time
+static void contextUniformsReport(context_t *ctx) {
+  if (ctx->uniformMiss) {
+    printf("uniforms: %lu uploaded, %lu skipped as unchanged (%.1f%%)\n", ctx->uniformMiss,
+           ctx->uniformHit, 100.0*ctx->uniformHit/(ctx->uniformHit + ctx->uniformMiss));
+  }
+  ctx->uniformMiss = ctx->uniformHit = 0;
+}
+
+// NOTE: does what the input handlers asked for with contextRequest; only on the render thread
+void contextRequestsRun(context_t *ctx, int req) {
+  if (req & RequestScreenshot) {
+    ctx->captureNext = 1;
+  }
+  if (req & RequestRecord) {
+    ctx->recording ^= 1;
+    fprintf(stderr, ctx->recording ? "Recording: ON\n" : "Recording: OFF\n");
+  }
+  if (req & RequestTweakBarPos) {
+    tweakBarPlace();
+  }
+  if (req & RequestGeoms) {
+    contextGeomsSettle(ctx);
+  }
+  if (req & RequestPerVertexTexturing) {
+    perVertexTexturing();
+  }
+  if (req & RequestTweakBar) {
+    // NOTE: the scene is changing, so this is how the last one did
+    contextUniformsReport(ctx);
+    updateTweakBarVars(ctx->tweakBarScene);
+  }
+}
+
+// NOTE: starts saving the frame just drawn (so, before the buffer swap) to the next "%05d.png":
+//       the first unused one the first time, and the ones after it from then on, since files
+//       being saved may not exist yet. The frame is read back and encoded in the background
+void contextCapture(context_t *ctx) {
+  FILE *file;
+  char fname[128];
+  int testMax=99999;
+
+  ctx->captureNext = 0;
+  if (ctx->captureNum < 0) {
+    for (ctx->captureNum=0; ctx->captureNum<=testMax; ctx->captureNum++) {
+      sprintf(fname, "%05d.png", ctx->captureNum);
+      if (!(file = fopen(fname, "rb"))) {
+        break;
+      }
+      fclose(file);
+    }
+  }
+  if (ctx->captureNum > testMax) {
+    fprintf(stderr, "contextCapture: no unused file name left to save to\n");
+    ctx->recording = 0;
+    return;
+  }
+  sprintf(fname, "%05d.png", ctx->captureNum++);
+  if (spotCaptureFrame(ctx->capture, fname)) {
+    fprintf(stderr, "contextCapture: trouble saving %s:\n", fname);
+    spotErrorPrint(); spotErrorClear();
+  }
+}
+
+// NOTE: for the input handlers, which may be on the update thread, to get things done that need
+//       the GL context or the tweak bar: right away when that's possible, or else on the render
+//       thread just before it draws the frame the handler contributed to
+void contextRequest(context_t *ctx, int req) {
+  if (ctx->threaded) {
+    ctx->requestNext |= req;
+  } else {
+    contextRequestsRun(ctx, req);
+  }
+}
+
+// NOTE: for the GLFW callbacks to hand over an event (or NULL, for one AntTweakBar handled);
+//       either it's handled right here, or queued for the update thread. Either way it's counted
+//       in inputSent, so that the render thread knows whether it has seen the result
+void contextInput(context_t *ctx, const input_t *ev) {
+  if (ev) {
+    if (ctx->threaded) {
+      if (inputQueuePush(&ctx->input, ev)) {
+        fprintf(stderr, "contextInput: input queue full; dropping event\n");
+        return;
+      }
+    } else {
+      handleInput(ev);
+    }
+  }
+  atomic_fetch_add(&ctx->inputSent, 1);
+}
+
+// NOTE: asks the update thread for another frame (or to finish, if stop)
+void contextWant(context_t *ctx, int stop) {
+  pthread_mutex_lock(&ctx->wantLock);
+  if (stop) {
+    ctx->updateStop = 1;
+  } else {
+    ctx->want = 1;
+  }
+  pthread_cond_signal(&ctx->wantCond);
+  pthread_mutex_unlock(&ctx->wantLock);
+}
+
+// NOTE: the update thread: each time the render thread wants a frame, handle the queued input
+//       and make the next frame. The render thread is meanwhile drawing the previous one
+void *updateThreadMain(void *arg) {
+  context_t *ctx = (context_t *)arg;
+  frame_t *frame;
+  input_t ev;
+  int stop, req;
+
+  while (1) {
+    pthread_mutex_lock(&ctx->wantLock);
+    while (!( ctx->want || ctx->updateStop )) {
+      pthread_cond_wait(&ctx->wantCond, &ctx->wantLock);
+    }
+    stop = ctx->updateStop;
+    ctx->want = 0;
+    pthread_mutex_unlock(&ctx->wantLock);
+    if (stop) {
+      break;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    frame = frameTripleBack(&ctx->frames);
+    // NOTE: counted before taking events off the queue, so that every event counted is handled
+    frame->inputSeen = atomic_load(&ctx->inputSent);
+    while (inputQueuePop(&ctx->input, &ev)) {
+      handleInput(&ev);
+    }
+    if (contextUpdate(ctx, frame)) {
+      // NOTE: can only be an allocation failure; the render thread will stop
+      fprintf(stderr, "updateThreadMain: trouble updating\n");
+      ctx->running = frame->running = 0;
+    }
+    req = ctx->requestNext;
+    ctx->requestNext = 0;
+    pthread_mutex_unlock(&ctx->lock);
+    frameTriplePublish(&ctx->frames, req);
+  }
+  return NULL;
+}
+
 void usage(const char *me) {
-  fprintf(stderr, "usage: %s [<vertshader> <fragshader>]\n", me);
+  fprintf(stderr, "usage: %s [-c] [-t] [-p] [-r] [-u] [-z] [-a] [<vertshader> <fragshader>]\n",
+          me);
   fprintf(stderr, "\tCall `%s', optionally taking a default pair of vertex and fragment\n", me);
   fprintf(stderr, "\tshaders to render. Otherwise we just load our stack of shaders.\n");
+  fprintf(stderr, "\tWith -c, redraw continuously (e.g. for timing); otherwise we only\n");
+  fprintf(stderr, "\tredraw when something changes. With -t, the per-frame updates\n");
+  fprintf(stderr, "\t(input, animation, transforms) run on their own thread. Shaders are\n");
+  fprintf(stderr, "\tcompiled when first used; with -p, they're also compiled while idle.\n");
+  fprintf(stderr, "\tWith -r, shaders are rebuilt whenever their files are saved. With -u,\n");
+  fprintf(stderr, "\tonly the general shaders are used, not variants built for fixed\n");
+  fprintf(stderr, "\tuniform values (e.g. to compare their speed). With -z, textures are\n");
+  fprintf(stderr, "\tblock compressed (lossy, but a quarter of the memory or less). With -a,\n");
+  fprintf(stderr, "\tsame-sized textures are packed into one texture array.\n");
+}
+
+// NOTE: true when the scene moves on its own, so that each frame differs from the last even
+//       without any input
+int contextAnimating(context_t *ctx) {
+  return (ctx->spinning
+          || (!ctx->buttonDown
+              && (ctx->thetaPerSecU || ctx->thetaPerSecV || ctx->thetaPerSecN)));
 }
 
 int main(int argc, const char* argv[]) {
   const char *me;
+  int continuous=0, threaded=0, prewarm=0, reload=0, variants=1, compress=0, pack=0, running, animating, fresh, pending, req, bad;
+  frame_t *frame;
   me = argv[0];
+  // NOTE: "-c", "-t", "-p", "-r", "-u", "-z" and "-a" may come first; the rest of the arguments
+  //       are as before
+  while (argc > 1 && (!strcmp(argv[1], "-c") || !strcmp(argv[1], "-t")
+                      || !strcmp(argv[1], "-p") || !strcmp(argv[1], "-r")
+                      || !strcmp(argv[1], "-u") || !strcmp(argv[1], "-z")
+                      || !strcmp(argv[1], "-a"))) {
+    if (!strcmp(argv[1], "-c")) {
+      continuous = 1;
+    } else if (!strcmp(argv[1], "-t")) {
+      threaded = 1;
+    } else if (!strcmp(argv[1], "-p")) {
+      prewarm = 1;
+    } else if (!strcmp(argv[1], "-r")) {
+      reload = 1;
+    } else if (!strcmp(argv[1], "-z")) {
+      compress = 1;
+    } else if (!strcmp(argv[1], "-a")) {
+      pack = 1;
+    } else {
+      variants = 0;
+    }
+    argv++; argc--;
+  }
   // NOTE: we now allow you to either pass in an "invoked" or default shader to render, or to let
   //       us just set up our stack; hence you either pass 2 additional arguments or none at all
   // NOTE: we aren't explicity defining this functionality, but obviously `proj2 -h' will show the
@@ -937,6 +2195,12 @@ int main(int argc, const char* argv[]) {
     exit(1);
   }
 
+  gctx->continuous = continuous;
+  gctx->prewarm = prewarm;
+  gctx->reload = reload;
+  gctx->variants = variants;
+  gctx->compress = compress;
+  gctx->pack = pack;
   if (argc==3) {
     gctx->vertFname = argv[1];
     gctx->fragFname = argv[2];
@@ -1000,21 +2264,100 @@ int main(int argc, const char* argv[]) {
   }
 
   glfwSetWindowSizeCallback(callbackResize);
+  glfwSetWindowRefreshCallback(callbackRefresh);
   glfwSetKeyCallback(callbackKeyboard);
   glfwSetMousePosCallback(callbackMousePos);
   glfwSetMouseButtonCallback(callbackMouseButton);
 
   /* Redirect GLFW mouse wheel events directly to AntTweakBar */
-  glfwSetMouseWheelCallback((GLFWmousewheelfun)TwEventMouseWheelGLFW);
+  glfwSetMouseWheelCallback(callbackMouseWheel);
   /* Redirect GLFW char events directly to AntTweakBar */
-  glfwSetCharCallback((GLFWcharfun)TwEventCharGLFW);
+  glfwSetCharCallback(callbackChar);
+
+  if (threaded) {
+    // NOTE: the first frame is made here, and the update thread makes the rest
+    if (contextUpdate(gctx, frameTripleBack(&gctx->frames))) {
+      fprintf(stderr, "%s: trouble updating:\n", me);
+      spotErrorPrint(); spotErrorClear();
+      exit(1);
+    }
+    frameTriplePublish(&gctx->frames, 0);
+    gctx->threaded = 1;
+    if (pthread_create(&gctx->updateThread, NULL, updateThreadMain, gctx)) {
+      fprintf(stderr, "%s: couldn't start update thread\n", me);
+      exit(1);
+    }
+  }
 
   /* Main loop */
-  while (gctx->running) {
-    // NOTE: we update UVN every step
-    updateUVN(gctx->camera.uvn, gctx->camera.at, gctx->camera.from, gctx->camera.up);
+  running = 1;
+  while (running) {
+    if (gctx->threaded) {
+      fresh = frameTripleLatest(&gctx->frames, &frame, &req);
+      running = frame->running;
+      animating = frame->animating;
+      pending = frame->inputSeen != atomic_load(&gctx->inputSent);
+    } else {
+      frame = NULL;
+      req = 0;
+      running = gctx->running;
+      animating = contextAnimating(gctx);
+      fresh = pending = 0;
+    }
+    if (!running) {
+      break;
+    }
+    // NOTE: starts building programs that were asked for since last time; one that has finished
+    //       compiling sets dirty, so we draw with it
+    contextProgramsPoll(gctx);
+    // NOTE: frames being saved are copied out once the GPU has read them back, and encoded on
+    //       the image worker threads
+    if (spotCapturePoll(gctx->capture, SPOT_FALSE)) {
+      fprintf(stderr, "%s: trouble saving frames:\n", me);
+      spotErrorPrint(); spotErrorClear();
+    }
+    if (!( gctx->continuous || gctx->dirty || fresh || pending || animating )) {
+      // NOTE: nothing to draw, so sleep until some event comes in (the callbacks set dirty); the
+      //       time spent idle shouldn't count towards the next frame's dt
+      contextLock(gctx);
+      gctx->ticDraw = -1;
+      contextUnlock(gctx);
+      // NOTE: with -p, time we'd spend idle goes to building programs nobody has asked for yet
+      if (gctx->prewarm && !gctx->programPending && contextProgramsPrewarm(gctx)) {
+        contextProgramsPoll(gctx);
+      }
+      if (gctx->programPending || gctx->watch || spotCapturePending(gctx->capture)) {
+        // NOTE: programs still compiling, frames still being saved, or shader files to watch;
+        //       look again shortly instead of waiting for an event
+        glfwPollEvents();
+        glfwSleep(gctx->programPending || spotCapturePending(gctx->capture) ? 0.01 : 0.1);
+      } else {
+        glfwWaitEvents();
+      }
+      if (!glfwGetWindowParam(GLFW_OPENED)) {
+        running = 0;
+      }
+      continue;
+    }
+    // NOTE: cleared before drawing, so that events seen during the buffer swap count for next time
+    gctx->dirty = 0;
     /* render */
-    if (contextDraw(gctx)) {
+    if (gctx->threaded) {
+      // NOTE: the update thread works on the next frame while we draw this one; if it hasn't
+      //       caught up with the input yet, we'll draw again once it has
+      if (gctx->continuous || pending || animating) {
+        contextWant(gctx, 0);
+      }
+      if (req) {
+        contextLock(gctx);
+        contextRequestsRun(gctx, req);
+        contextUnlock(gctx);
+      }
+      bad = contextRender(gctx, frame);
+    } else {
+      bad = contextDraw(gctx);
+    }
+    if (bad) {
       fprintf(stderr, "%s: trouble drawing:\n", me);
       spotErrorPrint(); spotErrorClear();
       /* Can comment out "break" so that OpenGL bugs are reported but
@@ -1022,20 +2365,32 @@ int main(int argc, const char* argv[]) {
       /* break; */
     }
     /* Draw tweak bar last, just prior to buffer swap */
-    if (!TwDraw()) {
+    contextLock(gctx);
+    bad = !TwDraw();
+    contextUnlock(gctx);
+    if (bad) {
       fprintf(stderr, "%s: AntTweakBar error: %s\n", me, TwGetLastError());
       break;
     }
+    // NOTE: read from the back buffer, so it has to be now, with the tweak bar drawn too
+    if (gctx->captureNext || gctx->recording) {
+      contextCapture(gctx);
+    }
     /* Display rendering results */
     glfwSwapBuffers();
-    /* NOTE: don't call glfwWaitEvents() if you want to redraw continuously */
-//    glfwWaitEvents();
+    /* NOTE: glfwWaitEvents() is called above, only when there is nothing to redraw */
     /* quit if window was closed */
     if (!glfwGetWindowParam(GLFW_OPENED)) {
-      gctx->running = 0;
+      running = 0;
     }
   }
   
+  if (gctx->threaded) {
+    contextWant(gctx, 1);
+    pthread_join(gctx->updateThread, NULL);
+    gctx->threaded = 0;
+  }
+  contextUniformsReport(gctx);
   contextGLDone(gctx);
   contextNix(gctx);
   TwTerminate();
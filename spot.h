@@ -43,6 +43,11 @@
 #define SPOT_TRUE 1
 #define SPOT_FALSE 0
 
+/* alignment (in bytes) of arrays allocated by spotGeomNew and spotArenaAlloc,
+   enough for any SIMD load/store of vertex data */
+#define SPOT_ALIGN 32
+#define SPOT_ALIGN_UP(n) (((n) + SPOT_ALIGN - 1) & ~((size_t)SPOT_ALIGN - 1))
+
 /* 
 ** The spot macros are a clumsy way of doing vector and matrix operations.
 ** You are expected to read through spotMacros.h once to see what
@@ -68,6 +73,25 @@ enum {
   spotVertAttrIndx_tex2,
   spotVertAttrIndx_tang,
 };
+#define SPOT_VERT_ATTR_NUM (spotVertAttrIndx_tang + 1)
+/* bit (1 << spotVertAttrIndx_*) set for every attribute */
+#define SPOT_VERT_ATTR_ALL ((1u << SPOT_VERT_ATTR_NUM) - 1)
+
+/*
+** How the CPU-side memory of a spotGeom was allocated, which determines
+** what spotGeomNix has to free (see spotGeom->alloc).  Only spotGeomNew*
+** sets the two tags, which are arbitrary non-zero values that garbage is
+** very unlikely to match; any other value (e.g. in a geom malloc()d by
+** hand) means spotGeomAllocSeparate
+*/
+enum {
+  spotGeomAllocSeparate = 0,          /* struct and every array malloc()d on
+                                         its own */
+  spotGeomAllocBlock = 0x53424c4b,    /* struct and arrays share one
+                                         allocation */
+  spotGeomAllocArena = 0x5341524e,    /* struct and arrays live in a
+                                         spotArena */
+};
 
 /*
 ** The spotGeom struct contains geometric and OpenGL information needed to
@@ -121,6 +145,12 @@ typedef struct {
     modelMatrix[16],     /* transformation of model coords */
     normalMatrix[9];     /* transformation of normals */
   GLint program;         /* if non-zero, specific shader program to use */
+  int alloc;             /* how this was allocated: spotGeomAlloc* enum */
+  unsigned int streamMask; /* bit (1 << spotVertAttrIndx_*) is set for each
+                            attribute that changes per-frame, so that its
+                            CPU array is re-sent every frame through a
+                            spotStream (by spotGeomStream), instead of
+                            sitting in its static buffer */
   /* ---------------------- Information reflecting current GPU state */
   GLuint vaoId,          /* for storing return of glGenVertexArrays */
     xyzBuffId,           /* for storing return of glGenBuffers */
@@ -129,6 +159,16 @@ typedef struct {
     tex2BuffId,
     tangBuffId,
     indxBuffId;
+  GLuint vaoMaskId[1 << SPOT_VERT_ATTR_NUM]; /* VAOs over the same buffers
+                            that only enable some attributes:
+                            vaoMaskId[mask] enables those with bit
+                            (1 << spotVertAttrIndx_*) set in mask.  Made as
+                            needed by spotGeomDrawMask; vaoId is one of them
+                            (with every attribute the geom has) */
+  unsigned int streamBound; /* attributes currently sourced from a spotStream
+                            rather than their static buffers */
+  GLuint streamBuffId;   /* buffer of the spotStream they come from */
+  GLintptr streamOffset[SPOT_VERT_ATTR_NUM]; /* their offsets in it */
 } spotGeom;
 
 /*
@@ -152,9 +192,217 @@ typedef struct {
     unsigned short *us;  /* as ushort, for 16-bit images */
   } data;
   /* ---------------------- Information reflecting current GPU state */
-  GLuint textureId;      /* for storing return of glGenTextures */
+  GLuint textureId,      /* for storing return of glGenTextures */
+    bufferId;            /* pixel unpack buffer holding the data instead of
+                            data.v, from spotImageGLBufferMap, or 0 */
+  int bcFormat;          /* if not spotBCNone, the block compression
+                            (spotBC*) to load and upload the image with;
+                            set by the caller before loading */
+  void *bcData;          /* the blocks, from spotImageLoadPNGBC, or NULL */
 } spotImage;
 
+/*
+** A spotImageArray is a GL_TEXTURE_2D_ARRAY with same-sized images as its
+** layers, so that a shader can sample any of them with one texture bound
+*/
+typedef struct {
+  unsigned int sizeX,    /* size along X of every layer */
+    sizeY,               /* size along Y of every layer */
+    layerNum;            /* number of layers */
+  GLuint textureId;      /* for storing return of glGenTextures */
+} spotImageArray;
+
+/*
+** Block compressed texture formats, for spotImage->bcFormat.  Each 4x4
+** block of pixels is stored in 8 (BC1) or 16 bytes
+*/
+enum {
+  spotBCNone,            /* not compressed */
+  spotBC1,               /* RGB: 2 565 colors and 2-bit indices (DXT1) */
+  spotBC3,               /* RGBA: BC1 colors plus alpha as in BC4 (DXT5) */
+  spotBC5,               /* RG: two BC4 (2 8-bit values, 3-bit indices)
+                            channels, for normal maps (RGTC2) */
+};
+
+/*
+** How spotImageMipGLInit makes the smaller mip levels: which filter
+** (spotMipFilter*) is used to halve each level, and what kind of data
+** (spotMipKind*) is being filtered, which determines how it is averaged
+*/
+enum {
+  spotMipFilterBox,      /* average of 2x2 pixels */
+  spotMipFilterKaiser,   /* Kaiser-windowed sinc, 12x12 pixels */
+  spotMipFilterLanczos,  /* Lanczos-windowed (a=3) sinc, 12x12 pixels */
+};
+enum {
+  spotMipKindLinear,     /* values that are averaged as they are */
+  spotMipKindColor,      /* sRGB-encoded color (but not alpha), averaged
+                            after conversion to linear */
+  spotMipKindNormal,     /* normals (xyz in [0,1] as [-1,1]), which are
+                            renormalized after averaging */
+};
+
+/*
+** The lobe (spotCubeLobe*) that spotImageCubeMapMipGLInit convolves a cube
+** map with to make each of its smaller levels, for glossier reflections
+*/
+enum {
+  spotCubeLobeGGX,       /* GGX (Trowbridge-Reitz) microfacet distribution */
+  spotCubeLobePhong,     /* Phong lobe around the reflected direction */
+};
+
+/*
+** A spotImageLoad is the handle returned by spotImageLoadPNGAsync, for a
+** PNG image being decoded by one of the image loading worker threads (or by
+** spotImageSavePNGAsync, for one being encoded)
+*/
+typedef struct spotImageLoad {
+  spotImage *img;        /* image being loaded into (or saved) */
+  char *fname;           /* (copy of) file name being loaded */
+  void *dest;            /* where to put the pixel data, or NULL for
+                            img->data */
+  int save,              /* non-zero to save img to fname instead */
+    ret,                 /* return from spotImageLoadPNG(img, fname) */
+    done;                /* non-zero once the worker is done with it */
+  struct spotImageLoad *next; /* next load in the queue for the workers */
+} spotImageLoad;
+
+/*
+** A spotHandle is a stable reference to an item in a spotPool.  The low 16
+** bits are the slot, and the high 16 bits are the generation of that slot
+** at the time the item was added. Removing an item bumps the generation of
+** its slot, so that any old handles to it can be recognized as stale
+** (spotPoolGet returns NULL) even after the slot is re-used.  No valid
+** handle is ever equal to SPOT_HANDLE_NONE.
+*/
+typedef unsigned int spotHandle;
+#define SPOT_HANDLE_NONE 0
+#define SPOT_HANDLE_SLOT_MAX 0xffffu
+#define SPOT_HANDLE_GEN_MAX 0xffffu
+#define SPOT_HANDLE(gen, slot) (((gen) << 16) | (slot))
+#define SPOT_HANDLE_SLOT(hh) ((hh) & SPOT_HANDLE_SLOT_MAX)
+#define SPOT_HANDLE_GEN(hh) ((hh) >> 16)
+
+/*
+** The spotPool struct is a growable store of pointers (e.g. to spotGeom or
+** spotImage structs) addressed by spotHandle.  Live items are kept densely
+** packed at the front of the item array, so that iterating over everything
+** in the pool is just:
+**
+**     for (ii=0; ii<pool->num; ii++) { ... spotPoolItem(pool, ii) ... }
+**
+** Only the pointers (and handles) are dense: the items themselves live
+** wherever they were allocated (for a spotGeom, that's contiguous when it
+** comes from a spotArena), so each one visited is still one pointer away.
+** The position of a given item may change when another item is removed, so
+** hold on to its handle (pool->handle[ii]) rather than ii.  The pool never
+** owns or frees the items themselves.
+*/
+typedef struct {
+  void **item;           /* num live items, densely packed */
+  spotHandle *handle;    /* handle[ii] is the handle for item[ii] */
+  unsigned int num,      /* number of live items */
+    cap;                 /* allocated length of item and handle */
+  unsigned int *gen,     /* per slot: current generation */
+    *indx;               /* per slot: index into item[] if slot is live,
+                            otherwise next slot in free list */
+  unsigned int slotNum,  /* number of slots ever handed out */
+    slotCap,             /* allocated length of gen and indx */
+    freeSlot;            /* first slot in free list */
+} spotPool;
+
+/*
+** A spotArena is a bump allocator: spotArenaAlloc hands out SPOT_ALIGN-aligned
+** pieces of big chunks, and nothing is freed until spotArenaReset or
+** spotArenaNix frees all of it at once.  This suits things like all the
+** geometry in a scene, which is created together and destroyed together.
+** An arena isn't thread-safe; whoever shares one has to serialize its use.
+*/
+typedef struct {
+  void *chunk;           /* most recent chunk; the first pointer in each chunk
+                            points to the chunk before it */
+  size_t chunkSize,      /* usual size of new chunks */
+    chunkUsed,           /* bytes handed out from current chunk */
+    chunkLen;            /* usable size of current chunk */
+} spotArena;
+
+/*
+** A spotStream is a ring buffer for vertex data that changes every frame.
+** The buffer is split into regionNum regions, one per frame in flight; each
+** frame's data is written into its region through unsynchronized mappings,
+** and a fence at the end of the frame says when the GPU is done with it, so
+** that neither writing nor drawing ever waits on the other (unless the CPU
+** gets regionNum frames ahead), and the buffer is only reallocated when
+** spotStreamGrow needs bigger regions.
+*/
+typedef struct {
+  GLuint buffId;         /* the GL buffer holding all regions */
+  GLsizeiptr regionSize, /* bytes per region */
+    used;                /* bytes of current region handed out so far */
+  unsigned int regionNum, /* number of regions */
+    region;              /* region being written this frame */
+  GLsync *fence;         /* per region: fence at the end of the frame that
+                            last used it (or 0) */
+} spotStream;
+
+/*
+** A spotCapture saves frames as PNG images without stalling the render
+** thread.  Each frame is read (with glReadPixels) into the next of a ring of
+** slotNum pixel pack buffers, with a fence after it, and only mapped once
+** the fence says the GPU is done with it, normally some frames later.  The
+** rows are copied out of the mapping bottom to top, so the copy is the right
+** way up, and the copy is encoded on the image worker threads
+** (spotImageSavePNGAsync).
+*/
+typedef struct {
+  GLuint buffId;         /* the pack buffer */
+  GLsizeiptr buffSize;   /* bytes allocated for buffId */
+  GLsync fence;          /* fence after the read into it, or 0 if unused */
+  unsigned int sizeX,    /* size of the frame read */
+    sizeY;
+  char *fname;           /* where to save the frame */
+} spotCaptureSlot;
+
+typedef struct {
+  spotCaptureSlot *slot; /* the ring of slotNum slots */
+  unsigned int slotNum,  /* number of slots */
+    head,                /* next slot to read a frame into */
+    pending;             /* number of slots read into but not yet copied
+                            out, which are the ones just before head */
+  int withAlpha;         /* read RGBA (else RGB) */
+  spotImageLoad **save;  /* the frames being saved, oldest first */
+  spotImage **saveImg;   /* their images */
+  unsigned int saveNum,  /* number of saves in save[] */
+    saveMax;             /* room in save[] */
+} spotCapture;
+
+/*
+** A spotWatch notices when any of a set of files has been saved, e.g. for
+** re-loading shaders while the program runs.
+*/
+typedef struct {
+  int fd;                /* the inotify instance */
+  int *wd;               /* per file: watch descriptor of its directory */
+  char **base;           /* per file: name within its directory */
+  int *changed;          /* per file: saved since last cleared */
+  unsigned int num;      /* number of files */
+} spotWatch;
+
+/*
+** A spotProgramJob is a shader program that has been handed to the GL to
+** compile and link, but whose success hasn't been checked yet: checking
+** means waiting for the compiler, so spotProgramSubmit does no checking and
+** leaves it to spotProgramFinish.  Submitting every program before finishing
+** any lets a driver that compiles on its own threads work on all of them at
+** once.
+*/
+typedef struct {
+  GLuint program,          /* the program being built */
+    vertId, fragId;        /* its shaders (0 if loaded from the cache) */
+  unsigned long long hash; /* key into the program binary cache */
+  int cache;               /* save the binary to the cache once linked */
+} spotProgramJob;
+
 /* . . . descriptions of spot functions organized by file . . . */
 
 
@@ -187,6 +435,8 @@ extern void spotM4print_f(const GLfloat m[16]);
 ** If you have any functions that might generate errors, which are called by
 ** other functions that want to notice those errors, please feel fee to use
 ** these to simplify the work of describing those errors!  
+** All three may be called from any thread; the messages from all threads
+** go into the one list.
 */
 extern void spotErrorAdd(const char *fmt, ...)
 #ifdef __GNUC__
@@ -197,6 +447,23 @@ extern void spotErrorPrint(void);
 extern void spotErrorClear(void);
 /* spotStrdup is same as strdup(), but strdup() isn't ANSI C */
 char *spotStrdup(const char *s);
+/* spotHash(hh, data, len) is the 64-bit FNV-1a hash of len bytes at data,
+   continuing from hash hh; start with SPOT_HASH_START.  spotHashFile(&hh,
+   fname) continues hh with the contents of file fname, returning non-zero
+   (without adding an error) if it can't be read */
+#define SPOT_HASH_START 0xcbf29ce484222325ULL
+extern unsigned long long spotHash(unsigned long long hh,
+                                   const void *data, size_t len);
+extern int spotHashFile(unsigned long long *hh, const char *fname);
+/* spotParallel(func, data, rowNum, work) calls func(data, row0, row1) on
+   consecutive ranges [row0,row1) covering [0,rowNum), split among one thread
+   per core (at most SPOT_PARALLEL_MAX), or fewer when work (roughly, the
+   number of arithmetic operations in all) is too little to go around.  The
+   calling thread does the first range, and this returns once all are done */
+#define SPOT_PARALLEL_MAX 16
+extern void spotParallel(void (*func)(void *data, unsigned int row0,
+                                      unsigned int row1),
+                         void *data, unsigned int rowNum, size_t work);
 /* spotGLErrorString returns a (const) string version of GL error values.
    You can spotStrdup() or print this string, but don't try to free() it. */
 extern const char *spotGLErrorString(GLenum error);
@@ -219,19 +486,280 @@ extern GLint spotShaderNew(GLint shtype, const char *fname);
 extern GLint spotProgramNew(const char *vertFname,
                             const char *fragFname,
                             ...);
+/* spotProgramSubmit(vertFname, fragFname, ...) takes the same arguments as
+   spotProgramNew, and starts building the program without waiting for it.
+   spotProgramReady(job) returns 1 if spotProgramFinish would not have to
+   wait, 0 if it would, and -1 if the GL (lacking KHR_parallel_shader_compile)
+   can't say.  spotProgramFinish(job) waits for the program if need be, frees
+   the job, and returns the program, or 0 if it didn't compile or link */
+extern spotProgramJob *spotProgramSubmit(const char *vertFname,
+                                         const char *fragFname,
+                                         ...);
+/* spotProgramSubmitTo(program, defines, vertFname, fragFname, ...) is the
+   same, but builds into program (from glCreateProgram, or 0 for a new one),
+   so that the id can be handed out before the program is built.  defines is
+   NULL or a NULL-terminated list of "NAME" or "NAME value" strings, each of
+   which becomes a "#define" line right after "#version" in both shaders;
+   this is how one shader source gives specialized variants */
+extern spotProgramJob *spotProgramSubmitTo(GLuint program,
+                                           const char *const *defines,
+                                           const char *vertFname,
+                                           const char *fragFname,
+                                           ...);
+extern int spotProgramReady(const spotProgramJob *job);
+extern GLint spotProgramFinish(spotProgramJob *job);
+/* spotProgramCacheDirSet(dir) makes spotProgramNew keep the binaries of the
+   programs it links in directory dir (created as needed), and load them from
+   there instead of compiling whenever the shader sources, attribute bindings,
+   and GL driver are all the same as last time.  This needs GL 4.1 or
+   ARB_get_program_binary; without those, or with a NULL dir (the default),
+   every program is compiled */
+extern void spotProgramCacheDirSet(const char *dir);
+/* spotProgramAttrMask(program) returns the mask of vertex attributes that a
+   linked program actually reads: bit (1 << index) for each active attribute
+   bound to generic attribute index < SPOT_VERT_ATTR_NUM */
+extern unsigned int spotProgramAttrMask(GLuint program);
+/* spotGLExtension(name) returns non-zero if the GL context supports the
+   extension with the given name (e.g. "GL_ARB_get_program_binary") */
+extern int spotGLExtension(const char *name);
 
 /* --------------------- spotImage.c --------------------- */
 extern spotImage *spotImageNew();
+extern int spotImageAlloc(spotImage *img, unsigned int sizeC, unsigned int sizeP,
+                          unsigned int sizeX, unsigned int sizeY);
 extern int spotImageLoadPNG(spotImage *img, char *fname);
+/* spotImageLoadPNGInfo(img, fname) reads only the header of the PNG, to
+   learn the sizes of img (leaving img->data NULL).  With those sizes
+   known, spotImageLoadPNGInto(img, fname, dest) reads the pixel data into
+   dest, which need not be img->data (e.g. it can be the mapping from
+   spotImageGLBufferMap) */
+extern int spotImageLoadPNGInfo(spotImage *img, const char *fname);
+extern int spotImageLoadPNGInto(spotImage *img, const char *fname, void *dest);
+/* spotImageLoadPNGAsync(img, fname, dest) starts spotImageLoadPNG(img, fname)
+   (or with non-NULL dest, spotImageLoadPNGInto(img, fname, dest)) on a pool
+   of worker threads (one per core, started on first use) and returns right
+   away, with a handle to pass to spotImageLoadWait, or NULL in case of
+   error.  Starting several loads before waiting for any of them decodes them
+   in parallel.  Decoding uses no GL, so GL set-up of img (spotImageGLInit)
+   is up to the caller, on the GL thread, after the wait.
+   spotImageLoadWait(load) waits for the load to finish, frees the handle,
+   and returns what spotImageLoadPNG returned (with its errors added via
+   spotErrorAdd) */
+extern spotImageLoad *spotImageLoadPNGAsync(spotImage *img, const char *fname,
+                                            void *dest);
+extern int spotImageLoadWait(spotImageLoad *load);
+/* spotImageSavePNGAsync(img, fname) is likewise spotImageSavePNG(fname, img)
+   on the worker threads, but trading file size for speed (with the fastest
+   zlib compression), e.g. for saving every frame.  img mustn't change or be
+   freed until spotImageLoadWait on the handle.  spotImageLoadDone(load) is
+   non-zero once the worker is done with load, so that spotImageLoadWait
+   won't block */
+extern spotImageLoad *spotImageSavePNGAsync(spotImage *img, const char *fname);
+extern int spotImageLoadDone(spotImageLoad *load);
 extern int spotImageSavePNG(char *fname, spotImage *img);
 extern int spotImageScreenshot(spotImage *img, int withAlpha);
+/* spotImageGLInit(img) uploads img as a 2D texture with the internal format
+   from spotImageGLInternalFormat(img): GL_RGBA8 for 8-bit images, and for
+   16-bit ones GL_R16, GL_RG16 or GL_RGBA16 (for RGB or RGBA), so that no
+   precision is lost */
 extern int spotImageGLInit(spotImage *img);
+extern GLenum spotImageGLInternalFormat(const spotImage *img);
+/* spotImageGLBufferMap(img) creates a pixel unpack buffer (img->bufferId)
+   big enough for img (whose sizes must be set, e.g. by spotImageLoadPNGInfo)
+   and returns a write-only mapping of it, or NULL in case of error.  The
+   mapping can be written from any thread, e.g. by spotImageLoadPNGAsync,
+   until spotImageGLInit (or spotImageCubeMapGLInit) unmaps it and uploads
+   the texture from it, without any copy in img->data.  Those in turn use
+   spotImageGLUnpackBegin(img, &pixels) to get what to pass to glTexImage2D
+   (img->data, or img->bcData for a block compressed image, or the start of
+   the unmapped and bound buffer) and spotImageGLUnpackEnd(img) to free the
+   buffer (and blocks) afterwards */
+extern void *spotImageGLBufferMap(spotImage *img);
+extern int spotImageGLUnpackBegin(spotImage *img, const unsigned char **pixels);
+extern void spotImageGLUnpackEnd(spotImage *img);
 extern int spotImageGLDone(spotImage *img);
 extern spotImage *spotImageNix(spotImage *img);
+/* spotImageArrayGLInit(arr, img, num) makes arr a texture array with the num
+   images img[] (all of the same size, and not block compressed) as its
+   layers, in that order, with room for all their mip levels (which can be
+   made with spotImageArrayMipGLInit).  Each image's data is uploaded the
+   same way as by spotImageGLInit, and img[ii]->textureId is not used.  The
+   array is GL_RGBA16 if any of the images is 16-bit, else GL_RGBA8 */
+extern spotImageArray *spotImageArrayNew(void);
+extern int spotImageArrayGLInit(spotImageArray *arr, spotImage **img,
+                                unsigned int num);
+extern int spotImageArrayGLDone(spotImageArray *arr);
+extern spotImageArray *spotImageArrayNix(spotImageArray *arr);
+
+/* --------------------- spotConvert.c --------------------- */
+/* Conversions of 16-bit pixel data (of num values, or pixNum pixels), with
+   SSE2 where available.  spotConvertSwap16 swaps the bytes of each value,
+   spotConvertRGBToRGBA16 adds an opaque alpha to RGB pixels, and
+   spotConvert16To8 narrows to 8 bits with rounding.  The swap and the
+   narrowing can be done in place (dst the same memory as src), but not the
+   expansion */
+extern void spotConvertSwap16(unsigned short *dst, const unsigned short *src,
+                              size_t num);
+extern void spotConvertRGBToRGBA16(unsigned short *dst,
+                                   const unsigned short *src, size_t pixNum);
+extern void spotConvert16To8(unsigned char *dst, const unsigned short *src,
+                             size_t num);
+
+/* --------------------- spotMip.c --------------------- */
+/* spotImageMipGLInit(img, filter, kind) makes all the smaller mip levels of
+   img (down to 1x1) from img->data and uploads them to img->textureId, which
+   spotImageGLInit must already have set up.  Each level is made from the
+   previous one (kept as float, so there is no rounding from one to the
+   next), with separable passes split among threads.  The cost is fixed by
+   the image size and the filter: spotImageMipCost(img, filter) is the number
+   of multiply-adds, which is about 2 (box) or 12 (Kaiser, Lanczos) for
+   each channel of each pixel of img.  spotImageMipLevelNum(img) is the number of levels,
+   including img itself.  With img->bcFormat set, each level is block
+   compressed (by spotBCEncode) before it is uploaded */
+extern int spotImageMipGLInit(spotImage *img, int filter, int kind);
+/* spotImageArrayMipGLInit(arr, layer, img, filter, kind) is the same for
+   layer layer of arr, made (by spotImageArrayGLInit) from img */
+extern int spotImageArrayMipGLInit(spotImageArray *arr, unsigned int layer,
+                                   spotImage *img, int filter, int kind);
+extern double spotImageMipCost(const spotImage *img, int filter);
+extern unsigned int spotImageMipLevelNum(const spotImage *img);
+
+/* --------------------- spotCube.c --------------------- */
+/* spotImageCubeMapMipGLInit(img, fname, fnameNum, lobe) makes the smaller
+   levels of cube map img (already set up by spotImageCubeMapGLInit or
+   spotImageCubeMapFacesGLInit) for rough reflections: level i is the
+   environment convolved with the lobe for roughness i/(levels-1), so level
+   0 stays a mirror and the 1x1 level is as rough as can be.  Each texel
+   importance-samples the lobe, reading coarser box-filtered copies of level
+   0 for less likely directions, with the rows of all faces split among
+   threads.  The levels are cached in a file next to fname[0] (plus ".ggx"
+   or ".phong"), so they are only made again when one of the fnameNum files
+   img was loaded from (the PNG, or its six faces) changes; with fnameNum 0,
+   nothing is cached */
+extern int spotImageCubeMapMipGLInit(spotImage *img, const char *const *fname,
+                                     unsigned int fnameNum, int lobe);
+/* spotImageCubeMapSH(sh, img) projects (level 0 of) cube map img onto the 9
+   spherical harmonics up to order 2, for the diffuse irradiance (over pi,
+   in linear RGB) that it lights a surface with normal n with:
+     sh[0] + sh[1]*y + sh[2]*z + sh[3]*x + sh[4]*x*y + sh[5]*y*z
+     + sh[6]*(3*z*z - 1) + sh[7]*x*z + sh[8]*(x*x - y*y)
+   for n=(x,y,z), so a white environment gives 1.  The constants are folded
+   into the coefficients, and each is padded to 4 floats (as in a std140
+   array of vec4) to upload as is.  The faces are summed four texels at a
+   time with SSE2, with the rows of all faces split among threads */
+extern int spotImageCubeMapSH(GLfloat sh[9][4], spotImage *img);
+
+/* --------------------- spotBC.c --------------------- */
+/* spotBCSize(format, sizeX, sizeY) is the number of bytes of blocks for
+   a sizeX by sizeY image, spotBCGLFormat(format) is the internal format to
+   pass to glCompressedTexImage2D, and spotBCGLCan(format) is non-zero if the
+   GL context can use the format */
+extern size_t spotBCSize(int format, unsigned int sizeX, unsigned int sizeY);
+extern GLenum spotBCGLFormat(int format);
+extern int spotBCGLCan(int format);
+/* spotBCEncode(blocks, format, data, sizeP, sizeX, sizeY) encodes the 8-bit
+   image data (with sizeP channels) into spotBCSize(..) bytes of blocks,
+   with the block rows split among threads */
+extern int spotBCEncode(void *blocks, int format, const unsigned char *data,
+                        unsigned int sizeP, unsigned int sizeX,
+                        unsigned int sizeY);
+/* spotImageLoadPNGBC(img, fname, dest) loads PNG fname as img->bcFormat
+   blocks, which are cached in a file next to it (fname plus ".bc1", ".bc3"
+   or ".bc5"), so they are only encoded again when the PNG changes.  With
+   dest NULL, this is spotImageLoadPNG plus the blocks in img->bcData.  With
+   non-NULL dest (which gets the blocks, as from spotImageGLBufferMap with
+   sizes from spotImageLoadPNGInfo) the pixels are not kept, and aren't
+   even decoded when the cache is current.  A 16-bit image is encoded from
+   its pixels narrowed to 8 bits (img->data stays 16-bit) */
+extern int spotImageLoadPNGBC(spotImage *img, const char *fname, void *dest);
+
+/* --------------------- spotPool.c --------------------- */
+/* spotPoolNew(capHint) creates an empty pool with room for capHint items
+   (it can grow past that as needed). spotPoolAdd adds a (non-NULL) item and
+   returns its handle, or SPOT_HANDLE_NONE in case of error.  spotPoolGet
+   returns the item for a handle, or NULL if the handle is stale, and
+   spotPoolItem(pool, ii) the ii-th live item, or NULL if ii >= pool->num.
+   spotPoolRemove removes the item from the pool and returns it (so that the
+   caller can free it), or NULL if the handle is stale. spotPoolNix frees
+   the pool but not the items in it */
+extern spotPool *spotPoolNew(unsigned int capHint);
+extern spotHandle spotPoolAdd(spotPool *pool, void *item);
+extern void *spotPoolGet(const spotPool *pool, spotHandle hh);
+extern void *spotPoolItem(const spotPool *pool, unsigned int ii);
+extern void *spotPoolRemove(spotPool *pool, spotHandle hh);
+extern spotPool *spotPoolNix(spotPool *pool);
+
+/* --------------------- spotArena.c --------------------- */
+/* spotArenaNew(chunkSize) creates an empty arena that will allocate in chunks
+   of chunkSize bytes (or 1MB if chunkSize is 0). spotArenaAlloc returns size
+   bytes of (uninitialized) memory aligned to SPOT_ALIGN, or NULL in case of
+   error. spotArenaReset frees everything allocated from the arena, which
+   can then be used again (e.g. for the next scene). spotArenaNix frees the
+   arena and everything allocated from it. */
+extern spotArena *spotArenaNew(size_t chunkSize);
+extern void *spotArenaAlloc(spotArena *arena, size_t size);
+extern void spotArenaReset(spotArena *arena);
+extern spotArena *spotArenaNix(spotArena *arena);
+
+/* --------------------- spotStream.c --------------------- */
+/* spotStreamNew(regionSize, regionNum) creates (with a current GL context)
+   a ring of regionNum regions of regionSize bytes each; regionNum=3 is a
+   good choice. Each frame, spotStreamMap reserves size bytes of the current
+   region and maps them for writing, returning the pointer and setting
+   *offset to the byte offset within ss->buffId (e.g. for
+   glVertexAttribPointer); spotStreamUnmap must follow before drawing.
+   spotStreamPush does map, memcpy, unmap. Data written in one frame is
+   valid only until spotStreamFrameEnd, which must be called once at the
+   end of every frame (after all the draw calls that use the stream); it
+   costs nothing in a frame that didn't write anything. Between frames,
+   spotStreamGrow(ss, regionSize) makes the regions at least regionSize
+   bytes, waiting for the GPU to finish with all of them first. */
+extern spotStream *spotStreamNew(GLsizeiptr regionSize, unsigned int regionNum);
+extern void *spotStreamMap(spotStream *ss, GLsizeiptr size, GLintptr *offset);
+extern int spotStreamUnmap(spotStream *ss);
+extern int spotStreamPush(spotStream *ss, const void *data, GLsizeiptr size,
+                          GLintptr *offset);
+extern int spotStreamFrameEnd(spotStream *ss);
+extern int spotStreamGrow(spotStream *ss, GLsizeiptr regionSize);
+extern spotStream *spotStreamNix(spotStream *ss);
+
+/* --------------------- spotCapture.c --------------------- */
+/* spotCaptureNew(slotNum, saveMax, withAlpha) creates (with a current GL
+   context) a ring of slotNum pack buffers (3 is a good choice), which can
+   have up to saveMax frames being encoded at once.  spotCaptureFrame(cap,
+   fname) starts reading the viewport of the current read buffer (for a
+   double-buffered window, by default the back buffer, so call it after
+   drawing a frame and before swapping buffers) to be saved as PNG fname.
+   Frames are read in order, and only block when all slotNum slots are
+   pending (or saveMax saves are).  spotCapturePoll(cap, wait) copies out
+   the frames the GPU is done with and starts their saves, and notes which
+   saves have finished; it should be called every frame.  With wait, it
+   waits for everything to be read and saved.  spotCapturePending(cap) is
+   the number of frames not yet saved.  spotCaptureNix(cap) also waits for
+   them, before freeing everything */
+extern spotCapture *spotCaptureNew(unsigned int slotNum, unsigned int saveMax,
+                                   int withAlpha);
+extern int spotCaptureFrame(spotCapture *cap, const char *fname);
+extern int spotCapturePoll(spotCapture *cap, int wait);
+extern unsigned int spotCapturePending(const spotCapture *cap);
+extern spotCapture *spotCaptureNix(spotCapture *cap);
+
+/* --------------------- spotWatch.c --------------------- */
+/* spotWatchNew() starts watching for changes to files (on Linux only, with
+   inotify; elsewhere it returns NULL).  spotWatchAdd(sw, fname) adds file
+   fname, and returns its index into sw->changed (or -1 on error).
+   spotWatchPoll(sw) never waits: it sets sw->changed[i] for every file i
+   saved since last time, and returns the number of sw->changed[] that are
+   set; clearing them is up to the caller. */
+extern spotWatch *spotWatchNew(void);
+extern int spotWatchAdd(spotWatch *sw, const char *fname);
+extern unsigned int spotWatchPoll(spotWatch *sw);
+extern spotWatch *spotWatchNix(spotWatch *sw);
 
 /* --------------------- spotGeomShapes.c --------------------- */
 /* All of these spotGeomNew* functions allocate and initialize a spotGeom
-   struct to contain some object.  All the objects fit inside the
+   struct to contain some object; each has a spotGeomNew*In(arena) version
+   that allocates it from the given arena (see spotGeomNewIn).  All the objects fit inside the
    [-1,1]x[-1,1]x[-1,1] cube in world space, and come with correct
    normals. There are three kinds of cubes to play with: Cube0 has a single
    normal at each corner; Cube1 has three normals at each corner (one for each
@@ -250,6 +778,15 @@ extern spotGeom *spotGeomNewEllipsoid(void);
 /* Just a single square (made of two triangles), which may be useful for
    testing texture mapping effects */
 extern spotGeom *spotGeomNewSquare(void);
+extern spotGeom *spotGeomNewCube0In(spotArena *arena);
+extern spotGeom *spotGeomNewCube1In(spotArena *arena);
+extern spotGeom *spotGeomNewConeIn(spotArena *arena);
+extern spotGeom *spotGeomNewSoftcylinderIn(spotArena *arena);
+extern spotGeom *spotGeomNewCylinderIn(spotArena *arena);
+extern spotGeom *spotGeomNewSphereIn(spotArena *arena);
+extern spotGeom *spotGeomNewSoftcubeIn(spotArena *arena);
+extern spotGeom *spotGeomNewEllipsoidIn(spotArena *arena);
+extern spotGeom *spotGeomNewSquareIn(spotArena *arena);
 
 
 /* --------------------- spotGeomMethods.c --------------------- */
@@ -262,9 +799,46 @@ extern spotGeom *spotGeomNewSquare(void);
                        sgeom = spotGeomNix(sgeom); (sets sgeom to NULL)
    Note that spotGeomDraw does NOT do anything to pass values to the 
    uniform variables of the shaders; you will have to handle this.
+
+   spotGeomNew(vertNum, indxNum, primNum) allocates a spotGeom with room for
+   that many vertices, indices, and primitives, with the struct and all its
+   arrays in one allocation (so spotGeomNix does one free), each array
+   aligned to SPOT_ALIGN. Everything is set to the same defaults as the
+   spotGeomNew___ functions use, but the array contents are zero (except for
+   rgb, which is all 1.0). spotGeomNewIn(arena, vertNum, indxNum, primNum)
+   is the same, but allocates from arena (if non-NULL) instead.
+   spotGeomNix of a geom from an arena does nothing; the memory is freed by
+   spotArenaReset or spotArenaNix, but the geom still needs its own
+   spotGeomGLDone.  A spotGeom built by hand, with its struct and arrays
+   each malloc()d separately, gets its arrays freed by spotGeomNix, whatever
+   malloc() left in its alloc field (see spotGeomAllocSeparate).
 */
+extern spotGeom *spotGeomNew(unsigned int vertNum, unsigned int indxNum,
+                             unsigned int primNum);
+extern spotGeom *spotGeomNewIn(spotArena *arena, unsigned int vertNum,
+                               unsigned int indxNum, unsigned int primNum);
 extern int spotGeomGLInit(spotGeom *sgeom);
 extern int spotGeomDraw(spotGeom *sgeom);
+/* spotGeomDrawMask(sgeom, attrMask) draws like spotGeomDraw, but with only
+   the vertex attributes with bit (1 << spotVertAttrIndx_*) set in attrMask
+   enabled, e.g. the mask from spotProgramAttrMask for the program in use, so
+   that attributes the shaders don't read aren't fetched. The VAO for each
+   mask is made the first time it's drawn with */
+extern int spotGeomDrawMask(spotGeom *sgeom, unsigned int attrMask);
+/* For a spotGeom with a non-zero streamMask, spotGeomStream (called every
+   frame before spotGeomDraw) sends those attributes' CPU arrays through the
+   stream and points the VAO at them. Attributes dropped from streamMask go
+   back to their static buffers (as they were at spotGeomGLInit). */
+extern int spotGeomStream(spotGeom *sgeom, spotStream *ss);
+/* spotGeomStreamSize(sgeom, attrMask) is how many bytes of a spotStream
+   region spotGeomStream needs for the attributes in attrMask, e.g. for
+   sizing the regions with spotStreamNew. */
+extern GLsizeiptr spotGeomStreamSize(spotGeom *sgeom, unsigned int attrMask);
+/* spotGeomGLUpdate(sgeom, attrMask) re-sends the CPU arrays of the
+   attributes in attrMask to their static buffers (in place, without
+   reallocating them), for data that changes now and then rather than every
+   frame; attributes without a buffer (before spotGeomGLInit) are skipped */
+extern int spotGeomGLUpdate(spotGeom *sgeom, unsigned int attrMask);
 extern int spotGeomGLDone(spotGeom *sgeom);
 extern spotGeom *spotGeomNix(spotGeom *sgeom);
 
@@ -272,11 +846,47 @@ extern spotGeom *spotGeomNix(spotGeom *sgeom);
 /* New functions for Project 3 functionality */
 /* spotImageCubeMapGLInit: initialize spotImage as a cube map */
 extern int spotImageCubeMapGLInit(spotImage *img);
+/* spotImageCubeMapFacesGLInit(img, fname): initialize empty spotImage as a
+ *   cube map from six PNGs of square RGB faces, in +X,-X,+Y,-Y,+Z,-Z order.
+ *   They are decoded in parallel (spotImageLoadPNGAsync) and each face is
+ *   uploaded from where it was decoded to, so img->data stays NULL; img gets
+ *   the sizes of the tall image (faces stacked along Y) they would make.
+ *   With img->bcFormat set, the faces are block compressed as they load */
+extern int spotImageCubeMapFacesGLInit(spotImage *img,
+                                       const char *const fname[6]);
 /* spotGeomTransform: apply given transform to the spotGeom,
  *   including appropriate transform of normal and tangents */
 extern int spotGeomTransform(spotGeom *sgeom, const GLfloat xform[16]);
 /* spotGeomColorRGB: apply color to all per-vertex colors in spotGeom */
 extern int spotGeomColorRGB(spotGeom *sgem, const GLfloat RGB[3]);
+/* The set-up shared by every program of our stack, so that proj3 and bench
+ *   draw with the same bindings.  Every program's "Irradiance" uniform block
+ *   reads from binding point SPOT_PROJ3_IRRADIANCE_BINDING, and its samplers
+ *   read from the texture units of the enum below (samplers of different
+ *   types can't share a unit, so each has its own) */
+#define SPOT_PROJ3_IRRADIANCE_BINDING 0
+enum {
+  spotProj3Unit_cubeMap,   /* samplerCube cubeMap */
+  spotProj3Unit_samplerA,  /* sampler2D samplerA: the color texture */
+  spotProj3Unit_samplerB,  /* sampler2D samplerB: the normal map */
+  spotProj3Unit_samplerArray, /* sampler2DArray samplerArray: with -a */
+};
+/* spotProj3ProgramSubmitTo(program, defines, vertFname, fragFname) is
+ *   spotProgramSubmitTo with our vertex attribute bindings (vertPos, vertNorm,
+ *   vertTex2, vertRgb, vertTang, at their spotVertAttrIndx_*) */
+extern spotProgramJob *spotProj3ProgramSubmitTo(GLuint program,
+                                                const char *const *defines,
+                                                const char *vertFname,
+                                                const char *fragFname);
+/* spotProj3ProgramLinked(program): once program has linked, binds its
+ *   "Irradiance" block (if it has one) and gives its samplers their units.
+ *   This leaves program in use */
+extern void spotProj3ProgramLinked(GLuint program);
+/* spotProj3IrradianceNew(size, data, usage) returns a new uniform buffer of
+ *   size bytes (from data, if not NULL), bound to
+ *   SPOT_PROJ3_IRRADIANCE_BINDING for every program */
+extern GLuint spotProj3IrradianceNew(GLsizeiptr size, const GLvoid *data,
+                                     GLenum usage);
 
 #ifdef __cplusplus
 }
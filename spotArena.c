@@ -0,0 +1,98 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+/*
+** Each chunk starts with a pointer to the previous chunk, followed (after
+** padding up to SPOT_ALIGN) by the memory handed out by spotArenaAlloc.
+*/
+#define CHUNK_HEAD SPOT_ALIGN_UP(sizeof(void*))
+
+static void *_spotArenaChunkNew(void *prev, size_t size) {
+  void *chunk;
+
+  if (posix_memalign(&chunk, SPOT_ALIGN, CHUNK_HEAD + size)) {
+    return NULL;
+  }
+  *((void **)chunk) = prev;
+  return chunk;
+}
+
+spotArena *spotArenaNew(size_t chunkSize) {
+  const char me[]="spotArenaNew";
+  spotArena *arena;
+
+  arena = (spotArena *)calloc(1, sizeof(spotArena));
+  if (!arena) {
+    spotErrorAdd("%s: allocation failure", me);
+    return NULL;
+  }
+  arena->chunkSize = SPOT_ALIGN_UP(chunkSize ? chunkSize : 1024*1024);
+  arena->chunk = NULL;
+  /* so that the first spotArenaAlloc starts a chunk */
+  arena->chunkUsed = arena->chunkLen = 0;
+  return arena;
+}
+
+void *spotArenaAlloc(spotArena *arena, size_t size) {
+  const char me[]="spotArenaAlloc";
+  void *ret, *chunk;
+  size_t len;
+
+  if (!arena) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return NULL;
+  }
+  size = SPOT_ALIGN_UP(size);
+  if (arena->chunkUsed + size > arena->chunkLen) {
+    /* requests bigger than chunkSize get a chunk all their own */
+    len = size > arena->chunkSize ? size : arena->chunkSize;
+    if (!( chunk = _spotArenaChunkNew(arena->chunk, len) )) {
+      spotErrorAdd("%s: couldn't allocate %lu-byte chunk", me,
+                   (unsigned long)len);
+      return NULL;
+    }
+    arena->chunk = chunk;
+    arena->chunkUsed = 0;
+    arena->chunkLen = len;
+  }
+  ret = (char *)arena->chunk + CHUNK_HEAD + arena->chunkUsed;
+  arena->chunkUsed += size;
+  return ret;
+}
+
+void spotArenaReset(spotArena *arena) {
+  void *chunk, *prev;
+
+  if (!arena) {
+    return;
+  }
+  for (chunk = arena->chunk; chunk; chunk = prev) {
+    prev = *((void **)chunk);
+    free(chunk);
+  }
+  arena->chunk = NULL;
+  arena->chunkUsed = arena->chunkLen = 0;
+  return;
+}
+
+spotArena *spotArenaNix(spotArena *arena) {
+
+  if (arena) {
+    spotArenaReset(arena);
+    free(arena);
+  }
+  return NULL;
+}
@@ -0,0 +1,476 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+/* from EXT_texture_compression_s3tc, and (core since GL 3.0) RGTC */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#  define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#  define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RG_RGTC2
+#  define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+
+/*
+** The block cache.  The blocks for "foo.png" are stored in "foo.png.bc1"
+** (or .bc3, .bc5), which starts with BC_MAGIC, then the hash of the PNG
+** file's bytes (so that an edited PNG is encoded again), the format and
+** the image size, followed by the blocks themselves.  Change BC_MAGIC
+** whenever the encoder changes what it produces.
+*/
+#define BC_MAGIC "SPOTBC01"
+
+/*
+** _spotBCJob: what the threads encoding one image (via spotParallel) share
+*/
+typedef struct {
+  unsigned char *blocks;
+  int format;
+  const unsigned char *data;
+  unsigned int sizeP, sizeX, sizeY;
+} _spotBCJob;
+
+size_t spotBCSize(int format, unsigned int sizeX, unsigned int sizeY) {
+  return ((size_t)(sizeX + 3)/4)*((sizeY + 3)/4)*(spotBC1 == format ? 8 : 16);
+}
+
+GLenum spotBCGLFormat(int format) {
+  switch (format) {
+  case spotBC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case spotBC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case spotBC5: return GL_COMPRESSED_RG_RGTC2;
+  }
+  return 0;
+}
+
+int spotBCGLCan(int format) {
+  switch (format) {
+  case spotBC1:
+  case spotBC3:
+    return spotGLExtension("GL_EXT_texture_compression_s3tc");
+  case spotBC5:
+    return 1;
+  }
+  return 0;
+}
+
+static unsigned short _spotBC565(const float cc[3]) {
+  return (unsigned short)(((int)(cc[0]*31/255 + 0.5f) << 11)
+                          | ((int)(cc[1]*63/255 + 0.5f) << 5)
+                          | (int)(cc[2]*31/255 + 0.5f));
+}
+
+static void _spotBC565To888(float cc[3], unsigned short vv) {
+  unsigned int rr, gg, bb;
+
+  rr = (vv >> 11) & 31;
+  gg = (vv >> 5) & 63;
+  bb = vv & 31;
+  SPOT_V3_SET(cc, (float)((rr << 3) | (rr >> 2)), (float)((gg << 2) | (gg >> 4)),
+              (float)((bb << 3) | (bb >> 2)));
+}
+
+/*
+** _spotBCIndices: for each of the num (a multiple of 4) values tt (position
+** along the line from the first endpoint, 0, to the last, 1), the nearest
+** of steps+1 evenly spaced points, as 0 ... steps
+*/
+static void _spotBCIndices(unsigned int *idx, const float *tt, unsigned int num,
+                           unsigned int steps) {
+  unsigned int ii;
+
+  ii = 0;
+#ifdef __SSE2__
+  {
+    __m128 scl = _mm_set1_ps((float)steps), half = _mm_set1_ps(0.5f),
+      zero = _mm_setzero_ps(), top = _mm_set1_ps((float)steps);
+    for (; ii<num; ii+=4) {
+      __m128 vv = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(tt + ii), scl), half);
+      vv = _mm_min_ps(_mm_max_ps(vv, zero), top);
+      _mm_storeu_si128((__m128i *)(idx + ii), _mm_cvttps_epi32(vv));
+    }
+  }
+#endif
+  for (; ii<num; ii++) {
+    idx[ii] = (unsigned int)SPOT_CLAMP(0.0f, tt[ii]*steps + 0.5f, (float)steps);
+  }
+  return;
+}
+
+/*
+** _spotBCColor: one BC1 color block (8 bytes) from 16 RGB pixels (in
+** [0,255]), with the endpoints at the extremes of the pixels along their
+** principal axis (inset a little, since the extremes are rarely both hit)
+*/
+static void _spotBCColor(unsigned char *out, float px[16][3]) {
+  /* order of the palette entries along the line from color 0 to color 1 */
+  static const unsigned int order[4] = {0, 2, 3, 1};
+  float mean[3], cov[6], axis[3], vec[3], tt[16], tmin, tmax, len, c0[3], c1[3];
+  unsigned int ii, it, idx[16], bits;
+  unsigned short v0, v1, swap;
+
+  SPOT_V3_SET(mean, 0, 0, 0);
+  for (ii=0; ii<16; ii++) {
+    SPOT_V3_ADD(mean, mean, px[ii]);
+  }
+  SPOT_V3_SCALE(mean, 1.0f/16, mean);
+  memset(cov, 0, sizeof(cov));
+  for (ii=0; ii<16; ii++) {
+    SPOT_V3_SUB(vec, px[ii], mean);
+    cov[0] += vec[0]*vec[0]; cov[1] += vec[0]*vec[1]; cov[2] += vec[0]*vec[2];
+    cov[3] += vec[1]*vec[1]; cov[4] += vec[1]*vec[2]; cov[5] += vec[2]*vec[2];
+  }
+  /* power iteration for the principal axis */
+  SPOT_V3_SET(axis, 1, 1, 1);
+  for (it=0; it<4; it++) {
+    SPOT_V3_SET(vec,
+                cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2],
+                cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2],
+                cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2]);
+    len = (float)SPOT_V3_LEN(vec);
+    if (len < 1e-6f) {
+      break;
+    }
+    SPOT_V3_SCALE(axis, 1.0f/len, vec);
+  }
+  tmin = tmax = 0;
+  for (ii=0; ii<16; ii++) {
+    SPOT_V3_SUB(vec, px[ii], mean);
+    tt[ii] = SPOT_V3_DOT(vec, axis);
+    tmin = SPOT_MIN(tmin, tt[ii]);
+    tmax = SPOT_MAX(tmax, tt[ii]);
+  }
+  len = (tmax - tmin)/16;
+  for (ii=0; ii<3; ii++) {
+    c0[ii] = SPOT_CLAMP(0.0f, mean[ii] + (tmax - len)*axis[ii], 255.0f);
+    c1[ii] = SPOT_CLAMP(0.0f, mean[ii] + (tmin + len)*axis[ii], 255.0f);
+  }
+  v0 = _spotBC565(c0);
+  v1 = _spotBC565(c1);
+  if (v0 < v1) {
+    /* color 0 > color 1 means four colors (and no transparency) */
+    swap = v0; v0 = v1; v1 = swap;
+  }
+  bits = 0;
+  if (v0 != v1) {
+    /* positions along the line between the colors actually stored */
+    _spotBC565To888(c0, v0);
+    _spotBC565To888(c1, v1);
+    SPOT_V3_SUB(axis, c1, c0);
+    len = SPOT_V3_DOT(axis, axis);
+    for (ii=0; ii<16; ii++) {
+      SPOT_V3_SUB(vec, px[ii], c0);
+      tt[ii] = SPOT_V3_DOT(vec, axis)/len;
+    }
+    _spotBCIndices(idx, tt, 16, 3);
+    for (ii=0; ii<16; ii++) {
+      bits |= order[idx[ii]] << (2*ii);
+    }
+  }
+  out[0] = v0 & 0xff; out[1] = v0 >> 8;
+  out[2] = v1 & 0xff; out[3] = v1 >> 8;
+  out[4] = bits & 0xff; out[5] = (bits >> 8) & 0xff;
+  out[6] = (bits >> 16) & 0xff; out[7] = bits >> 24;
+  return;
+}
+
+/*
+** _spotBCSingle: one BC4 block (8 bytes; used for BC3 alpha and both BC5
+** channels) from 16 values in [0,255]: the extremes are the endpoints, with
+** the six values between them
+*/
+static void _spotBCSingle(unsigned char *out, const float val[16]) {
+  /* order of the palette entries from value 0 (the max) to value 1 */
+  static const unsigned int order[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+  float vmin, vmax, tt[16];
+  unsigned int ii, idx[16];
+  unsigned long long bits;
+
+  vmin = vmax = val[0];
+  for (ii=1; ii<16; ii++) {
+    vmin = SPOT_MIN(vmin, val[ii]);
+    vmax = SPOT_MAX(vmax, val[ii]);
+  }
+  out[0] = (unsigned char)(vmax + 0.5f);
+  out[1] = (unsigned char)(vmin + 0.5f);
+  bits = 0;
+  if (out[0] != out[1]) {
+    for (ii=0; ii<16; ii++) {
+      tt[ii] = (out[0] - val[ii])/(out[0] - out[1]);
+    }
+    _spotBCIndices(idx, tt, 16, 7);
+    for (ii=0; ii<16; ii++) {
+      bits |= (unsigned long long)order[idx[ii]] << (3*ii);
+    }
+  }
+  for (ii=0; ii<6; ii++) {
+    out[2+ii] = (bits >> (8*ii)) & 0xff;
+  }
+  return;
+}
+
+/*
+** _spotBCRows: encodes block rows [row0,row1) of the job's image.  Pixels
+** past the edge of an image whose size isn't a multiple of 4 (as with the
+** smallest mip levels) repeat the last row or column
+*/
+static void _spotBCRows(void *_job, unsigned int row0, unsigned int row1) {
+  _spotBCJob *job = (_spotBCJob *)_job;
+  unsigned int by, bx, bxNum, pi, xx, yy, cc, blockSize, sizeP;
+  const unsigned char *pp;
+  unsigned char *out;
+  float px[16][3], alpha[16], chan[2][16];
+
+  sizeP = job->sizeP;
+  bxNum = (job->sizeX + 3)/4;
+  blockSize = spotBC1 == job->format ? 8 : 16;
+  for (by=row0; by<row1; by++) {
+    for (bx=0; bx<bxNum; bx++) {
+      for (pi=0; pi<16; pi++) {
+        xx = SPOT_MIN(4*bx + pi % 4, job->sizeX - 1);
+        yy = SPOT_MIN(4*by + pi / 4, job->sizeY - 1);
+        pp = job->data + sizeP*((size_t)xx + (size_t)job->sizeX*yy);
+        for (cc=0; cc<3; cc++) {
+          /* gray (with or without alpha) is the same in all three */
+          px[pi][cc] = pp[sizeP >= 3 ? cc : 0];
+        }
+        alpha[pi] = (2 == sizeP || 4 == sizeP) ? pp[sizeP-1] : 255;
+        chan[0][pi] = pp[0];
+        chan[1][pi] = pp[sizeP > 1 ? 1 : 0];
+      }
+      out = job->blocks + blockSize*((size_t)bx + (size_t)bxNum*by);
+      switch (job->format) {
+      case spotBC1:
+        _spotBCColor(out, px);
+        break;
+      case spotBC3:
+        _spotBCSingle(out, alpha);
+        _spotBCColor(out + 8, px);
+        break;
+      case spotBC5:
+        _spotBCSingle(out, chan[0]);
+        _spotBCSingle(out + 8, chan[1]);
+        break;
+      }
+    }
+  }
+  return;
+}
+
+int spotBCEncode(void *blocks, int format, const unsigned char *data,
+                 unsigned int sizeP, unsigned int sizeX, unsigned int sizeY) {
+  const char me[]="spotBCEncode";
+  _spotBCJob job;
+
+  if (!( blocks && data )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, blocks, (void*)data);
+    return 1;
+  }
+  if (!( spotBC1 == format || spotBC3 == format || spotBC5 == format )) {
+    spotErrorAdd("%s: format %d not valid", me, format);
+    return 1;
+  }
+  if (!( 1 <= sizeP && sizeP <= 4 && sizeX && sizeY )) {
+    spotErrorAdd("%s: can't encode %u x %u x %u", me, sizeP, sizeX, sizeY);
+    return 1;
+  }
+  job.blocks = (unsigned char *)blocks;
+  job.format = format;
+  job.data = data;
+  job.sizeP = sizeP;
+  job.sizeX = sizeX;
+  job.sizeY = sizeY;
+  /* roughly a few hundred operations per block */
+  spotParallel(_spotBCRows, &job, (sizeY + 3)/4, (size_t)sizeX*sizeY*32);
+  return 0;
+}
+
+static char *_spotBCCachePath(const char *fname, int format) {
+  char *path;
+
+  if ((path = (char *)malloc(strlen(fname) + strlen(".bcN") + 1))) {
+    sprintf(path, "%s.bc%d", fname, spotBC1 == format ? 1 : spotBC3 == format ? 3 : 5);
+  }
+  return path;
+}
+
+/* reads the blocks cached for img from path, returning 1 if that worked,
+   or 0 if there aren't any current ones (which is not an error) */
+static int _spotBCCacheLoad(void *blocks, const spotImage *img, const char *path,
+                            unsigned long long hash) {
+  char magic[sizeof(BC_MAGIC)-1];
+  unsigned long long fhash;
+  unsigned int head[3];
+  FILE *file;
+  int ret;
+
+  if (!(file = fopen(path, "rb"))) {
+    return 0;
+  }
+  ret = (1 == fread(magic, sizeof(magic), 1, file)
+         && !memcmp(magic, BC_MAGIC, sizeof(magic))
+         && 1 == fread(&fhash, sizeof(fhash), 1, file) && fhash == hash
+         && 1 == fread(head, sizeof(head), 1, file)
+         && head[0] == (unsigned int)img->bcFormat
+         && head[1] == img->sizeX && head[2] == img->sizeY
+         && 1 == fread(blocks, spotBCSize(img->bcFormat, img->sizeX, img->sizeY),
+                       1, file));
+  fclose(file);
+  return ret;
+}
+
+/* saves the blocks to the cache; failing to do so only costs encoding them
+   again next time, so it is noted on stderr but not an error */
+static void _spotBCCacheSave(const void *blocks, const spotImage *img,
+                             const char *path, unsigned long long hash) {
+  const char me[]="spotImageLoadPNGBC";
+  unsigned int head[3];
+  char *tmpPath;
+  FILE *file;
+  int bad;
+
+  if (!(tmpPath = (char *)malloc(strlen(path) + strlen(".tmp") + 1))) {
+    return;
+  }
+  head[0] = (unsigned int)img->bcFormat;
+  head[1] = img->sizeX;
+  head[2] = img->sizeY;
+  /* written under another name and then renamed, so that another process
+     starting up at the same time never sees half a file */
+  sprintf(tmpPath, "%s.tmp", path);
+  bad = 1;
+  if ((file = fopen(tmpPath, "wb"))) {
+    bad = !( 1 == fwrite(BC_MAGIC, sizeof(BC_MAGIC)-1, 1, file)
+             && 1 == fwrite(&hash, sizeof(hash), 1, file)
+             && 1 == fwrite(head, sizeof(head), 1, file)
+             && 1 == fwrite(blocks, spotBCSize(img->bcFormat, img->sizeX, img->sizeY),
+                            1, file) );
+    bad |= !!fclose(file);
+    bad = bad || rename(tmpPath, path);
+  }
+  if (bad) {
+    fprintf(stderr, "%s: couldn't save blocks to \"%s\"\n", me, path);
+    remove(tmpPath);
+  }
+  free(tmpPath);
+}
+
+int spotImageLoadPNGBC(spotImage *img, const char *fname, void *dest) {
+  const char me[]="spotImageLoadPNGBC";
+  unsigned long long hash;
+  unsigned char *pixels, *narrow;
+  size_t num;
+  char *path;
+  void *blocks;
+  int hashed;
+
+  if (!( img && fname )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)img, (void*)fname);
+    return 1;
+  }
+  if (!( spotBC1 == img->bcFormat || spotBC3 == img->bcFormat
+         || spotBC5 == img->bcFormat )) {
+    spotErrorAdd("%s: image bcFormat %d not valid", me, img->bcFormat);
+    return 1;
+  }
+  if (!(path = _spotBCCachePath(fname, img->bcFormat))) {
+    spotErrorAdd("%s: allocation failure", me);
+    return 1;
+  }
+  hash = SPOT_HASH_START;
+  hashed = !spotHashFile(&hash, fname);
+  if (dest) {
+    /* the sizes are known (from spotImageLoadPNGInfo), so with current
+       blocks in the cache there is no need to decode the PNG at all */
+    if (hashed && _spotBCCacheLoad(dest, img, path, hash)) {
+      free(path);
+      return 0;
+    }
+    /* else the pixels are only needed long enough to encode them; this
+       mustn't reset img (as spotImageLoadPNG does), which has the buffer */
+    blocks = dest;
+    if (!(pixels = (unsigned char *)malloc((size_t)img->sizeC*img->sizeP
+                                           *img->sizeX*img->sizeY))) {
+      spotErrorAdd("%s: allocation failure", me);
+      free(path);
+      return 1;
+    }
+    if (spotImageLoadPNGInto(img, fname, pixels)) {
+      spotErrorAdd("%s: couldn't load \"%s\"", me, fname);
+      free(pixels);
+      free(path);
+      return 1;
+    }
+  } else {
+    if (spotImageLoadPNG(img, (char *)fname)) {
+      spotErrorAdd("%s: couldn't load \"%s\"", me, fname);
+      free(path);
+      return 1;
+    }
+    if (!(blocks = img->bcData = malloc(spotBCSize(img->bcFormat, img->sizeX,
+                                                   img->sizeY)))) {
+      spotErrorAdd("%s: allocation failure", me);
+      free(path);
+      return 1;
+    }
+    if (hashed && _spotBCCacheLoad(blocks, img, path, hash)) {
+      free(path);
+      return 0;
+    }
+    pixels = img->data.uc;
+  }
+  narrow = NULL;
+  if (2 == img->sizeC) {
+    /* the blocks hold less than 8 bits per channel, so nothing is lost by
+       narrowing first: in place in the scratch pixels, but without
+       touching img->data, which stays 16-bit */
+    num = (size_t)img->sizeP*img->sizeX*img->sizeY;
+    if (!dest) {
+      if (!(narrow = (unsigned char *)malloc(num))) {
+        spotErrorAdd("%s: allocation failure", me);
+        free(path);
+        return 1;
+      }
+      pixels = narrow;
+    }
+    spotConvert16To8(pixels, dest ? (const unsigned short *)pixels
+                     : img->data.us, num);
+  }
+  if (spotBCEncode(blocks, img->bcFormat, pixels, img->sizeP,
+                   img->sizeX, img->sizeY)) {
+    spotErrorAdd("%s: couldn't encode \"%s\"", me, fname);
+    if (dest) {
+      free(pixels);
+    }
+    free(narrow);
+    free(path);
+    return 1;
+  }
+  if (dest) {
+    free(pixels);
+  }
+  free(narrow);
+  if (hashed) {
+    _spotBCCacheSave(blocks, img, path, hash);
+  }
+  free(path);
+  return 0;
+}
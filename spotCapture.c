@@ -0,0 +1,244 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+/* how long (in nanoseconds) to wait for the GPU at a time, before
+   checking again */
+#define WAIT_NS 1000000000
+
+spotCapture *spotCaptureNew(unsigned int slotNum, unsigned int saveMax,
+                            int withAlpha) {
+  const char me[]="spotCaptureNew";
+  spotCapture *cap;
+  unsigned int si;
+
+  if (!( slotNum > 0 && saveMax > 0 )) {
+    spotErrorAdd("%s: got bad slot count %u or save count %u", me,
+                 slotNum, saveMax);
+    return NULL;
+  }
+  cap = (spotCapture *)calloc(1, sizeof(spotCapture));
+  if (!cap) {
+    spotErrorAdd("%s: allocation failure", me);
+    return NULL;
+  }
+  cap->slot = (spotCaptureSlot *)calloc(slotNum, sizeof(spotCaptureSlot));
+  cap->save = (spotImageLoad **)calloc(saveMax, sizeof(spotImageLoad *));
+  cap->saveImg = (spotImage **)calloc(saveMax, sizeof(spotImage *));
+  if (!( cap->slot && cap->save && cap->saveImg )) {
+    spotErrorAdd("%s: couldn't allocate %u slots and %u saves", me,
+                 slotNum, saveMax);
+    free(cap->slot); free(cap->save); free(cap->saveImg); free(cap);
+    return NULL;
+  }
+  cap->slotNum = slotNum;
+  cap->saveMax = saveMax;
+  cap->withAlpha = withAlpha;
+  /* each buffer is allocated when first read into, at the size of the
+     frame, which is only known then */
+  for (si=0; si<slotNum; si++) {
+    glGenBuffers(1, &(cap->slot[si].buffId));
+  }
+  return cap;
+}
+
+/*
+** _spotCaptureReap: finishes the oldest save, waiting for it if need be
+*/
+static int _spotCaptureReap(spotCapture *cap) {
+  int ret;
+
+  ret = spotImageLoadWait(cap->save[0]);
+  spotImageNix(cap->saveImg[0]);
+  cap->saveNum--;
+  memmove(cap->save, cap->save + 1, cap->saveNum*sizeof(spotImageLoad *));
+  memmove(cap->saveImg, cap->saveImg + 1, cap->saveNum*sizeof(spotImage *));
+  return ret;
+}
+
+/*
+** _spotCaptureRetire: copies the oldest pending frame out of its slot and
+** starts saving it.  Without wait, this returns -1 (and does nothing) if
+** the GPU isn't done with the slot yet.  The slot is free again afterwards,
+** even in case of error
+*/
+static int _spotCaptureRetire(spotCapture *cap, int wait) {
+  const char me[]="_spotCaptureRetire";
+  spotCaptureSlot *slot;
+  spotImage *img;
+  const unsigned char *src;
+  unsigned int rowsize, yi;
+  GLenum ret;
+  int bad;
+
+  slot = cap->slot + (cap->head + cap->slotNum - cap->pending) % cap->slotNum;
+  do {
+    ret = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                           wait ? WAIT_NS : 0);
+  } while (wait && GL_TIMEOUT_EXPIRED == ret);
+  if (GL_TIMEOUT_EXPIRED == ret) {
+    return -1;
+  }
+  glDeleteSync(slot->fence);
+  slot->fence = 0;
+  cap->pending--;
+  bad = 0;
+  if (GL_WAIT_FAILED == ret) {
+    spotErrorAdd("%s: waiting on \"%s\" failed: %s", me, slot->fname,
+                 spotGLErrorString(glGetError()));
+    bad = 1;
+  }
+  /* make room for one more save */
+  if (!bad && cap->saveNum == cap->saveMax && _spotCaptureReap(cap)) {
+    spotErrorAdd("%s: couldn't save an earlier frame", me);
+    bad = 1;
+  }
+  img = NULL;
+  if (!bad && !( (img = spotImageNew())
+                 && !spotImageAlloc(img, 1, cap->withAlpha ? 4 : 3,
+                                    slot->sizeX, slot->sizeY) )) {
+    spotErrorAdd("%s: couldn't allocate %u x %u image", me,
+                 slot->sizeX, slot->sizeY);
+    bad = 1;
+  }
+  if (!bad) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffId);
+    src = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                                  slot->buffSize,
+                                                  GL_MAP_READ_BIT);
+    if (src) {
+      /* GL's rows go bottom to top, and the PNG's top to bottom; this is
+         the one copy out of the mapping, so the flip happens here */
+      rowsize = img->sizeP*img->sizeX;
+      for (yi=0; yi<img->sizeY; yi++) {
+        memcpy(img->data.uc + (size_t)yi*rowsize,
+               src + (size_t)(img->sizeY - 1 - yi)*rowsize, rowsize);
+      }
+      if (GL_TRUE != glUnmapBuffer(GL_PIXEL_PACK_BUFFER)) {
+        spotErrorAdd("%s: pixels of \"%s\" were lost", me, slot->fname);
+        bad = 1;
+      }
+    } else {
+      spotErrorAdd("%s: couldn't map pixels of \"%s\": %s", me, slot->fname,
+                   spotGLErrorString(glGetError()));
+      bad = 1;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+  if (!bad) {
+    if ((cap->save[cap->saveNum] = spotImageSavePNGAsync(img, slot->fname))) {
+      cap->saveImg[cap->saveNum++] = img;
+      img = NULL;
+    } else {
+      spotErrorAdd("%s: couldn't start saving \"%s\"", me, slot->fname);
+      bad = 1;
+    }
+  }
+  spotImageNix(img);
+  free(slot->fname);
+  slot->fname = NULL;
+  return bad;
+}
+
+int spotCaptureFrame(spotCapture *cap, const char *fname) {
+  const char me[]="spotCaptureFrame";
+  spotCaptureSlot *slot;
+  GLint vport[4];
+  GLsizeiptr size;
+  int bad;
+
+  if (!( cap && fname )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)cap, (void*)fname);
+    return 1;
+  }
+  bad = 0;
+  if (cap->pending == cap->slotNum && _spotCaptureRetire(cap, SPOT_TRUE)) {
+    /* that frame is lost, but its slot is free for this one */
+    spotErrorAdd("%s: trouble with an earlier frame", me);
+    bad = 1;
+  }
+  slot = cap->slot + cap->head;
+  if (!( slot->fname = spotStrdup(fname) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    return 1;
+  }
+  glGetIntegerv(GL_VIEWPORT, vport);
+  size = (GLsizeiptr)vport[2]*vport[3]*(cap->withAlpha ? 4 : 3);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffId);
+  if (size != slot->buffSize) {
+    /* first use of the slot, or the window changed size */
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    slot->buffSize = size;
+  }
+  /* RGB rows needn't be a multiple of 4 bytes */
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  /* with a pack buffer bound, this only queues the copy into it */
+  glReadPixels(vport[0], vport[1], vport[2], vport[3],
+               cap->withAlpha ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, NULL);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot->sizeX = vport[2];
+  slot->sizeY = vport[3];
+  cap->head = (cap->head + 1) % cap->slotNum;
+  cap->pending++;
+  return bad;
+}
+
+int spotCapturePoll(spotCapture *cap, int wait) {
+  const char me[]="spotCapturePoll";
+  int ret, bad;
+
+  if (!cap) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  bad = 0;
+  while (cap->pending) {
+    if (-1 == (ret = _spotCaptureRetire(cap, wait))) {
+      /* the later frames were read after this one, so aren't done either */
+      break;
+    }
+    bad |= ret;
+  }
+  while (cap->saveNum && (wait || spotImageLoadDone(cap->save[0]))) {
+    bad |= _spotCaptureReap(cap);
+  }
+  if (bad) {
+    spotErrorAdd("%s: trouble saving frames", me);
+  }
+  return bad;
+}
+
+unsigned int spotCapturePending(const spotCapture *cap) {
+
+  return cap ? cap->pending + cap->saveNum : 0;
+}
+
+spotCapture *spotCaptureNix(spotCapture *cap) {
+  unsigned int si;
+
+  if (cap) {
+    spotCapturePoll(cap, SPOT_TRUE);
+    for (si=0; si<cap->slotNum; si++) {
+      glDeleteBuffers(1, &(cap->slot[si].buffId));
+    }
+    free(cap->slot);
+    free(cap->save);
+    free(cap->saveImg);
+    free(cap);
+  }
+  return NULL;
+}
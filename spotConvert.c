@@ -0,0 +1,101 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+/*
+** Conversions of 16-bit pixel data, eight values at a time with SSE2 and
+** the rest (or all, without SSE2) one at a time.  None of these need any
+** alignment.
+*/
+
+void spotConvertSwap16(unsigned short *dst, const unsigned short *src,
+                       size_t num) {
+  size_t ii;
+
+  ii = 0;
+#ifdef __SSE2__
+  for (; ii+8<=num; ii+=8) {
+    __m128i vv = _mm_loadu_si128((const __m128i *)(src + ii));
+    vv = _mm_or_si128(_mm_slli_epi16(vv, 8), _mm_srli_epi16(vv, 8));
+    _mm_storeu_si128((__m128i *)(dst + ii), vv);
+  }
+#endif
+  for (; ii<num; ii++) {
+    dst[ii] = (unsigned short)((src[ii] << 8) | (src[ii] >> 8));
+  }
+  return;
+}
+
+void spotConvertRGBToRGBA16(unsigned short *dst, const unsigned short *src,
+                            size_t pixNum) {
+  size_t pi;
+
+  pi = 0;
+#ifdef __SSE2__
+  {
+    /* each pixel is loaded as 4 values (its RGB and the next R), and the
+       fourth is replaced by the alpha; stopping one pixel early keeps the
+       last load inside src */
+    __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1),
+      alpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0), v0, v1;
+    for (; pi+5<=pixNum; pi+=4) {
+      v0 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(src + 3*pi)),
+                              _mm_loadl_epi64((const __m128i *)(src + 3*pi + 3)));
+      v1 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(src + 3*pi + 6)),
+                              _mm_loadl_epi64((const __m128i *)(src + 3*pi + 9)));
+      _mm_storeu_si128((__m128i *)(dst + 4*pi),
+                       _mm_or_si128(_mm_and_si128(v0, rgb), alpha));
+      _mm_storeu_si128((__m128i *)(dst + 4*pi + 8),
+                       _mm_or_si128(_mm_and_si128(v1, rgb), alpha));
+    }
+  }
+#endif
+  for (; pi<pixNum; pi++) {
+    dst[4*pi + 0] = src[3*pi + 0];
+    dst[4*pi + 1] = src[3*pi + 1];
+    dst[4*pi + 2] = src[3*pi + 2];
+    dst[4*pi + 3] = 65535;
+  }
+  return;
+}
+
+void spotConvert16To8(unsigned char *dst, const unsigned short *src,
+                      size_t num) {
+  size_t ii;
+  unsigned int tt;
+
+  /* round(x/257) is (t - (t >> 8)) >> 8 with t = x + 128, which is exact
+     for every x, even with the sum saturating at 65535 */
+  ii = 0;
+#ifdef __SSE2__
+  {
+    __m128i half = _mm_set1_epi16(128), vv;
+    for (; ii+8<=num; ii+=8) {
+      vv = _mm_adds_epu16(_mm_loadu_si128((const __m128i *)(src + ii)), half);
+      vv = _mm_srli_epi16(_mm_sub_epi16(vv, _mm_srli_epi16(vv, 8)), 8);
+      _mm_storel_epi64((__m128i *)(dst + ii), _mm_packus_epi16(vv, vv));
+    }
+  }
+#endif
+  for (; ii<num; ii++) {
+    tt = SPOT_MIN(src[ii] + 128u, 65535u);
+    dst[ii] = (unsigned char)((tt - (tt >> 8)) >> 8);
+  }
+  return;
+}
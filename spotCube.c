@@ -0,0 +1,696 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+/*
+** The prefiltered cache.  The smaller levels made for "foo.png" are stored
+** in "foo.png.ggx" (or .phong), which starts with CUBE_MAGIC, then a hash
+** of the PNG file's bytes (or those of all six face files, with the cache
+** named after the first), the lobe and CUBE_SAMPLE_NUM (so that an edited
+** PNG is filtered again), the lobe, face size and number of levels,
+** followed by the RGB pixels of levels 1 and up, each with its six faces
+** stacked as in the PNG.  Change CUBE_MAGIC whenever the filtering changes
+** what it produces.
+*/
+#define CUBE_MAGIC "SPOTCUB1"
+
+/* directions sampled for each texel of each level */
+#define CUBE_SAMPLE_NUM 64
+
+/* more levels than any cube map could have */
+#define CUBE_LEVEL_MAX 32
+
+/*
+** _spotCubeSample: one of the directions sampled around each texel; these
+** are the same for every texel of a level, up to rotation
+*/
+typedef struct {
+  float ll[3],           /* the direction, in a frame with the lobe axis
+                            (the texel's direction) as z */
+    weight,              /* how much it counts (zero if below the horizon) */
+    lod;                 /* the source level to read it from: coarser when
+                            its probability is lower, so that the few
+                            samples together cover the whole lobe */
+} _spotCubeSample;
+
+/*
+** _spotCubeJob: what the threads making one level (via spotParallel) share
+*/
+typedef struct {
+  float *src[CUBE_LEVEL_MAX];   /* the original cube map in linear RGB, and
+                                   its box-filtered halvings, six faces
+                                   stacked in each */
+  unsigned int srcSize[CUBE_LEVEL_MAX], /* face size of each src */
+    srcNum;                     /* number of src */
+  _spotCubeSample smp[CUBE_SAMPLE_NUM];
+  unsigned int size;            /* face size of the level being made */
+  unsigned char *out;           /* its sRGB pixels */
+} _spotCubeJob;
+
+/*
+** _spotCubeSHJob: what the threads projecting one cube map onto spherical
+** harmonics (via spotParallel) share.  Each row of each face gets its own
+** sums, which are added up (in order) afterwards, so that the result
+** doesn't depend on how the rows were split among threads
+*/
+typedef struct {
+  const unsigned char *pixels;  /* 8-bit sRGB faces, stacked */
+  unsigned int size;            /* face size */
+  float lin[256];               /* sRGB to linear */
+  double *rowSum;               /* per row, 9 basis functions times RGB */
+} _spotCubeSHJob;
+
+static float _spotCubeToLinear(float vv) {
+  return (vv <= 0.04045f
+          ? vv/12.92f
+          : powf((vv + 0.055f)/1.055f, 2.4f));
+}
+
+static unsigned char _spotCubeToSRGB(float vv) {
+  vv = SPOT_CLAMP(0.0f, vv, 1.0f);
+  vv = (vv <= 0.0031308f
+        ? vv*12.92f
+        : 1.055f*powf(vv, 1.0f/2.4f) - 0.055f);
+  return (unsigned char)(255*vv + 0.5f);
+}
+
+/* for each face (in the +X,-X,+Y,-Y,+Z,-Z order of the GL targets), the
+   vectors S, U, V such that S + sc*U + tc*V is the (unnormalized) direction
+   through texel coordinates (sc,tc), in [-1,1], as in table 3.21 (Selection
+   of cube map images) of the GL 3.2 spec */
+static const float _spotCubeAxes[6][3][3] = {
+  {{ 1, 0, 0}, { 0, 0,-1}, { 0,-1, 0}},
+  {{-1, 0, 0}, { 0, 0, 1}, { 0,-1, 0}},
+  {{ 0, 1, 0}, { 1, 0, 0}, { 0, 0, 1}},
+  {{ 0,-1, 0}, { 1, 0, 0}, { 0, 0,-1}},
+  {{ 0, 0, 1}, { 1, 0, 0}, { 0,-1, 0}},
+  {{ 0, 0,-1}, {-1, 0, 0}, { 0,-1, 0}}};
+
+/* the unit direction through texel coordinates (sc,tc) of face fi */
+static void _spotCubeDir(float dir[3], unsigned int fi, float sc, float tc) {
+  const float (*axes)[3] = _spotCubeAxes[fi];
+  float len;
+
+  SPOT_V3_COPY(dir, axes[0]);
+  SPOT_V3_SCALE_INCR(dir, sc, axes[1]);
+  SPOT_V3_SCALE_INCR(dir, tc, axes[2]);
+  SPOT_V3_NORM(dir, dir, len);
+  return;
+}
+
+/* the 8-bit RGB faces of level 0 of cube map img, stacked as in the PNG:
+   img->data itself if it has them, or else (to be freed by the caller)
+   read back from img->textureId, which must be bound.  The faces may only
+   be on the GPU, as when they were decoded straight into a pixel buffer */
+static unsigned char *_spotCubePixels(const spotImage *img) {
+  unsigned char *pixels;
+  unsigned int size, fi;
+
+  if (img->data.v && 1 == img->sizeC) {
+    return img->data.uc;
+  }
+  size = img->sizeX;
+  if ((pixels = (unsigned char *)malloc((size_t)18*size*size))) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (fi=0; fi<6; fi++) {
+      glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + fi, 0, GL_RGB,
+                    GL_UNSIGNED_BYTE, pixels + (size_t)3*size*size*fi);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  }
+  return pixels;
+}
+
+/* bilinearly interpolated color (in rgb) of level lev (with face size
+   size) along dir; the interpolation stops at the edge of the face that
+   dir hits, rather than reaching into the next */
+static void _spotCubeFetch(float rgb[3], const float *lev, unsigned int size,
+                           const float dir[3]) {
+  float ax, ay, az, ma, sc, tc, px, py, fx, fy;
+  unsigned int fi, ci, x0, x1, y0, y1;
+  const float *face, *p00, *p10, *p01, *p11;
+
+  ax = fabsf(dir[0]); ay = fabsf(dir[1]); az = fabsf(dir[2]);
+  if (ax >= ay && ax >= az) {
+    fi = dir[0] > 0 ? 0 : 1;
+    ma = ax; sc = dir[0] > 0 ? -dir[2] : dir[2]; tc = -dir[1];
+  } else if (ay >= az) {
+    fi = dir[1] > 0 ? 2 : 3;
+    ma = ay; sc = dir[0]; tc = dir[1] > 0 ? dir[2] : -dir[2];
+  } else {
+    fi = dir[2] > 0 ? 4 : 5;
+    ma = az; sc = dir[2] > 0 ? dir[0] : -dir[0]; tc = -dir[1];
+  }
+  px = (sc/ma + 1)*0.5f*size - 0.5f;
+  py = (tc/ma + 1)*0.5f*size - 0.5f;
+  px = SPOT_CLAMP(0.0f, px, size - 1.0f);
+  py = SPOT_CLAMP(0.0f, py, size - 1.0f);
+  x0 = (unsigned int)px; x1 = SPOT_MIN(x0 + 1, size - 1); fx = px - x0;
+  y0 = (unsigned int)py; y1 = SPOT_MIN(y0 + 1, size - 1); fy = py - y0;
+  face = lev + 3*(size_t)size*size*fi;
+  p00 = face + 3*(x0 + (size_t)size*y0);
+  p10 = face + 3*(x1 + (size_t)size*y0);
+  p01 = face + 3*(x0 + (size_t)size*y1);
+  p11 = face + 3*(x1 + (size_t)size*y1);
+  for (ci=0; ci<3; ci++) {
+    rgb[ci] = ((1 - fy)*((1 - fx)*p00[ci] + fx*p10[ci])
+               + fy*((1 - fx)*p01[ci] + fx*p11[ci]));
+  }
+  return;
+}
+
+/* sets the job's samples for the given lobe and roughness (in (0,1]);
+   the roughness is squared (as is usual) to get the GGX alpha, and the
+   Phong exponent is the one whose lobe is about as wide as that GGX's */
+static void _spotCubeSamplesSet(_spotCubeJob *job, int lobe, float rough) {
+  float alpha2, shexp, cosT, sinT, phi, pdf, dd, saTexel, saSample;
+  unsigned int si, bits;
+  _spotCubeSample *smp;
+
+  alpha2 = rough*rough*rough*rough;
+  shexp = 2/alpha2 - 2;
+  saTexel = 4*(float)M_PI/(6.0f*job->srcSize[0]*job->srcSize[0]);
+  for (si=0; si<CUBE_SAMPLE_NUM; si++) {
+    smp = job->smp + si;
+    /* Hammersley point (si+0.5)/N, radical inverse (base 2) of si */
+    bits = si;
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+    bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+    bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+    bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+    phi = 2*(float)M_PI*(bits*2.3283064365386963e-10f);
+    dd = (si + 0.5f)/CUBE_SAMPLE_NUM;
+    if (spotCubeLobeGGX == lobe) {
+      /* the sample is a half vector H, with the view and normal both
+         along the lobe axis, so the light direction L is reflected about
+         it: L.z = 2*H.z^2 - 1, and pdf(L) = D(H)*H.z/(4*V.H) = D(H)/4 */
+      cosT = sqrtf((1 - dd)/(1 + (alpha2 - 1)*dd));
+      sinT = sqrtf(1 - cosT*cosT);
+      SPOT_V3_SET(smp->ll, 2*cosT*sinT*cosf(phi), 2*cosT*sinT*sinf(phi),
+                  2*cosT*cosT - 1);
+      dd = (alpha2 - 1)*cosT*cosT + 1;
+      pdf = alpha2/((float)M_PI*dd*dd)/4;
+      smp->weight = SPOT_MAX(smp->ll[2], 0.0f);
+    } else {
+      /* the sample is L itself, distributed as cos^shexp about the lobe
+         axis, so the samples are simply averaged */
+      cosT = powf(dd, 1/(shexp + 1));
+      sinT = sqrtf(1 - cosT*cosT);
+      SPOT_V3_SET(smp->ll, sinT*cosf(phi), sinT*sinf(phi), cosT);
+      pdf = (shexp + 1)*powf(cosT, shexp)/(2*(float)M_PI);
+      smp->weight = 1;
+    }
+    /* the source level whose texels subtend the sample's share of the
+       sphere (with one more level for some overlap between samples) */
+    saSample = 1/(CUBE_SAMPLE_NUM*pdf + 0.0001f);
+    smp->lod = 0.5f*log2f(saSample/saTexel) + 1;
+    smp->lod = SPOT_CLAMP(0.0f, smp->lod, job->srcNum - 1.0f);
+  }
+  return;
+}
+
+/*
+** _spotCubeRows: makes rows [row0,row1) of the job's level, with the rows
+** of all six faces numbered consecutively
+*/
+static void _spotCubeRows(void *_job, unsigned int row0, unsigned int row1) {
+  _spotCubeJob *job = (_spotCubeJob *)_job;
+  unsigned int ri, xi, si, size, l0, l1;
+  float nn[3], tt[3], bb[3], up[3], ll[3], rgb[3], rgb1[3], sum[4], len, frac;
+  const _spotCubeSample *smp;
+  unsigned char *out;
+
+  size = job->size;
+  for (ri=row0; ri<row1; ri++) {
+    for (xi=0; xi<size; xi++) {
+      _spotCubeDir(nn, ri/size, 2*(xi + 0.5f)/size - 1,
+                   2*(ri % size + 0.5f)/size - 1);
+      if (fabsf(nn[2]) < 0.999f) {
+        SPOT_V3_SET(up, 0, 0, 1);
+      } else {
+        SPOT_V3_SET(up, 1, 0, 0);
+      }
+      SPOT_V3_CROSS(tt, up, nn);
+      SPOT_V3_NORM(tt, tt, len);
+      SPOT_V3_CROSS(bb, nn, tt);
+      SPOT_V4_SET(sum, 0, 0, 0, 0);
+      for (si=0; si<CUBE_SAMPLE_NUM; si++) {
+        smp = job->smp + si;
+        if (!smp->weight) {
+          continue;
+        }
+        SPOT_V3_SCALE(ll, smp->ll[2], nn);
+        SPOT_V3_SCALE_INCR(ll, smp->ll[0], tt);
+        SPOT_V3_SCALE_INCR(ll, smp->ll[1], bb);
+        l0 = (unsigned int)smp->lod;
+        l1 = SPOT_MIN(l0 + 1, job->srcNum - 1);
+        frac = smp->lod - l0;
+        _spotCubeFetch(rgb, job->src[l0], job->srcSize[l0], ll);
+        if (frac) {
+          _spotCubeFetch(rgb1, job->src[l1], job->srcSize[l1], ll);
+          SPOT_V3_SCALE(rgb, 1 - frac, rgb);
+          SPOT_V3_SCALE_INCR(rgb, frac, rgb1);
+        }
+        SPOT_V3_SCALE_INCR(sum, smp->weight, rgb);
+        sum[3] += smp->weight;
+      }
+      out = job->out + 3*(xi + (size_t)size*ri);
+      out[0] = _spotCubeToSRGB(sum[0]/sum[3]);
+      out[1] = _spotCubeToSRGB(sum[1]/sum[3]);
+      out[2] = _spotCubeToSRGB(sum[2]/sum[3]);
+    }
+  }
+  return;
+}
+
+/* sets up the job's src levels from the sRGB pixels of the original */
+static int _spotCubeSrcSet(_spotCubeJob *job, const unsigned char *pixels,
+                           unsigned int size, unsigned int levelNum) {
+  unsigned int li, fi, xi, yi, ci, ii, inSize, xx[2], yy[2];
+  float lin[256], *in, *out;
+
+  for (ii=0; ii<256; ii++) {
+    lin[ii] = _spotCubeToLinear(ii/255.0f);
+  }
+  job->srcNum = levelNum;
+  for (li=0; li<levelNum; li++) {
+    job->srcSize[li] = SPOT_MAX(size >> li, 1);
+    if (!( job->src[li] = (float *)malloc(sizeof(float)*18*job->srcSize[li]
+                                          *job->srcSize[li]) )) {
+      return 1;
+    }
+  }
+  for (ii=0; ii<18*size*size; ii++) {
+    job->src[0][ii] = lin[pixels[ii]];
+  }
+  for (li=1; li<levelNum; li++) {
+    inSize = job->srcSize[li-1];
+    size = job->srcSize[li];
+    for (fi=0; fi<6; fi++) {
+      in = job->src[li-1] + 3*(size_t)inSize*inSize*fi;
+      out = job->src[li] + 3*(size_t)size*size*fi;
+      for (yi=0; yi<size; yi++) {
+        yy[0] = 2*yi; yy[1] = SPOT_MIN(2*yi + 1, inSize - 1);
+        for (xi=0; xi<size; xi++) {
+          xx[0] = 2*xi; xx[1] = SPOT_MIN(2*xi + 1, inSize - 1);
+          for (ci=0; ci<3; ci++) {
+            out[ci + 3*(xi + size*yi)] = 0.25f*(in[ci + 3*(xx[0] + inSize*yy[0])]
+                                                + in[ci + 3*(xx[1] + inSize*yy[0])]
+                                                + in[ci + 3*(xx[0] + inSize*yy[1])]
+                                                + in[ci + 3*(xx[1] + inSize*yy[1])]);
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+static char *_spotCubeCachePath(const char *fname, int lobe) {
+  char *path;
+
+  if ((path = (char *)malloc(strlen(fname) + strlen(".phong") + 1))) {
+    sprintf(path, "%s.%s", fname, spotCubeLobeGGX == lobe ? "ggx" : "phong");
+  }
+  return path;
+}
+
+/* reads the cached levels (of total size len) from path, returning 1 if
+   that worked, or 0 if there aren't any current ones (which is not an
+   error); head is the lobe, face size and number of levels */
+static int _spotCubeCacheLoad(unsigned char *levels, size_t len,
+                              const unsigned int head[3], const char *path,
+                              unsigned long long hash) {
+  char magic[sizeof(CUBE_MAGIC)-1];
+  unsigned long long fhash;
+  unsigned int fhead[3];
+  FILE *file;
+  int ret;
+
+  if (!(file = fopen(path, "rb"))) {
+    return 0;
+  }
+  ret = (1 == fread(magic, sizeof(magic), 1, file)
+         && !memcmp(magic, CUBE_MAGIC, sizeof(magic))
+         && 1 == fread(&fhash, sizeof(fhash), 1, file) && fhash == hash
+         && 1 == fread(fhead, sizeof(fhead), 1, file)
+         && !memcmp(fhead, head, sizeof(fhead))
+         && 1 == fread(levels, len, 1, file));
+  fclose(file);
+  return ret;
+}
+
+/* saves the levels to the cache; failing to do so only costs filtering
+   them again next time, so it is noted on stderr but not an error */
+static void _spotCubeCacheSave(const unsigned char *levels, size_t len,
+                               const unsigned int head[3], const char *path,
+                               unsigned long long hash) {
+  const char me[]="spotImageCubeMapMipGLInit";
+  char *tmpPath;
+  FILE *file;
+  int bad;
+
+  if (!(tmpPath = (char *)malloc(strlen(path) + strlen(".tmp") + 1))) {
+    return;
+  }
+  /* written under another name and then renamed, so that another process
+     starting up at the same time never sees half a file */
+  sprintf(tmpPath, "%s.tmp", path);
+  bad = 1;
+  if ((file = fopen(tmpPath, "wb"))) {
+    bad = !( 1 == fwrite(CUBE_MAGIC, sizeof(CUBE_MAGIC)-1, 1, file)
+             && 1 == fwrite(&hash, sizeof(hash), 1, file)
+             && 1 == fwrite(head, 3*sizeof(unsigned int), 1, file)
+             && 1 == fwrite(levels, len, 1, file) );
+    bad |= !!fclose(file);
+    bad = bad || rename(tmpPath, path);
+  }
+  if (bad) {
+    fprintf(stderr, "%s: couldn't save levels to \"%s\"\n", me, path);
+    remove(tmpPath);
+  }
+  free(tmpPath);
+}
+
+/* makes levels 1 and up (stored one after the other in levels) from the
+   size-by-size faces of level 0 in pixels */
+static int _spotCubeFilter(unsigned char *levels, const unsigned char *pixels,
+                           unsigned int size, unsigned int levelNum, int lobe) {
+  _spotCubeJob job;
+  unsigned int li;
+  int ret;
+
+  memset(&job, 0, sizeof(job));
+  ret = _spotCubeSrcSet(&job, pixels, size, levelNum);
+  for (li=1; !ret && li<levelNum; li++) {
+    job.size = job.srcSize[li];
+    job.out = levels;
+    _spotCubeSamplesSet(&job, lobe, (float)li/(levelNum - 1));
+    /* each sample is a couple of bilinear fetches, about 40 operations */
+    spotParallel(_spotCubeRows, &job, 6*job.size,
+                 (size_t)6*job.size*job.size*CUBE_SAMPLE_NUM*40);
+    levels += (size_t)18*job.size*job.size;
+  }
+  for (li=0; li<CUBE_LEVEL_MAX; li++) {
+    free(job.src[li]);
+  }
+  return ret;
+}
+
+int spotImageCubeMapMipGLInit(spotImage *img, const char *const *fname,
+                              unsigned int fnameNum, int lobe) {
+  const char me[]="spotImageCubeMapMipGLInit";
+  unsigned int size, levelNum, li, fi, head[3];
+  unsigned long long hash;
+  unsigned char *levels, *lev, *pixels, *blocks;
+  size_t len, faceLen;
+  char *path;
+  int hashed, ret;
+
+  if (!img) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  if (!img->textureId) {
+    spotErrorAdd("%s: image has no texture (from spotImageCubeMapGLInit)", me);
+    return 1;
+  }
+  if (!( spotCubeLobeGGX == lobe || spotCubeLobePhong == lobe )) {
+    spotErrorAdd("%s: lobe %d not valid", me, lobe);
+    return 1;
+  }
+  size = img->sizeX;
+  for (levelNum=1; size >> levelNum; levelNum++);
+  if (1 == levelNum) {
+    /* nothing to make */
+    return 0;
+  }
+  len = 0;
+  for (li=1; li<levelNum; li++) {
+    len += (size_t)18*(size >> li)*(size >> li);
+  }
+  if (!( levels = (unsigned char *)malloc(len) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    return 1;
+  }
+  head[0] = (unsigned int)lobe;
+  head[1] = size;
+  head[2] = levelNum;
+  path = NULL;
+  hash = SPOT_HASH_START;
+  hashed = fname && fnameNum;
+  for (li=0; hashed && li<fnameNum; li++) {
+    hashed = !spotHashFile(&hash, fname[li]);
+  }
+  if (hashed && (hashed = !!(path = _spotCubeCachePath(fname[0], lobe)))) {
+    li = CUBE_SAMPLE_NUM;
+    hash = spotHash(hash, &lobe, sizeof(lobe));
+    hash = spotHash(hash, &li, sizeof(li));
+  }
+  glBindTexture(GL_TEXTURE_CUBE_MAP, img->textureId);
+  if (!( hashed && _spotCubeCacheLoad(levels, len, head, path, hash) )) {
+    pixels = _spotCubePixels(img);
+    ret = !pixels || _spotCubeFilter(levels, pixels, size, levelNum, lobe);
+    if (pixels != img->data.uc) {
+      free(pixels);
+    }
+    if (ret) {
+      spotErrorAdd("%s: allocation failure", me);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+      free(levels); free(path);
+      return 1;
+    }
+    if (hashed) {
+      _spotCubeCacheSave(levels, len, head, path, hash);
+    }
+  }
+  free(path);
+
+  blocks = NULL;
+  if (img->bcFormat
+      && !( blocks = (unsigned char *)malloc(spotBCSize(img->bcFormat,
+                                                        size/2, size/2)) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    free(levels);
+    return 1;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  lev = levels;
+  for (li=1; li<levelNum; li++) {
+    size = img->sizeX >> li;
+    faceLen = (size_t)3*size*size;
+    for (fi=0; fi<6; fi++) {
+      if (blocks) {
+        spotBCEncode(blocks, img->bcFormat, lev + faceLen*fi, 3, size, size);
+        glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + fi, li,
+                               spotBCGLFormat(img->bcFormat), size, size, 0,
+                               (GLsizei)spotBCSize(img->bcFormat, size, size),
+                               blocks);
+      } else {
+        /* in the format of level 0, even if that is 16-bit */
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + fi, li,
+                     spotImageGLInternalFormat(img), size, size, 0, GL_RGB,
+                     GL_UNSIGNED_BYTE, lev + faceLen*fi);
+      }
+    }
+    lev += 6*faceLen;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levelNum - 1);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  free(blocks);
+  free(levels);
+  return 0;
+}
+
+/*
+** _spotCubeSHRows: sums rows [row0,row1) of the job's faces (numbered as in
+** _spotCubeRows) against the polynomial parts of the 9 spherical harmonics
+** up to order 2: 1, y, z, x, xy, yz, 3z^2-1, xz, x^2-y^2.  Each texel is
+** weighted by its solid angle, which (up to the texel area) is 1/r^3 for
+** the distance r from the center of the cube to the texel
+*/
+static void _spotCubeSHRows(void *_job, unsigned int row0, unsigned int row1) {
+  _spotCubeSHJob *job = (_spotCubeSHJob *)_job;
+  unsigned int ri, xi, ci, size;
+  const float (*axes)[3];
+  const unsigned char *pp;
+  float sc, tc, inv, ww, nn[3], dir[3], rgb[3], basis[9];
+  double *sum;
+#ifdef __SSE2__
+  __m128 acc[27], one, vsc, vinv, vw, vx, vy, vz, vb[9], vc[3];
+  float tmp[3][4];
+  unsigned int bi, pi;
+#endif
+
+  size = job->size;
+  for (ri=row0; ri<row1; ri++) {
+    axes = _spotCubeAxes[ri/size];
+    tc = 2*(ri % size + 0.5f)/size - 1;
+    pp = job->pixels + 3*(size_t)size*ri;
+    sum = job->rowSum + 27*(size_t)ri;
+    memset(sum, 0, 27*sizeof(double));
+    xi = 0;
+#ifdef __SSE2__
+    /* four texels of the row at a time */
+    one = _mm_set1_ps(1.0f);
+    for (bi=0; bi<27; bi++) {
+      acc[bi] = _mm_setzero_ps();
+    }
+    for (; xi + 4 <= size; xi += 4) {
+      vsc = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(xi + 0.5f),
+                                             _mm_set_ps(3, 2, 1, 0)),
+                                  _mm_set1_ps(2.0f/size)), one);
+      vinv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_set1_ps(1 + tc*tc),
+                                                    _mm_mul_ps(vsc, vsc))));
+      vw = _mm_mul_ps(vinv, _mm_mul_ps(vinv, vinv));
+      vx = _mm_mul_ps(vinv, _mm_add_ps(_mm_set1_ps(axes[0][0] + tc*axes[2][0]),
+                                       _mm_mul_ps(vsc, _mm_set1_ps(axes[1][0]))));
+      vy = _mm_mul_ps(vinv, _mm_add_ps(_mm_set1_ps(axes[0][1] + tc*axes[2][1]),
+                                       _mm_mul_ps(vsc, _mm_set1_ps(axes[1][1]))));
+      vz = _mm_mul_ps(vinv, _mm_add_ps(_mm_set1_ps(axes[0][2] + tc*axes[2][2]),
+                                       _mm_mul_ps(vsc, _mm_set1_ps(axes[1][2]))));
+      for (pi=0; pi<4; pi++) {
+        for (ci=0; ci<3; ci++) {
+          tmp[ci][pi] = job->lin[pp[ci + 3*(xi + pi)]];
+        }
+      }
+      for (ci=0; ci<3; ci++) {
+        vc[ci] = _mm_mul_ps(vw, _mm_loadu_ps(tmp[ci]));
+      }
+      vb[0] = one;
+      vb[1] = vy;
+      vb[2] = vz;
+      vb[3] = vx;
+      vb[4] = _mm_mul_ps(vx, vy);
+      vb[5] = _mm_mul_ps(vy, vz);
+      vb[6] = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(vz, vz)), one);
+      vb[7] = _mm_mul_ps(vx, vz);
+      vb[8] = _mm_sub_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+      for (bi=0; bi<9; bi++) {
+        for (ci=0; ci<3; ci++) {
+          acc[ci + 3*bi] = _mm_add_ps(acc[ci + 3*bi], _mm_mul_ps(vb[bi], vc[ci]));
+        }
+      }
+    }
+    for (bi=0; bi<27; bi++) {
+      _mm_storeu_ps(tmp[0], acc[bi]);
+      sum[bi] = (double)tmp[0][0] + tmp[0][1] + tmp[0][2] + tmp[0][3];
+    }
+#endif
+    /* the rest of the row (or all of it, without SSE2) */
+    for (; xi<size; xi++) {
+      sc = 2*(xi + 0.5f)/size - 1;
+      SPOT_V3_COPY(dir, axes[0]);
+      SPOT_V3_SCALE_INCR(dir, sc, axes[1]);
+      SPOT_V3_SCALE_INCR(dir, tc, axes[2]);
+      inv = 1/sqrtf(1 + sc*sc + tc*tc);
+      ww = inv*inv*inv;
+      SPOT_V3_SCALE(nn, inv, dir);
+      basis[0] = 1;
+      basis[1] = nn[1];
+      basis[2] = nn[2];
+      basis[3] = nn[0];
+      basis[4] = nn[0]*nn[1];
+      basis[5] = nn[1]*nn[2];
+      basis[6] = 3*nn[2]*nn[2] - 1;
+      basis[7] = nn[0]*nn[2];
+      basis[8] = nn[0]*nn[0] - nn[1]*nn[1];
+      for (ci=0; ci<3; ci++) {
+        rgb[ci] = ww*job->lin[pp[ci + 3*xi]];
+      }
+      for (ci=0; ci<27; ci++) {
+        sum[ci] += basis[ci/3]*rgb[ci % 3];
+      }
+    }
+  }
+  return;
+}
+
+int spotImageCubeMapSH(GLfloat sh[9][4], spotImage *img) {
+  const char me[]="spotImageCubeMapSH";
+  /* for each coefficient: the square of the constant of its spherical
+     harmonic (whose polynomial part is in _spotCubeSHRows), times the
+     factor (over pi) by which convolution with the clamped cosine scales
+     its order: 1, 2/3, 1/4 (Ramamoorthi and Hanrahan 2001) */
+  static const double scale[9] = {
+    0.282095*0.282095,
+    0.488603*0.488603*2/3, 0.488603*0.488603*2/3, 0.488603*0.488603*2/3,
+    1.092548*1.092548/4, 1.092548*1.092548/4, 0.315392*0.315392/4,
+    1.092548*1.092548/4, 0.546274*0.546274/4};
+  _spotCubeSHJob job;
+  unsigned char *pixels;
+  unsigned int ii, ri, size;
+  double total[27], area;
+
+  if (!( sh && img )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)sh, (void*)img);
+    return 1;
+  }
+  size = img->sizeX;
+  if (!( size && img->sizeY == 6*size && (img->textureId || img->data.v) )) {
+    spotErrorAdd("%s: image (%u x %u) isn't a cube map", me, img->sizeX,
+                 img->sizeY);
+    return 1;
+  }
+  if (img->textureId) {
+    glBindTexture(GL_TEXTURE_CUBE_MAP, img->textureId);
+  }
+  pixels = _spotCubePixels(img);
+  if (img->textureId) {
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  }
+  if (!( pixels && (job.rowSum = (double *)malloc(27*sizeof(double)*6*size)) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    if (pixels != img->data.uc) {
+      free(pixels);
+    }
+    return 1;
+  }
+  job.pixels = pixels;
+  job.size = size;
+  for (ii=0; ii<256; ii++) {
+    job.lin[ii] = _spotCubeToLinear(ii/255.0f);
+  }
+  /* about 70 operations per texel */
+  spotParallel(_spotCubeSHRows, &job, 6*size, (size_t)6*size*size*70);
+  memset(total, 0, sizeof(total));
+  for (ri=0; ri<6*size; ri++) {
+    for (ii=0; ii<27; ii++) {
+      total[ii] += job.rowSum[ii + 27*ri];
+    }
+  }
+  /* the area of a texel, on a face 2 units across */
+  area = 4.0/((double)size*size);
+  for (ii=0; ii<9; ii++) {
+    sh[ii][0] = (GLfloat)(scale[ii]*area*total[0 + 3*ii]);
+    sh[ii][1] = (GLfloat)(scale[ii]*area*total[1 + 3*ii]);
+    sh[ii][2] = (GLfloat)(scale[ii]*area*total[2 + 3*ii]);
+    sh[ii][3] = 0;
+  }
+  free(job.rowSum);
+  if (pixels != img->data.uc) {
+    free(pixels);
+  }
+  return 0;
+}
@@ -14,6 +14,129 @@
 
 #include "spot.h"
 
+spotGeom *spotGeomNewIn(spotArena *arena, unsigned int vertNum,
+                        unsigned int indxNum, unsigned int primNum) {
+  const char me[]="spotGeomNewIn";
+  size_t vec3Size, vec2Size, indxSize, ptypeSize, icntSize, size;
+  unsigned int ii;
+  spotGeom *sgeom;
+  char *mem;
+
+  /* struct first, then each array, each starting on a SPOT_ALIGN boundary */
+  vec3Size = SPOT_ALIGN_UP(vertNum*3*sizeof(GLfloat));
+  vec2Size = SPOT_ALIGN_UP(vertNum*2*sizeof(GLfloat));
+  indxSize = SPOT_ALIGN_UP(indxNum*sizeof(GLushort));
+  ptypeSize = SPOT_ALIGN_UP(primNum*sizeof(GLenum));
+  icntSize = SPOT_ALIGN_UP(primNum*sizeof(unsigned int));
+  size = (SPOT_ALIGN_UP(sizeof(spotGeom))
+          + 4*vec3Size + vec2Size + indxSize + ptypeSize + icntSize);
+  if (arena) {
+    mem = (char *)spotArenaAlloc(arena, size);
+  } else if (posix_memalign((void **)&mem, SPOT_ALIGN, size)) {
+    mem = NULL;
+  }
+  if (!mem) {
+    spotErrorAdd("%s: couldn't allocate %lu bytes for %u verts", me,
+                 (unsigned long)size, vertNum);
+    return NULL;
+  }
+  /* zeroing covers the GPU state, and the padding between arrays */
+  memset(mem, 0, size);
+  sgeom = (spotGeom *)mem;
+  mem += SPOT_ALIGN_UP(sizeof(spotGeom));
+  sgeom->alloc = arena ? spotGeomAllocArena : spotGeomAllocBlock;
+  sgeom->xyz = (GLfloat *)mem;   mem += vec3Size;
+  sgeom->rgb = (GLfloat *)mem;   mem += vec3Size;
+  sgeom->norm = (GLfloat *)mem;  mem += vec3Size;
+  sgeom->tex2 = (GLfloat *)mem;  mem += vec2Size;
+  sgeom->tang = (GLfloat *)mem;  mem += vec3Size;
+  sgeom->indx = (GLushort *)mem; mem += indxSize;
+  sgeom->ptype = (GLenum *)mem;  mem += ptypeSize;
+  sgeom->icnt = (unsigned int *)mem;
+  sgeom->vertNum = vertNum;
+  sgeom->indxNum = indxNum;
+  sgeom->primNum = primNum;
+  for (ii=0; ii<vertNum; ii++) {
+    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  }
+  SPOT_V3_SET(sgeom->objColor, 1.0f, 1.0f, 1.0f);
+  sgeom->Ka = 1.0f;
+  sgeom->Kd = 0.0f;
+  sgeom->Ks = 0.0f;
+  sgeom->shexp = 100.0f;
+  SPOT_M4_IDENTITY(sgeom->modelMatrix);
+  SPOT_M3_IDENTITY(sgeom->normalMatrix);
+  return sgeom;
+}
+
+spotGeom *spotGeomNew(unsigned int vertNum, unsigned int indxNum,
+                      unsigned int primNum) {
+
+  return spotGeomNewIn(NULL, vertNum, indxNum, primNum);
+}
+
+/*
+** _spotGeomAttr: looks up the CPU array, number of components, and static
+** buffer of the attribute with the given spotVertAttrIndx_* index
+*/
+static GLfloat *_spotGeomAttr(spotGeom *sgeom, unsigned int ai,
+                              unsigned int *comp, GLuint *buffId) {
+  GLfloat *ret;
+
+  switch (ai) {
+  case spotVertAttrIndx_xyz:
+    ret = sgeom->xyz; *comp = 3; *buffId = sgeom->xyzBuffId; break;
+  case spotVertAttrIndx_rgb:
+    ret = sgeom->rgb; *comp = 3; *buffId = sgeom->rgbBuffId; break;
+  case spotVertAttrIndx_norm:
+    ret = sgeom->norm; *comp = 3; *buffId = sgeom->normBuffId; break;
+  case spotVertAttrIndx_tex2:
+    ret = sgeom->tex2; *comp = 2; *buffId = sgeom->tex2BuffId; break;
+  case spotVertAttrIndx_tang:
+    ret = sgeom->tang; *comp = 3; *buffId = sgeom->tangBuffId; break;
+  default:
+    ret = NULL; *comp = 0; *buffId = 0; break;
+  }
+  return ret;
+}
+
+/*
+** _spotGeomAttrPoint: points attribute ai of the bound VAO at wherever its
+** data currently is: the spotStream if it's in streamBound, else its
+** static buffer
+*/
+static void _spotGeomAttrPoint(spotGeom *sgeom, unsigned int ai) {
+  unsigned int comp;
+  GLuint buffId;
+
+  _spotGeomAttr(sgeom, ai, &comp, &buffId);
+  if (sgeom->streamBound & (1u << ai)) {
+    glBindBuffer(GL_ARRAY_BUFFER, sgeom->streamBuffId);
+    glVertexAttribPointer(ai, comp, GL_FLOAT, GL_FALSE, 0,
+                          (void*)sgeom->streamOffset[ai]);
+  } else {
+    glBindBuffer(GL_ARRAY_BUFFER, buffId);
+    glVertexAttribPointer(ai, comp, GL_FLOAT, GL_FALSE, 0, 0);
+  }
+}
+
+/*
+** _spotGeomHave: the mask of attributes that sgeom has data for, which are
+** the ones enabled in its vaoId
+*/
+static unsigned int _spotGeomHave(spotGeom *sgeom) {
+  unsigned int ai, comp, ret;
+  GLuint buffId;
+
+  ret = 0;
+  for (ai=spotVertAttrIndx_xyz; ai<=spotVertAttrIndx_tang; ai++) {
+    if (_spotGeomAttr(sgeom, ai, &comp, &buffId)) {
+      ret |= 1u << ai;
+    }
+  }
+  return ret;
+}
+
 int spotGeomGLInit(spotGeom *sgeom) {
 
   /* Create an uninitialized vertex array object */
@@ -76,14 +199,30 @@ int spotGeomGLInit(spotGeom *sgeom) {
   
   /* Unbind from vao */
   glBindVertexArray(0);
+  /* vaoId is the VAO for all the attributes there are */
+  sgeom->vaoMaskId[_spotGeomHave(sgeom)] = sgeom->vaoId;
   return 0;
 }
 
-int spotGeomDraw(spotGeom *sgeom) {
-  /* const char me[]="spotGeomDraw"; */
-  unsigned int pi, idx;
+int spotGeomDrawMask(spotGeom *sgeom, unsigned int attrMask) {
+  /* const char me[]="spotGeomDrawMask"; */
+  unsigned int pi, idx, ai;
+  GLuint vaoId;
 
-  glBindVertexArray(sgeom->vaoId);
+  attrMask &= _spotGeomHave(sgeom);
+  if (!( vaoId = sgeom->vaoMaskId[attrMask] )) {
+    glGenVertexArrays(1, &vaoId);
+    glBindVertexArray(vaoId);
+    for (ai=spotVertAttrIndx_xyz; ai<=spotVertAttrIndx_tang; ai++) {
+      if (attrMask & (1u << ai)) {
+        _spotGeomAttrPoint(sgeom, ai);
+        glEnableVertexAttribArray(ai);
+      }
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sgeom->indxBuffId);
+    sgeom->vaoMaskId[attrMask] = vaoId;
+  }
+  glBindVertexArray(vaoId);
   idx = 0;
   for (pi=0; pi<sgeom->primNum; pi++) {
     glDrawElements(sgeom->ptype[pi], sgeom->icnt[pi], GL_UNSIGNED_SHORT,
@@ -97,8 +236,118 @@ int spotGeomDraw(spotGeom *sgeom) {
   return 0;
 }
 
+int spotGeomDraw(spotGeom *sgeom) {
+
+  return spotGeomDrawMask(sgeom, SPOT_VERT_ATTR_ALL);
+}
+
+int spotGeomStream(spotGeom *sgeom, spotStream *ss) {
+  const char me[]="spotGeomStream";
+  unsigned int ai, comp, bit, changed, vi;
+  GLuint buffId;
+  GLfloat *data;
+  GLintptr offset;
+
+  if (!( sgeom && ss )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)sgeom, (void*)ss);
+    return 1;
+  }
+  if (!( sgeom->streamMask || sgeom->streamBound )) {
+    /* nothing to do */
+    return 0;
+  }
+  changed = 0;
+  for (ai=spotVertAttrIndx_xyz; ai<=spotVertAttrIndx_tang; ai++) {
+    bit = 1u << ai;
+    if (!( data = _spotGeomAttr(sgeom, ai, &comp, &buffId) )) {
+      continue;
+    }
+    if (sgeom->streamMask & bit) {
+      if (spotStreamPush(ss, data, sizeof(GLfloat)*sgeom->vertNum*comp,
+                         &offset)) {
+        spotErrorAdd("%s: couldn't stream attribute %u", me, ai);
+        return 1;
+      }
+      sgeom->streamBuffId = ss->buffId;
+      sgeom->streamOffset[ai] = offset;
+      sgeom->streamBound |= bit;
+      changed |= bit;
+    } else if (sgeom->streamBound & bit) {
+      sgeom->streamBound &= ~bit;
+      changed |= bit;
+    }
+  }
+  /* every VAO made so far that enables a changed attribute has to be
+     pointed at its new source */
+  for (vi=0; vi<(1u << SPOT_VERT_ATTR_NUM); vi++) {
+    if (!( sgeom->vaoMaskId[vi] && (changed & vi) )) {
+      continue;
+    }
+    glBindVertexArray(sgeom->vaoMaskId[vi]);
+    for (ai=spotVertAttrIndx_xyz; ai<=spotVertAttrIndx_tang; ai++) {
+      if (changed & vi & (1u << ai)) {
+        _spotGeomAttrPoint(sgeom, ai);
+      }
+    }
+  }
+  glBindVertexArray(0);
+  return 0;
+}
+
+int spotGeomGLUpdate(spotGeom *sgeom, unsigned int attrMask) {
+  const char me[]="spotGeomGLUpdate";
+  unsigned int ai, comp;
+  GLuint buffId;
+  GLfloat *data;
+
+  if (!sgeom) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  for (ai=spotVertAttrIndx_xyz; ai<=spotVertAttrIndx_tang; ai++) {
+    if (!( (attrMask & (1u << ai))
+           && (data = _spotGeomAttr(sgeom, ai, &comp, &buffId))
+           && buffId )) {
+      /* not asked for, or nothing to send it to (yet) */
+      continue;
+    }
+    /* same size as at spotGeomGLInit, so the buffer isn't reallocated */
+    glBindBuffer(GL_ARRAY_BUFFER, buffId);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat)*sgeom->vertNum*comp,
+                    data);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return 0;
+}
+
+GLsizeiptr spotGeomStreamSize(spotGeom *sgeom, unsigned int attrMask) {
+  unsigned int ai, comp;
+  GLuint buffId;
+  GLsizeiptr ret;
+
+  ret = 0;
+  if (sgeom) {
+    for (ai=spotVertAttrIndx_xyz; ai<=spotVertAttrIndx_tang; ai++) {
+      if ((attrMask & (1u << ai)) && _spotGeomAttr(sgeom, ai, &comp, &buffId)) {
+        /* as spotStreamMap rounds it up */
+        ret += SPOT_ALIGN_UP(sizeof(GLfloat)*sgeom->vertNum*comp);
+      }
+    }
+  }
+  return ret;
+}
+
 int spotGeomGLDone(spotGeom *sgeom) {
+  unsigned int vi;
   
+  sgeom->streamBound = 0;
+  for (vi=0; vi<(1u << SPOT_VERT_ATTR_NUM); vi++) {
+    /* vaoId is deleted below */
+    if (sgeom->vaoMaskId[vi] && sgeom->vaoMaskId[vi] != sgeom->vaoId) {
+      glDeleteVertexArrays(1, sgeom->vaoMaskId + vi);
+    }
+    sgeom->vaoMaskId[vi] = 0;
+  }
   glDeleteBuffers(1, &(sgeom->xyzBuffId));
   glDeleteBuffers(1, &(sgeom->rgbBuffId));
   glDeleteBuffers(1, &(sgeom->normBuffId));
@@ -114,6 +363,15 @@ spotGeom *spotGeomNix(spotGeom *sgeom) {
   if (!sgeom) {
     return NULL;
   }
+  if (spotGeomAllocArena == sgeom->alloc) {
+    /* freed along with the rest of the arena by spotArenaNix */
+    return NULL;
+  }
+  if (spotGeomAllocBlock == sgeom->alloc) {
+    /* arrays are all in the same allocation as the struct */
+    free(sgeom);
+    return NULL;
+  }
   if (sgeom->xyz) {
     free(sgeom->xyz);
   }
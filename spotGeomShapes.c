@@ -38655,408 +38655,183 @@ static unsigned int cylinder_ICNT[3] = {
 
 /* ========================================= */
 
-spotGeom *spotGeomNewCube0(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewCube0In(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(8*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, cube0_XYZ, 8*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(8*3*sizeof(GLfloat));
-  for (ii=0; ii<8; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 8, 36, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(8*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, cube0_XYZ, 8*3*sizeof(GLfloat));
   memcpy(sgeom->norm, cube0_NORM, 8*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(8*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, cube0_TEX2, 8*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(8*3*sizeof(GLfloat));
   memcpy(sgeom->tang, cube0_TANG, 8*3*sizeof(GLfloat));
-  sgeom->vertNum = 8;
-  sgeom->indx = (GLushort*)malloc(36*sizeof(GLushort));
   memcpy(sgeom->indx, cube0_INDX, 36*sizeof(GLushort));
-  sgeom->indxNum = 36;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, cube0_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, cube0_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewCube1(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewCube0(void) {
+
+  return spotGeomNewCube0In(NULL);
+}
+
+spotGeom *spotGeomNewCube1In(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(24*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, cube1_XYZ, 24*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(24*3*sizeof(GLfloat));
-  for (ii=0; ii<24; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 24, 36, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(24*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, cube1_XYZ, 24*3*sizeof(GLfloat));
   memcpy(sgeom->norm, cube1_NORM, 24*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(24*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, cube1_TEX2, 24*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(24*3*sizeof(GLfloat));
   memcpy(sgeom->tang, cube1_TANG, 24*3*sizeof(GLfloat));
-  sgeom->vertNum = 24;
-  sgeom->indx = (GLushort*)malloc(36*sizeof(GLushort));
   memcpy(sgeom->indx, cube1_INDX, 36*sizeof(GLushort));
-  sgeom->indxNum = 36;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, cube1_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, cube1_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewCone(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewCube1(void) {
+
+  return spotGeomNewCube1In(NULL);
+}
+
+spotGeom *spotGeomNewConeIn(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(801*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, cone_XYZ, 801*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(801*3*sizeof(GLfloat));
-  for (ii=0; ii<801; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 801, 1678, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(801*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, cone_XYZ, 801*3*sizeof(GLfloat));
   memcpy(sgeom->norm, cone_NORM, 801*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(801*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, cone_TEX2, 801*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(801*3*sizeof(GLfloat));
   memcpy(sgeom->tang, cone_TANG, 801*3*sizeof(GLfloat));
-  sgeom->vertNum = 801;
-  sgeom->indx = (GLushort*)malloc(1678*sizeof(GLushort));
   memcpy(sgeom->indx, cone_INDX, 1678*sizeof(GLushort));
-  sgeom->indxNum = 1678;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, cone_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, cone_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewSoftcylinder(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewCone(void) {
+
+  return spotGeomNewConeIn(NULL);
+}
+
+spotGeom *spotGeomNewSoftcylinderIn(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, softcylinder_XYZ, 1251*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
-  for (ii=0; ii<1251; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 1251, 2598, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, softcylinder_XYZ, 1251*3*sizeof(GLfloat));
   memcpy(sgeom->norm, softcylinder_NORM, 1251*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(1251*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, softcylinder_TEX2, 1251*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
   memcpy(sgeom->tang, softcylinder_TANG, 1251*3*sizeof(GLfloat));
-  sgeom->vertNum = 1251;
-  sgeom->indx = (GLushort*)malloc(2598*sizeof(GLushort));
   memcpy(sgeom->indx, softcylinder_INDX, 2598*sizeof(GLushort));
-  sgeom->indxNum = 2598;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, softcylinder_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, softcylinder_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewSphere(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewSoftcylinder(void) {
+
+  return spotGeomNewSoftcylinderIn(NULL);
+}
+
+spotGeom *spotGeomNewSphereIn(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, sphere_XYZ, 2562*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
-  for (ii=0; ii<2562; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 2562, 15360, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, sphere_XYZ, 2562*3*sizeof(GLfloat));
   memcpy(sgeom->norm, sphere_NORM, 2562*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(2562*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, sphere_TEX2, 2562*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
   memcpy(sgeom->tang, sphere_TANG, 2562*3*sizeof(GLfloat));
-  sgeom->vertNum = 2562;
-  sgeom->indx = (GLushort*)malloc(15360*sizeof(GLushort));
   memcpy(sgeom->indx, sphere_INDX, 15360*sizeof(GLushort));
-  sgeom->indxNum = 15360;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, sphere_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, sphere_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewSoftcube(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewSphere(void) {
+
+  return spotGeomNewSphereIn(NULL);
+}
+
+spotGeom *spotGeomNewSoftcubeIn(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, softcube_XYZ, 1251*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
-  for (ii=0; ii<1251; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 1251, 2598, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, softcube_XYZ, 1251*3*sizeof(GLfloat));
   memcpy(sgeom->norm, softcube_NORM, 1251*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(1251*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, softcube_TEX2, 1251*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(1251*3*sizeof(GLfloat));
   memcpy(sgeom->tang, softcube_TANG, 1251*3*sizeof(GLfloat));
-  sgeom->vertNum = 1251;
-  sgeom->indx = (GLushort*)malloc(2598*sizeof(GLushort));
   memcpy(sgeom->indx, softcube_INDX, 2598*sizeof(GLushort));
-  sgeom->indxNum = 2598;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, softcube_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, softcube_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewEllipsoid(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewSoftcube(void) {
+
+  return spotGeomNewSoftcubeIn(NULL);
+}
+
+spotGeom *spotGeomNewEllipsoidIn(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, ellipsoid_XYZ, 2562*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
-  for (ii=0; ii<2562; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 2562, 15360, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, ellipsoid_XYZ, 2562*3*sizeof(GLfloat));
   memcpy(sgeom->norm, ellipsoid_NORM, 2562*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(2562*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, ellipsoid_TEX2, 2562*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(2562*3*sizeof(GLfloat));
   memcpy(sgeom->tang, ellipsoid_TANG, 2562*3*sizeof(GLfloat));
-  sgeom->vertNum = 2562;
-  sgeom->indx = (GLushort*)malloc(15360*sizeof(GLushort));
   memcpy(sgeom->indx, ellipsoid_INDX, 15360*sizeof(GLushort));
-  sgeom->indxNum = 15360;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, ellipsoid_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, ellipsoid_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewSquare(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewEllipsoid(void) {
+
+  return spotGeomNewEllipsoidIn(NULL);
+}
+
+spotGeom *spotGeomNewSquareIn(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(4*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, square_XYZ, 4*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(4*3*sizeof(GLfloat));
-  for (ii=0; ii<4; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 4, 4, 1) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(4*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, square_XYZ, 4*3*sizeof(GLfloat));
   memcpy(sgeom->norm, square_NORM, 4*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(4*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, square_TEX2, 4*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(4*3*sizeof(GLfloat));
   memcpy(sgeom->tang, square_TANG, 4*3*sizeof(GLfloat));
-  sgeom->vertNum = 4;
-  sgeom->indx = (GLushort*)malloc(4*sizeof(GLushort));
   memcpy(sgeom->indx, square_INDX, 4*sizeof(GLushort));
-  sgeom->indxNum = 4;
-  sgeom->primNum = 1;
-  sgeom->ptype = (GLenum*)malloc(1*sizeof(GLenum));
   memcpy(sgeom->ptype, square_PTYPE, 1*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(1*sizeof(unsigned int));
   memcpy(sgeom->icnt, square_ICNT, 1*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
-spotGeom *spotGeomNewCylinder(void) {
-  unsigned int ii;
+spotGeom *spotGeomNewSquare(void) {
+
+  return spotGeomNewSquareIn(NULL);
+}
+
+spotGeom *spotGeomNewCylinderIn(spotArena *arena) {
   spotGeom *sgeom;
-  sgeom = (spotGeom *)malloc(sizeof(spotGeom));
-  sgeom->xyz = (GLfloat*)malloc(200*3*sizeof(GLfloat));
-  memcpy(sgeom->xyz, cylinder_XYZ, 200*3*sizeof(GLfloat));
-  sgeom->rgb = (GLfloat*)malloc(200*3*sizeof(GLfloat));
-  for (ii=0; ii<200; ii++) {
-    SPOT_V3_SET(sgeom->rgb + 3*ii, 1.0f, 1.0f, 1.0f);
+  if (!( sgeom = spotGeomNewIn(arena, 200, 202, 3) )) {
+    return NULL;
   }
-  sgeom->norm = (GLfloat*)malloc(200*3*sizeof(GLfloat));
+  memcpy(sgeom->xyz, cylinder_XYZ, 200*3*sizeof(GLfloat));
   memcpy(sgeom->norm, cylinder_NORM, 200*3*sizeof(GLfloat));
-  sgeom->tex2 = (GLfloat*)malloc(200*2*sizeof(GLfloat));
   memcpy(sgeom->tex2, cylinder_TEX2, 200*2*sizeof(GLfloat));
-  sgeom->tang = (GLfloat*)malloc(200*3*sizeof(GLfloat));
   memcpy(sgeom->tang, cylinder_TANG, 200*3*sizeof(GLfloat));
-  sgeom->vertNum = 200;
-  sgeom->indx = (GLushort*)malloc(202*sizeof(GLushort));
   memcpy(sgeom->indx, cylinder_INDX, 202*sizeof(GLushort));
-  sgeom->indxNum = 202;
-  sgeom->primNum = 3;
-  sgeom->ptype = (GLenum*)malloc(3*sizeof(GLenum));
   memcpy(sgeom->ptype, cylinder_PTYPE, 3*sizeof(GLenum));
-  sgeom->icnt = (unsigned int*)malloc(3*sizeof(unsigned int));
   memcpy(sgeom->icnt, cylinder_ICNT, 3*sizeof(unsigned int));
-  sgeom->objColor[0] = 1.0f;
-  sgeom->objColor[1] = 1.0f;
-  sgeom->objColor[2] = 1.0f;
-  sgeom->Ka = 1.0f;
-  sgeom->Kd = 0.0f;
-  sgeom->Ks = 0.0f;
-  sgeom->shexp = 100.0f;
-  SPOT_M4_IDENTITY(sgeom->modelMatrix);
-  SPOT_M3_IDENTITY(sgeom->normalMatrix);
-  sgeom->program = 0;
-  sgeom->vaoId = 0;
-  sgeom->xyzBuffId = 0;
-  sgeom->rgbBuffId = 0;
-  sgeom->normBuffId = 0;
-  sgeom->tex2BuffId = 0;
-  sgeom->tangBuffId = 0;
-  sgeom->indxBuffId = 0;
   return sgeom;
 }
 
+spotGeom *spotGeomNewCylinder(void) {
+
+  return spotGeomNewCylinderIn(NULL);
+}
+
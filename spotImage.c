@@ -14,6 +14,13 @@
 
 #include "spot.h"
 
+#include <pthread.h>
+#include <unistd.h>  /* for sysconf */
+#include <zlib.h>    /* for Z_BEST_SPEED */
+
+/* at most this many image loading workers, however many cores there are */
+#define SPOT_IMAGE_LOAD_WORKERS_MAX 16
+
 static void _spotImageInit(spotImage *img) {
   
   if (img) {
@@ -25,7 +32,13 @@ static void _spotImageInit(spotImage *img) {
       free(img->data.v);
       img->data.v = NULL;
     }
+    if (img->bcData) {
+      free(img->bcData);
+      img->bcData = NULL;
+    }
     img->textureId = 0;
+    img->bufferId = 0;
+    /* but not img->bcFormat, which says how to load the image */
   }
   return;
 }
@@ -110,27 +123,41 @@ static int _spotLittleEndian(void) {
 }
 
 /*
-** spotImageLoadPNG: read PNG image from fname into img
+** _spotImageLoadPNG: read PNG image from fname into img.  With infoOnly,
+** this stops after the header, having set only the sizes in img.  With a
+** non-NULL dest, the pixel data is read into dest (rather than a newly
+** allocated img->data), which must have room for the sizes that img already
+** has (as set by an earlier infoOnly read), and the image must match them.
 **
 ** Note: this borrows from the _nrrdFormatPNG_read() function 
 ** from Teem <http://teem.sf.net>, written by Milan Ikits
 */
-int spotImageLoadPNG(spotImage *img, char *fname) {
+static int _spotImageLoadPNG(spotImage *img, const char *fname, void *dest,
+                             int infoOnly) {
   const char me[]="spotImageLoadPNG";
+  unsigned int sizeC, sizeP, sizeX, sizeY;
   unsigned char header[8];
   png_structp png_ptr;
   png_infop info_ptr;
   FILE *file;
-  int itype, idepth;
+  int itype, idepth, ilace, swap;
   png_uint_32 rowsize;
-  png_bytep *row;
+  /* volatile since they are set after the setjmp and freed after the longjmp */
+  png_bytep *volatile row;
+  png_bytep volatile scratch;
   unsigned int rowIdx;
 
   if (!( img && fname )) {
-    spotErrorAdd("%s: got NULL pointer (%p %p)", me, img, fname);
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)img, (void*)fname);
     return 1;
   }
-  _spotImageInit(img);
+  sizeC = img->sizeC;
+  sizeP = img->sizeP;
+  sizeX = img->sizeX;
+  sizeY = img->sizeY;
+  if (!dest) {
+    _spotImageInit(img);
+  }
   if (!(file = fopen(fname, "rb"))) {
     spotErrorAdd("%s: couldn't open \"%s\" for reading", me, fname);
     return 1;
@@ -156,8 +183,13 @@ int spotImageLoadPNG(spotImage *img, char *fname) {
     BYE2; return 1;
   }
 #define BYE3 BYE2; png_destroy_read_struct(NULL, &info_ptr, NULL);
+  row = NULL;
+  scratch = NULL;
+  /* the jmp_buf is in png_ptr, so each call (in whatever thread) has its own */
   if (setjmp(png_jmpbuf(png_ptr))) {
     spotErrorAdd("%s: error during PNG IO", me);
+    free(row);
+    free(scratch);
     BYE3; return 1;
   }
   png_init_io(png_ptr, file);
@@ -165,7 +197,7 @@ int spotImageLoadPNG(spotImage *img, char *fname) {
   png_read_info(png_ptr, info_ptr);
   png_get_IHDR(png_ptr, info_ptr,
                &(img->sizeX), &(img->sizeY), &idepth, &itype,
-               NULL, NULL, NULL);
+               &ilace, NULL, NULL);
   /* expand paletted colors into rgb triplets */
   if (itype == PNG_COLOR_TYPE_PALETTE) {
     png_set_palette_to_rgb(png_ptr);
@@ -179,10 +211,17 @@ int spotImageLoadPNG(spotImage *img, char *fname) {
   if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
     png_set_tRNS_to_alpha(png_ptr);
   }
+  swap = 0;
   if (idepth > 8) {
-    /* fix endianness for 16 bit formats */
+    /* fix endianness for 16 bit formats: rows of a non-interlaced image
+       are swapped (with spotConvertSwap16) as they are copied out of a
+       scratch row, else libpng swaps them */
     if (_spotLittleEndian()) {
-      png_set_swap(png_ptr);
+      if (PNG_INTERLACE_NONE == ilace) {
+        swap = 1;
+      } else {
+        png_set_swap(png_ptr);
+      }
     }
     img->sizeC = 2;
   } else {
@@ -209,8 +248,19 @@ int spotImageLoadPNG(spotImage *img, char *fname) {
     BYE3; return 1;
     break;
   }
-  if (!(img->data.v = calloc(img->sizeP*img->sizeX*img->sizeY, 
-                             img->sizeC))) {
+  if (infoOnly) {
+    BYE3; return 0;
+  }
+  if (dest) {
+    if (!( sizeC == img->sizeC && sizeP == img->sizeP
+           && sizeX == img->sizeX && sizeY == img->sizeY )) {
+      spotErrorAdd("%s: \"%s\" is now %u x %u x %u x %u, not %u x %u x %u x %u",
+                   me, fname, img->sizeC, img->sizeP, img->sizeX, img->sizeY,
+                   sizeC, sizeP, sizeX, sizeY);
+      BYE3; return 1;
+    }
+  } else if (!(img->data.v = calloc(img->sizeP*img->sizeX*img->sizeY, 
+                                    img->sizeC))) {
     spotErrorAdd("%s: couldn't allocate %d x %d x %d %s", me,
                  img->sizeC, img->sizeX, img->sizeY, 
                  1 == img->sizeC ? "uchars" : "ushorts");
@@ -226,14 +276,31 @@ int spotImageLoadPNG(spotImage *img, char *fname) {
   /* set up row pointers */
   row = (png_bytep*)calloc(img->sizeY, sizeof(png_bytep));
   for (rowIdx=0; rowIdx<img->sizeY; rowIdx++) {
-    row[rowIdx] = img->data.uc + rowIdx*rowsize;
+    row[rowIdx] = (dest ? (unsigned char *)dest : img->data.uc) + rowIdx*rowsize;
+  }
+  if (swap) {
+    /* one row at a time, so that dest (which may be a write-only buffer
+       mapping) is only written to */
+    scratch = (png_bytep)malloc(rowsize);
+    if (!scratch) {
+      spotErrorAdd("%s: couldn't allocate row", me);
+      free(row);
+      BYE3; return 1;
+    }
+    for (rowIdx=0; rowIdx<img->sizeY; rowIdx++) {
+      png_read_row(png_ptr, scratch, NULL);
+      spotConvertSwap16((unsigned short *)row[rowIdx],
+                        (const unsigned short *)scratch, rowsize/2);
+    }
+  } else {
+    /* read the entire image in one pass */
+    png_read_image(png_ptr, row);
   }
-  /* read the entire image in one pass */
-  png_read_image(png_ptr, row);
   /* finish reading */
   png_read_end(png_ptr, info_ptr);
   /* clean up */
   free(row);
+  free(scratch);
   
   BYE3;
   return 0;
@@ -242,7 +309,214 @@ int spotImageLoadPNG(spotImage *img, char *fname) {
 #undef BYE2
 #undef BYE3
 
-int spotImageSavePNG(char *fname, spotImage *img) {
+/*
+** spotImageLoadPNG: read PNG image from fname into img
+*/
+int spotImageLoadPNG(spotImage *img, char *fname) {
+
+  return _spotImageLoadPNG(img, fname, NULL, 0);
+}
+
+int spotImageLoadPNGInfo(spotImage *img, const char *fname) {
+
+  return _spotImageLoadPNG(img, fname, NULL, 1);
+}
+
+int spotImageLoadPNGInto(spotImage *img, const char *fname, void *dest) {
+  const char me[]="spotImageLoadPNGInto";
+
+  if (!dest) {
+    spotErrorAdd("%s: got NULL dest", me);
+    return 1;
+  }
+  return _spotImageLoadPNG(img, fname, dest, 0);
+}
+
+/*
+** The queue of loads waiting for a worker, and the lock and conditions
+** for it.  Workers wait on _spotImageLoadWork for the queue to be
+** non-empty; spotImageLoadWait waits on _spotImageLoadDone for its load to
+** be done
+*/
+static pthread_once_t _spotImageLoadOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t _spotImageLoadLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _spotImageLoadWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _spotImageLoadDone = PTHREAD_COND_INITIALIZER;
+static spotImageLoad *_spotImageLoadHead = NULL, *_spotImageLoadTail = NULL;
+static unsigned int _spotImageLoadWorkers = 0;
+
+static int _spotImageSavePNG(char *fname, spotImage *img, int level);
+
+/*
+** _spotImageLoadWorker: takes loads (and saves) off the queue and does them,
+** forever
+*/
+static void *_spotImageLoadWorker(void *arg) {
+  spotImageLoad *load;
+
+  SPOT_UNUSED(arg);
+  for (;;) {
+    pthread_mutex_lock(&_spotImageLoadLock);
+    while (!_spotImageLoadHead) {
+      pthread_cond_wait(&_spotImageLoadWork, &_spotImageLoadLock);
+    }
+    load = _spotImageLoadHead;
+    if (!( _spotImageLoadHead = load->next )) {
+      _spotImageLoadTail = NULL;
+    }
+    pthread_mutex_unlock(&_spotImageLoadLock);
+
+    if (load->save) {
+      load->ret = _spotImageSavePNG(load->fname, load->img, Z_BEST_SPEED);
+    } else {
+      load->ret = (load->img->bcFormat
+                   ? spotImageLoadPNGBC(load->img, load->fname, load->dest)
+                   : (load->dest
+                      ? spotImageLoadPNGInto(load->img, load->fname, load->dest)
+                      : spotImageLoadPNG(load->img, load->fname)));
+    }
+
+    pthread_mutex_lock(&_spotImageLoadLock);
+    load->done = 1;
+    pthread_cond_broadcast(&_spotImageLoadDone);
+    pthread_mutex_unlock(&_spotImageLoadLock);
+  }
+  return NULL;
+}
+
+/*
+** _spotImageLoadStart: starts the (detached) workers, one per core
+*/
+static void _spotImageLoadStart(void) {
+  pthread_attr_t attr;
+  pthread_t thread;
+  long cores;
+  unsigned int wi;
+
+  cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cores < 1) {
+    cores = 1;
+  } else if (cores > SPOT_IMAGE_LOAD_WORKERS_MAX) {
+    cores = SPOT_IMAGE_LOAD_WORKERS_MAX;
+  }
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (wi=0; wi<(unsigned int)cores; wi++) {
+    if (pthread_create(&thread, &attr, _spotImageLoadWorker, NULL)) {
+      break;
+    }
+  }
+  pthread_attr_destroy(&attr);
+  _spotImageLoadWorkers = wi;
+  return;
+}
+
+/*
+** _spotImageLoadQueue: queues up a load (or with save, a save) for the
+** workers, starting them if need be
+*/
+static spotImageLoad *_spotImageLoadQueue(spotImage *img, const char *fname,
+                                          void *dest, int save) {
+  const char me[]="_spotImageLoadQueue";
+  spotImageLoad *load;
+
+  pthread_once(&_spotImageLoadOnce, _spotImageLoadStart);
+  if (!_spotImageLoadWorkers) {
+    spotErrorAdd("%s: couldn't start any image loading threads", me);
+    return NULL;
+  }
+  if (!( (load = (spotImageLoad *)calloc(1, sizeof(spotImageLoad)))
+         && (load->fname = spotStrdup(fname)) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    free(load);
+    return NULL;
+  }
+  load->img = img;
+  load->dest = dest;
+  load->save = save;
+  load->ret = 1;
+  load->done = 0;
+  load->next = NULL;
+  pthread_mutex_lock(&_spotImageLoadLock);
+  if (_spotImageLoadTail) {
+    _spotImageLoadTail->next = load;
+  } else {
+    _spotImageLoadHead = load;
+  }
+  _spotImageLoadTail = load;
+  pthread_cond_signal(&_spotImageLoadWork);
+  pthread_mutex_unlock(&_spotImageLoadLock);
+  return load;
+}
+
+spotImageLoad *spotImageLoadPNGAsync(spotImage *img, const char *fname,
+                                     void *dest) {
+  const char me[]="spotImageLoadPNGAsync";
+  spotImageLoad *load;
+
+  if (!( img && fname )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)img, (void*)fname);
+    return NULL;
+  }
+  if (!( load = _spotImageLoadQueue(img, fname, dest, 0) )) {
+    spotErrorAdd("%s: couldn't queue \"%s\"", me, fname);
+    return NULL;
+  }
+  return load;
+}
+
+spotImageLoad *spotImageSavePNGAsync(spotImage *img, const char *fname) {
+  const char me[]="spotImageSavePNGAsync";
+  spotImageLoad *load;
+
+  if (!( img && img->data.v && fname )) {
+    spotErrorAdd("%s: got NULL pointer or data (%p %p)", me, (void*)img,
+                 (void*)fname);
+    return NULL;
+  }
+  if (!( load = _spotImageLoadQueue(img, fname, NULL, 1) )) {
+    spotErrorAdd("%s: couldn't queue \"%s\"", me, fname);
+    return NULL;
+  }
+  return load;
+}
+
+int spotImageLoadDone(spotImageLoad *load) {
+  int done;
+
+  pthread_mutex_lock(&_spotImageLoadLock);
+  done = load->done;
+  pthread_mutex_unlock(&_spotImageLoadLock);
+  return done;
+}
+
+int spotImageLoadWait(spotImageLoad *load) {
+  const char me[]="spotImageLoadWait";
+  int ret;
+
+  if (!load) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  pthread_mutex_lock(&_spotImageLoadLock);
+  while (!load->done) {
+    pthread_cond_wait(&_spotImageLoadDone, &_spotImageLoadLock);
+  }
+  pthread_mutex_unlock(&_spotImageLoadLock);
+  if ((ret = load->ret)) {
+    spotErrorAdd("%s: trouble %s \"%s\"", me,
+                 load->save ? "saving" : "loading", load->fname);
+  }
+  free(load->fname);
+  free(load);
+  return ret;
+}
+
+/*
+** _spotImageSavePNG: write img to PNG file fname, with zlib compression
+** level (or Z_DEFAULT_COMPRESSION)
+*/
+static int _spotImageSavePNG(char *fname, spotImage *img, int level) {
   const char me[]="spotImageSavePNG";
   FILE *file;
   int type;
@@ -280,6 +554,7 @@ int spotImageSavePNG(char *fname, spotImage *img) {
   }
   /* initialize png I/O */
   png_init_io(png_ptr, file);        
+  png_set_compression_level(png_ptr, level);
   /* calculate row size */
   rowsize = img->sizeX*img->sizeP*img->sizeC;
   switch (img->sizeP) {
@@ -330,6 +605,11 @@ int spotImageSavePNG(char *fname, spotImage *img) {
 #undef BYE2
 #undef BYE3
 
+int spotImageSavePNG(char *fname, spotImage *img) {
+
+  return _spotImageSavePNG(fname, img, Z_DEFAULT_COMPRESSION);
+}
+
 int spotImageScreenshot(spotImage *img, int withAlpha) {
   const char me[]="spotImageScreenshot";
   GLint vport[4], lastBuffer;
@@ -373,15 +653,23 @@ int spotImageScreenshot(spotImage *img, int withAlpha) {
   return 0;
 }
 
-/* method "9. Decrement and Compare" from:
-** http://www.exploringbinary.com/ten-ways-to-check-if-an-integer-is-a-power-of-two-in-c/
-*/
-static int isPowerOfTwo(unsigned int x) {
-  return ((x != 0) && !(x & (x - 1)));
+GLenum spotImageGLInternalFormat(const spotImage *img) {
+
+  if (2 != img->sizeC) {
+    return GL_RGBA8;
+  }
+  switch (img->sizeP) {
+  case 1: return GL_R16;
+  case 2: return GL_RG16;
+  /* GL_RGB16 isn't required to be renderable, and is padded anyway */
+  default: return GL_RGBA16;
+  }
 }
 
 int spotImageGLInit(spotImage *img) {
   const char me[]="spotImageGLInit";
+  const unsigned char *pixels;
+  unsigned short *rgba;
   GLint dataFormat;
   GLenum type;
 
@@ -403,33 +691,257 @@ int spotImageGLInit(spotImage *img) {
     return 1;
     break;
   }
-  if (!( isPowerOfTwo(img->sizeX)
-         && isPowerOfTwo(img->sizeY) )) {
-    spotErrorAdd("%s: image dimensions (%u,%u) not both powers of two",
-                 me, img->sizeX, img->sizeY);
+  /* any size will do (non-power-of-two textures are core since GL 2.0) */
+  if (!( img->sizeX && img->sizeY )) {
+    spotErrorAdd("%s: image dimensions (%u,%u) not set", me,
+                 img->sizeX, img->sizeY);
     return 1;
   }
 
+  if (spotImageGLUnpackBegin(img, &pixels)) {
+    spotErrorAdd("%s: couldn't get pixel data", me);
+    return 1;
+  }
   type = (1 == img->sizeC
           ? GL_UNSIGNED_BYTE
           : GL_UNSIGNED_SHORT);
+  rgba = NULL;
+  if (2 == img->sizeC && 3 == img->sizeP && pixels && !img->bcFormat) {
+    /* drivers commonly convert 16-bit RGB to RGBA one pixel at a time; so
+       it goes up as RGBA, as it is stored, when an expanded copy fits */
+    if ((rgba = (unsigned short *)malloc((size_t)4*sizeof(unsigned short)
+                                         *img->sizeX*img->sizeY))) {
+      spotConvertRGBToRGBA16(rgba, (const unsigned short *)pixels,
+                             (size_t)img->sizeX*img->sizeY);
+      pixels = (const unsigned char *)rgba;
+      dataFormat = GL_RGBA;
+    }
+  }
   glGenTextures(1, &(img->textureId));
   glBindTexture(GL_TEXTURE_2D, img->textureId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, img->sizeX, img->sizeY, 
-               0, dataFormat, type, img->data.v);
+  /* rows of RGB or 1- or 2-channel images needn't be a multiple of 4 bytes */
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (img->bcFormat) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, spotBCGLFormat(img->bcFormat),
+                           img->sizeX, img->sizeY, 0,
+                           (GLsizei)spotBCSize(img->bcFormat, img->sizeX,
+                                               img->sizeY), pixels);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, 0, spotImageGLInternalFormat(img),
+                 img->sizeX, img->sizeY, 0, dataFormat, type, pixels);
+  }
+  free(rgba);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glBindTexture(GL_TEXTURE_2D, 0);
+  spotImageGLUnpackEnd(img);
 
   return 0;
 }
 
+void *spotImageGLBufferMap(spotImage *img) {
+  const char me[]="spotImageGLBufferMap";
+  GLsizeiptr size;
+  void *ptr;
+
+  if (!img) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return NULL;
+  }
+  if (!( img->sizeC && img->sizeP && img->sizeX && img->sizeY )) {
+    spotErrorAdd("%s: image sizes not set (by spotImageLoadPNGInfo)", me);
+    return NULL;
+  }
+  if (img->bufferId) {
+    spotErrorAdd("%s: image already has a pixel buffer %u", me, img->bufferId);
+    return NULL;
+  }
+  size = (img->bcFormat
+          ? (GLsizeiptr)spotBCSize(img->bcFormat, img->sizeX, img->sizeY)
+          : (GLsizeiptr)img->sizeC*img->sizeP*img->sizeX*img->sizeY);
+  glGenBuffers(1, &(img->bufferId));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, img->bufferId);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+  /* nothing in the buffer is worth keeping, so the driver needn't wait */
+  ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  /* the mapping stays valid after unbinding */
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (!ptr) {
+    spotErrorAdd("%s: couldn't map %ld-byte pixel buffer", me, (long)size);
+    glDeleteBuffers(1, &(img->bufferId));
+    img->bufferId = 0;
+  }
+  return ptr;
+}
+
+int spotImageGLUnpackBegin(spotImage *img, const unsigned char **pixels) {
+  const char me[]="spotImageGLUnpackBegin";
+
+  if (!( img && pixels )) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  if (!img->bufferId) {
+    if (img->bcFormat) {
+      if (!img->bcData) {
+        spotErrorAdd("%s: image has no blocks", me);
+        return 1;
+      }
+      *pixels = (const unsigned char *)img->bcData;
+      return 0;
+    }
+    if (!img->data.v) {
+      spotErrorAdd("%s: image has no data", me);
+      return 1;
+    }
+    *pixels = img->data.uc;
+    return 0;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, img->bufferId);
+  if (GL_TRUE != glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+    /* e.g. the display mode changed while the buffer was mapped */
+    spotErrorAdd("%s: pixel buffer %u lost its contents", me, img->bufferId);
+    spotImageGLUnpackEnd(img);
+    return 1;
+  }
+  /* with a buffer bound, glTexImage2D takes offsets into it */
+  *pixels = NULL;
+  return 0;
+}
+
+void spotImageGLUnpackEnd(spotImage *img) {
+
+  if (img && img->bufferId) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &(img->bufferId));
+    img->bufferId = 0;
+  }
+  if (img && img->bcData) {
+    /* uploaded; any mip levels are encoded from img->data instead */
+    free(img->bcData);
+    img->bcData = NULL;
+  }
+  return;
+}
+
 int spotImageGLDone(spotImage *img) {
 
+  /* in case the buffer was mapped but never uploaded from */
+  spotImageGLUnpackEnd(img);
   glDeleteTextures(1, &(img->textureId));
   return 0;
 }
 
+spotImageArray *spotImageArrayNew(void) {
+  const char me[]="spotImageArrayNew";
+  spotImageArray *arr;
+
+  if (!( arr = (spotImageArray *)calloc(1, sizeof(spotImageArray)) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    return NULL;
+  }
+  return arr;
+}
+
+int spotImageArrayGLInit(spotImageArray *arr, spotImage **img, unsigned int num) {
+  const char me[]="spotImageArrayGLInit";
+  const unsigned char *pixels;
+  unsigned int ii, li, sx, sy;
+  const GLenum dataFormat[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  GLenum internalFormat;
+
+  if (!( arr && img && num )) {
+    spotErrorAdd("%s: got NULL pointer or no images", me);
+    return 1;
+  }
+  if (arr->textureId) {
+    spotErrorAdd("%s: array already has texture %u", me, arr->textureId);
+    return 1;
+  }
+  for (ii=0; ii<num; ii++) {
+    if (!img[ii]) {
+      spotErrorAdd("%s: got NULL image %u", me, ii);
+      return 1;
+    }
+    if (!( img[ii]->sizeX == img[0]->sizeX && img[ii]->sizeY == img[0]->sizeY )) {
+      spotErrorAdd("%s: image %u is %u x %u, not %u x %u like image 0", me, ii,
+                   img[ii]->sizeX, img[ii]->sizeY, img[0]->sizeX, img[0]->sizeY);
+      return 1;
+    }
+    if (!( 1 <= img[ii]->sizeP && img[ii]->sizeP <= 4 )) {
+      spotErrorAdd("%s: can't handle sizeP %d of image %u", me, img[ii]->sizeP, ii);
+      return 1;
+    }
+    if (img[ii]->bcFormat) {
+      spotErrorAdd("%s: image %u is block compressed", me, ii);
+      return 1;
+    }
+  }
+  /* the layers share a format: 16-bit if any of them is */
+  internalFormat = GL_RGBA8;
+  for (ii=0; ii<num; ii++) {
+    if (2 == img[ii]->sizeC) {
+      internalFormat = GL_RGBA16;
+    }
+  }
+  arr->sizeX = img[0]->sizeX;
+  arr->sizeY = img[0]->sizeY;
+  arr->layerNum = num;
+  glGenTextures(1, &(arr->textureId));
+  glBindTexture(GL_TEXTURE_2D_ARRAY, arr->textureId);
+  /* every level of every layer is allocated up front, so that layers can
+     be filled in (and their mip levels made) one at a time */
+  for (li=0, sx=arr->sizeX, sy=arr->sizeY; ; li++) {
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, li, internalFormat, sx, sy, num,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    if (1 == sx && 1 == sy) {
+      break;
+    }
+    sx = SPOT_MAX(1, sx/2);
+    sy = SPOT_MAX(1, sy/2);
+  }
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, li);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (ii=0; ii<num; ii++) {
+    if (spotImageGLUnpackBegin(img[ii], &pixels)) {
+      spotErrorAdd("%s: couldn't get pixel data of image %u", me, ii);
+      break;
+    }
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, ii, arr->sizeX, arr->sizeY, 1,
+                    dataFormat[img[ii]->sizeP-1],
+                    1 == img[ii]->sizeC ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT,
+                    pixels);
+    spotImageGLUnpackEnd(img[ii]);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  if (ii < num) {
+    spotImageArrayGLDone(arr);
+    return 1;
+  }
+  return 0;
+}
+
+int spotImageArrayGLDone(spotImageArray *arr) {
+
+  if (arr && arr->textureId) {
+    glDeleteTextures(1, &(arr->textureId));
+    arr->textureId = 0;
+  }
+  return 0;
+}
+
+spotImageArray *spotImageArrayNix(spotImageArray *arr) {
+
+  free(arr);
+  return NULL;
+}
+
 spotImage *spotImageNix(spotImage *img) {
 
   if (img) {
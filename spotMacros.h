@@ -39,6 +39,12 @@ extern "C" {
 /* use this to "warning: unused parameter" warnings */
 #define SPOT_UNUSED(x) (void)(x)
 
+/* smaller, larger, and x clamped to [lo,hi]; arguments are evaluated
+   more than once */
+#define SPOT_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define SPOT_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define SPOT_CLAMP(lo, x, hi) SPOT_MIN(SPOT_MAX((lo), (x)), (hi))
+
 /* M_PI is supposed to be defined in C, not all compilers comply */
 #ifndef M_PI
 #define M_PI 3.14159265358979323846264338327
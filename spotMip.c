@@ -0,0 +1,636 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+#include <pthread.h>
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#  include <immintrin.h>
+#endif
+
+/* support radius (in pixels of the smaller level) of the windowed sincs */
+#define MIP_SINC_RADIUS 3
+/* Kaiser window shape parameter */
+#define MIP_KAISER_ALPHA 4.0
+
+/*
+** A _spotMipTaps says, for one axis of one level, which samples of the
+** bigger level (idx, clamped to its edges) each sample of the smaller one
+** is made from, and with what weights (wght), tapNum apiece
+*/
+typedef struct {
+  unsigned int inSize, outSize, tapNum;
+  unsigned int *idx;
+  float *wght;
+} _spotMipTaps;
+
+/*
+** _spotMipJob: what the threads working on one pass (via spotParallel)
+** share
+*/
+typedef struct {
+  const spotImage *img;  /* 8- or 16-bit image being decoded or encoded */
+  int kind;              /* spotMipKind* */
+  const _spotMipTaps *taps;
+  const float *in;       /* input of the pass */
+  float *out;            /* output of the pass */
+  unsigned int inX,      /* samples per row of in */
+    outX;                /* samples per row of out */
+} _spotMipJob;
+
+/* sRGB encoding to linear, for 8-bit values */
+static float _spotMipSRGB8[256];
+static pthread_once_t _spotMipOnce = PTHREAD_ONCE_INIT;
+
+static double _spotMipToLinear(double vv) {
+  return (vv <= 0.04045
+          ? vv/12.92
+          : pow((vv + 0.055)/1.055, 2.4));
+}
+
+static double _spotMipToSRGB(double vv) {
+  return (vv <= 0.0031308
+          ? vv*12.92
+          : 1.055*pow(vv, 1.0/2.4) - 0.055);
+}
+
+static void _spotMipTableInit(void) {
+  unsigned int ii;
+
+  for (ii=0; ii<256; ii++) {
+    _spotMipSRGB8[ii] = (float)_spotMipToLinear(ii/255.0);
+  }
+  return;
+}
+
+static double _spotMipSinc(double xx) {
+  return (fabs(xx) < 1e-8
+          ? 1.0
+          : sin(M_PI*xx)/(M_PI*xx));
+}
+
+/* modified Bessel function of the first kind, order 0 (by its series) */
+static double _spotMipBesselI0(double xx) {
+  double sum, term;
+  unsigned int kk;
+
+  sum = term = 1.0;
+  for (kk=1; kk<32; kk++) {
+    term *= (xx/(2*kk))*(xx/(2*kk));
+    sum += term;
+  }
+  return sum;
+}
+
+/*
+** _spotMipKernel: the filter at xx, in pixels of the smaller level
+*/
+static double _spotMipKernel(int filter, double xx) {
+  double rr;
+
+  rr = fabs(xx)/MIP_SINC_RADIUS;
+  switch (filter) {
+  case spotMipFilterBox:
+    return fabs(xx) <= 0.5 ? 1.0 : 0.0;
+  case spotMipFilterKaiser:
+    return (rr < 1
+            ? (_spotMipSinc(xx)*_spotMipBesselI0(MIP_KAISER_ALPHA*sqrt(1 - rr*rr))
+               /_spotMipBesselI0(MIP_KAISER_ALPHA))
+            : 0.0);
+  case spotMipFilterLanczos:
+    return rr < 1 ? _spotMipSinc(xx)*_spotMipSinc(xx/MIP_SINC_RADIUS) : 0.0;
+  }
+  return 0.0;
+}
+
+static unsigned int _spotMipTapNum(int filter) {
+  /* the box averages two samples, the sincs reach out
+     MIP_SINC_RADIUS smaller pixels (so twice that many bigger ones)
+     on either side */
+  return (spotMipFilterBox == filter
+          ? 2
+          : 4*MIP_SINC_RADIUS);
+}
+
+/*
+** _spotMipTapsSet: set up the taps to halve inSize (unless it is already
+** 1), returning non-zero in case of error.  An odd inSize (as with
+** non-power-of-two images) is rounded down when halved, as GL does, so
+** each smaller sample then covers a little more than two bigger ones
+*/
+static int _spotMipTapsSet(_spotMipTaps *taps, unsigned int inSize, int filter) {
+  unsigned int oi, ti;
+  int first, jj;
+  double scale, center, sum, ww;
+
+  taps->inSize = inSize;
+  if (1 == inSize) {
+    taps->outSize = taps->tapNum = 1;
+  } else {
+    taps->outSize = inSize/2;
+    taps->tapNum = _spotMipTapNum(filter);
+  }
+  scale = (double)inSize/taps->outSize;
+  if (inSize > 1 && inSize % 2) {
+    /* enough taps to reach as far as the kernel does, at this scale */
+    taps->tapNum = (spotMipFilterBox == filter
+                    ? (unsigned int)ceil(scale) + 1
+                    : (unsigned int)ceil(2*MIP_SINC_RADIUS*scale) + 1);
+  }
+  taps->idx = (unsigned int *)malloc(taps->outSize*taps->tapNum*sizeof(unsigned int));
+  taps->wght = (float *)malloc(taps->outSize*taps->tapNum*sizeof(float));
+  if (!( taps->idx && taps->wght )) {
+    return 1;
+  }
+  if (1 == inSize) {
+    taps->idx[0] = 0;
+    taps->wght[0] = 1.0f;
+    return 0;
+  }
+  for (oi=0; oi<taps->outSize; oi++) {
+    /* sample jj of the bigger level is centered at jj+0.5, and sample oi
+       of the smaller one at (oi+0.5)*scale (in the bigger one's pixels),
+       which is 2*oi + 1 for even inSize */
+    center = (oi + 0.5)*scale;
+    first = (int)floor(center + 0.5) - (int)taps->tapNum/2;
+    sum = 0;
+    for (ti=0; ti<taps->tapNum; ti++) {
+      jj = first + (int)ti;
+      ww = _spotMipKernel(filter, (jj + 0.5 - center)/scale);
+      taps->idx[ti + taps->tapNum*oi] = SPOT_CLAMP(0, jj, (int)inSize-1);
+      taps->wght[ti + taps->tapNum*oi] = (float)ww;
+      sum += ww;
+    }
+    for (ti=0; ti<taps->tapNum; ti++) {
+      taps->wght[ti + taps->tapNum*oi] /= (float)sum;
+    }
+  }
+  return 0;
+}
+
+static void _spotMipTapsDone(_spotMipTaps *taps) {
+  free(taps->idx);
+  free(taps->wght);
+  taps->idx = NULL;
+  taps->wght = NULL;
+  return;
+}
+
+/* the channel of a pixel with sizeP channels that is alpha, if any */
+static unsigned int _spotMipAlpha(unsigned int sizeP) {
+  return (2 == sizeP ? 1
+          : (4 == sizeP ? 3
+             : sizeP));
+}
+
+/*
+** _spotMipDecode: rows of img to floats in out: normalized to [0,1], then
+** (for color) from sRGB to linear, or (for normals) to [-1,1]
+*/
+static void _spotMipDecode(void *_job, unsigned int row0, unsigned int row1) {
+  _spotMipJob *job = (_spotMipJob *)_job;
+  const spotImage *img;
+  unsigned int ii, num, cc, alpha, sizeP;
+  const unsigned char *uc;
+  const unsigned short *us;
+  float *out, scl, off;
+
+  img = job->img;
+  sizeP = img->sizeP;
+  num = (row1 - row0)*img->sizeX*sizeP;
+  out = job->out + (size_t)row0*img->sizeX*sizeP;
+  uc = img->data.uc + (size_t)row0*img->sizeX*sizeP;
+  us = img->data.us + (size_t)row0*img->sizeX*sizeP;
+  if (spotMipKindColor == job->kind && 1 == img->sizeC) {
+    alpha = _spotMipAlpha(sizeP);
+    for (ii=0; ii<num; ii++) {
+      out[ii] = (ii % sizeP == alpha
+                 ? uc[ii]/255.0f
+                 : _spotMipSRGB8[uc[ii]]);
+    }
+    return;
+  }
+  /* else the linear map from integer to float */
+  scl = 1.0f/(1 == img->sizeC ? 255 : 65535);
+  off = 0.0f;
+  if (spotMipKindNormal == job->kind) {
+    scl *= 2;
+    off = -1.0f;
+  }
+  ii = 0;
+#ifdef __SSE2__
+  {
+    __m128i zero = _mm_setzero_si128(), vi;
+    __m128 vscl = _mm_set1_ps(scl), voff = _mm_set1_ps(off);
+    for (; ii+4<=num; ii+=4) {
+      if (1 == img->sizeC) {
+        vi = _mm_cvtsi32_si128(*(const int *)(uc + ii));
+        vi = _mm_unpacklo_epi8(vi, zero);
+      } else {
+        vi = _mm_loadl_epi64((const __m128i *)(us + ii));
+      }
+      vi = _mm_unpacklo_epi16(vi, zero);
+      _mm_storeu_ps(out + ii, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(vi), vscl),
+                                         voff));
+    }
+  }
+#endif
+  for (; ii<num; ii++) {
+    out[ii] = (1 == img->sizeC ? uc[ii] : us[ii])*scl + off;
+  }
+  if (spotMipKindColor == job->kind) {
+    /* 16-bit color: no table, so convert from sRGB here */
+    alpha = _spotMipAlpha(sizeP);
+    for (ii=0; ii<num; ii++) {
+      cc = ii % sizeP;
+      if (cc != alpha) {
+        out[ii] = (float)_spotMipToLinear(out[ii]);
+      }
+    }
+  }
+  return;
+}
+
+/*
+** _spotMipHorz: each row of in (inX pixels) to a row of out (outX pixels)
+*/
+static void _spotMipHorz(void *_job, unsigned int row0, unsigned int row1) {
+  _spotMipJob *job = (_spotMipJob *)_job;
+  const _spotMipTaps *taps;
+  unsigned int yi, oi, ti, cc, sizeP, tapNum;
+  const unsigned int *idx;
+  const float *in, *wght;
+  float *out, sum;
+
+  taps = job->taps;
+  tapNum = taps->tapNum;
+  sizeP = job->img->sizeP;
+  for (yi=row0; yi<row1; yi++) {
+    in = job->in + (size_t)yi*job->inX*sizeP;
+    out = job->out + (size_t)yi*job->outX*sizeP;
+    for (oi=0; oi<taps->outSize; oi++) {
+      idx = taps->idx + tapNum*oi;
+      wght = taps->wght + tapNum*oi;
+      for (cc=0; cc<sizeP; cc++) {
+        sum = 0;
+        for (ti=0; ti<tapNum; ti++) {
+          sum += wght[ti]*in[cc + sizeP*idx[ti]];
+        }
+        out[cc + sizeP*oi] = sum;
+      }
+    }
+  }
+  return;
+}
+
+/*
+** _spotMipVert: rows of out as weighted sums of whole rows of in (both
+** outX pixels wide), which is where the SIMD goes
+*/
+static void _spotMipVert(void *_job, unsigned int row0, unsigned int row1) {
+  _spotMipJob *job = (_spotMipJob *)_job;
+  const _spotMipTaps *taps;
+  unsigned int yi, ti, tapNum;
+  size_t ii, num;
+  const unsigned int *idx;
+  const float *wght, *row;
+  float *out;
+
+  taps = job->taps;
+  tapNum = taps->tapNum;
+  num = (size_t)job->outX*job->img->sizeP;
+  for (yi=row0; yi<row1; yi++) {
+    idx = taps->idx + tapNum*yi;
+    wght = taps->wght + tapNum*yi;
+    out = job->out + num*yi;
+    row = job->in + num*idx[0];
+    ii = 0;
+#ifdef __AVX__
+    for (; ii+8<=num; ii+=8) {
+      __m256 acc = _mm256_mul_ps(_mm256_set1_ps(wght[0]),
+                                 _mm256_loadu_ps(job->in + num*idx[0] + ii));
+      for (ti=1; ti<tapNum; ti++) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(wght[ti]),
+                                               _mm256_loadu_ps(job->in + num*idx[ti]
+                                                               + ii)));
+      }
+      _mm256_storeu_ps(out + ii, acc);
+    }
+#endif
+#ifdef __SSE2__
+    for (; ii+4<=num; ii+=4) {
+      __m128 acc = _mm_mul_ps(_mm_set1_ps(wght[0]),
+                              _mm_loadu_ps(job->in + num*idx[0] + ii));
+      for (ti=1; ti<tapNum; ti++) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(wght[ti]),
+                                         _mm_loadu_ps(job->in + num*idx[ti] + ii)));
+      }
+      _mm_storeu_ps(out + ii, acc);
+    }
+#endif
+    for (; ii<num; ii++) {
+      out[ii] = wght[0]*row[ii];
+      for (ti=1; ti<tapNum; ti++) {
+        out[ii] += wght[ti]*job->in[num*idx[ti] + ii];
+      }
+    }
+  }
+  return;
+}
+
+/*
+** _spotMipEncode: renormalizes (normals in) rows of the float level in,
+** and converts them to the 8- or 16-bit img
+*/
+static void _spotMipEncode(void *_job, unsigned int row0, unsigned int row1) {
+  _spotMipJob *job = (_spotMipJob *)_job;
+  const spotImage *img;
+  unsigned int ii, pi, num, alpha, sizeP;
+  unsigned char *uc;
+  unsigned short *us;
+  float *in, maxv, len, vv;
+
+  img = job->img;
+  sizeP = img->sizeP;
+  num = (row1 - row0)*img->sizeX*sizeP;
+  /* the float level is in job->out, since the normals are fixed in place */
+  in = job->out + (size_t)row0*img->sizeX*sizeP;
+  uc = img->data.uc + (size_t)row0*img->sizeX*sizeP;
+  us = img->data.us + (size_t)row0*img->sizeX*sizeP;
+  maxv = 1 == img->sizeC ? 255.0f : 65535.0f;
+  if (spotMipKindNormal == job->kind && sizeP >= 3) {
+    /* renormalize, so the smaller levels don't have shorter normals, and
+       back to [0,1] (the next level is made from the renormalized ones) */
+    for (pi=0; pi<num; pi+=sizeP) {
+      len = sqrtf(in[pi+0]*in[pi+0] + in[pi+1]*in[pi+1] + in[pi+2]*in[pi+2]);
+      if (len > 0) {
+        SPOT_V3_SCALE(in + pi, 1.0f/len, in + pi);
+      } else {
+        SPOT_V3_SET(in + pi, 0.0f, 0.0f, 1.0f);
+      }
+    }
+  }
+  alpha = _spotMipAlpha(sizeP);
+  ii = 0;
+  if (spotMipKindColor != job->kind) {
+#ifdef __SSE2__
+    __m128 vscl, voff, vmax, zero;
+    __m128i vi, bias;
+    zero = _mm_setzero_ps();
+    vmax = _mm_set1_ps(maxv);
+    if (spotMipKindNormal == job->kind) {
+      vscl = _mm_set1_ps(maxv/2);
+      voff = _mm_set1_ps(maxv/2 + 0.5f);
+    } else {
+      vscl = _mm_set1_ps(maxv);
+      voff = _mm_set1_ps(0.5f);
+    }
+    bias = _mm_set1_epi32(32768);
+    for (; ii+4<=num; ii+=4) {
+      __m128 vv4 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + ii), vscl), voff);
+      vv4 = _mm_min_ps(_mm_max_ps(vv4, zero), _mm_add_ps(vmax, _mm_set1_ps(0.49f)));
+      vi = _mm_cvttps_epi32(vv4);
+      if (1 == img->sizeC) {
+        vi = _mm_packs_epi32(vi, vi);
+        vi = _mm_packus_epi16(vi, vi);
+        *(int *)(uc + ii) = _mm_cvtsi128_si32(vi);
+      } else {
+        /* no unsigned 32-to-16 pack in SSE2: shift into signed range */
+        vi = _mm_packs_epi32(_mm_sub_epi32(vi, bias), _mm_sub_epi32(vi, bias));
+        vi = _mm_xor_si128(vi, _mm_set1_epi16((short)0x8000));
+        _mm_storel_epi64((__m128i *)(us + ii), vi);
+      }
+    }
+#endif
+  }
+  for (; ii<num; ii++) {
+    vv = in[ii];
+    if (spotMipKindNormal == job->kind) {
+      vv = (vv + 1)/2;
+    } else if (spotMipKindColor == job->kind && ii % sizeP != alpha) {
+      vv = (float)_spotMipToSRGB(SPOT_CLAMP(0.0f, vv, 1.0f));
+    }
+    vv = SPOT_CLAMP(0.0f, vv, 1.0f)*maxv + 0.5f;
+    if (1 == img->sizeC) {
+      uc[ii] = (unsigned char)vv;
+    } else {
+      us[ii] = (unsigned short)vv;
+    }
+  }
+  return;
+}
+
+unsigned int spotImageMipLevelNum(const spotImage *img) {
+  unsigned int num, sx, sy;
+
+  num = 1;
+  for (sx=img->sizeX, sy=img->sizeY; sx > 1 || sy > 1; num++) {
+    sx = SPOT_MAX(1, sx/2);
+    sy = SPOT_MAX(1, sy/2);
+  }
+  return num;
+}
+
+double spotImageMipCost(const spotImage *img, int filter) {
+  double cost, sx, sy;
+
+  cost = 0;
+  for (sx=img->sizeX, sy=img->sizeY; sx > 1 || sy > 1; ) {
+    /* horizontal pass makes (sx/2)*sy, vertical (sx/2)*(sy/2), samples */
+    cost += (sx > 1 ? _spotMipTapNum(filter)*(sx/2)*sy : 0);
+    sx = SPOT_MAX(1, sx/2);
+    cost += (sy > 1 ? _spotMipTapNum(filter)*sx*(sy/2) : 0);
+    sy = SPOT_MAX(1, sy/2);
+  }
+  return cost*img->sizeP;
+}
+
+/*
+** _spotMipGLInit: spotImageMipGLInit, or with non-NULL arr,
+** spotImageArrayMipGLInit for its layer layer
+*/
+static int _spotMipGLInit(spotImage *img, int filter, int kind,
+                          spotImageArray *arr, unsigned int layer) {
+  const char me[]="spotImageMipGLInit";
+  _spotMipTaps tapsX, tapsY;
+  _spotMipJob job;
+  spotImage level;
+  float *cur, *tmp, *next;
+  void *blocks;
+  unsigned int li, levelNum;
+  GLint dataFormat;
+  GLenum type;
+
+  if (!img) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  if (!( img->data.v && (arr ? arr->textureId : img->textureId) )) {
+    spotErrorAdd("%s: image needs data (%p) and texture (%u)", me,
+                 img->data.v, arr ? arr->textureId : img->textureId);
+    return 1;
+  }
+  if (arr && !( layer < arr->layerNum && img->sizeX == arr->sizeX
+                && img->sizeY == arr->sizeY && !img->bcFormat )) {
+    spotErrorAdd("%s: image (%u x %u) doesn't fit layer %u of %u x %u x %u array",
+                 me, img->sizeX, img->sizeY, layer, arr->sizeX, arr->sizeY,
+                 arr->layerNum);
+    return 1;
+  }
+  if (!( spotMipFilterBox <= filter && filter <= spotMipFilterLanczos )) {
+    spotErrorAdd("%s: filter %d not valid", me, filter);
+    return 1;
+  }
+  if (!( spotMipKindLinear <= kind && kind <= spotMipKindNormal )) {
+    spotErrorAdd("%s: kind %d not valid", me, kind);
+    return 1;
+  }
+  switch (img->sizeP) {
+  case 1: dataFormat = GL_RED; break;
+  case 2: dataFormat = GL_RG; break;
+  case 3: dataFormat = GL_RGB; break;
+  default: dataFormat = GL_RGBA; break;
+  }
+  type = (1 == img->sizeC
+          ? GL_UNSIGNED_BYTE
+          : GL_UNSIGNED_SHORT);
+  pthread_once(&_spotMipOnce, _spotMipTableInit);
+
+  /* level 1 is the biggest of the levels made here; those to be block
+     compressed are made 8-bit, which is all the blocks can hold */
+  level.sizeC = img->bcFormat ? 1 : img->sizeC;
+  level.sizeP = img->sizeP;
+  level.data.v = malloc((size_t)SPOT_MAX(1, img->sizeX/2)*SPOT_MAX(1, img->sizeY/2)
+                        *img->sizeP*img->sizeC);
+  cur = (float *)malloc((size_t)img->sizeX*img->sizeY*img->sizeP*sizeof(float));
+  tmp = (float *)malloc((size_t)SPOT_MAX(1, img->sizeX/2)*img->sizeY*img->sizeP
+                        *sizeof(float));
+  next = (float *)malloc((size_t)SPOT_MAX(1, img->sizeX/2)*SPOT_MAX(1, img->sizeY/2)
+                         *img->sizeP*sizeof(float));
+  /* a block compressed image has each level encoded as it is made */
+  blocks = (img->bcFormat
+            ? malloc(spotBCSize(img->bcFormat, SPOT_MAX(1, img->sizeX/2),
+                                SPOT_MAX(1, img->sizeY/2)))
+            : NULL);
+  if (!( level.data.v && cur && tmp && next
+         && (blocks || !img->bcFormat) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    free(level.data.v); free(cur); free(tmp); free(next); free(blocks);
+    return 1;
+  }
+  job.kind = kind;
+  job.img = img;
+  job.out = cur;
+  spotParallel(_spotMipDecode, &job, img->sizeY,
+               (size_t)img->sizeX*img->sizeY*img->sizeP);
+
+  levelNum = spotImageMipLevelNum(img);
+  level.sizeX = img->sizeX;
+  level.sizeY = img->sizeY;
+  if (arr) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arr->textureId);
+  } else {
+    glBindTexture(GL_TEXTURE_2D, img->textureId);
+  }
+  /* rows of the smallest levels are only a few bytes */
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  /* so that _spotMipTapsDone is safe on both, even when only tapsX (or
+     neither) has been set; it leaves them this way again */
+  tapsX.idx = tapsY.idx = NULL;
+  tapsX.wght = tapsY.wght = NULL;
+  for (li=1; li<levelNum; li++) {
+    float *swap;
+    if (_spotMipTapsSet(&tapsX, level.sizeX, filter)
+        || _spotMipTapsSet(&tapsY, level.sizeY, filter)) {
+      spotErrorAdd("%s: allocation failure", me);
+      _spotMipTapsDone(&tapsX); _spotMipTapsDone(&tapsY);
+      break;
+    }
+    job.in = cur;
+    job.out = tmp;
+    job.taps = &tapsX;
+    job.inX = level.sizeX;
+    job.outX = tapsX.outSize;
+    spotParallel(_spotMipHorz, &job, level.sizeY,
+                 (size_t)tapsX.outSize*level.sizeY*img->sizeP*tapsX.tapNum);
+    job.in = tmp;
+    job.out = next;
+    job.taps = &tapsY;
+    job.inX = job.outX;
+    spotParallel(_spotMipVert, &job, tapsY.outSize,
+                 (size_t)tapsX.outSize*tapsY.outSize*img->sizeP*tapsY.tapNum);
+    level.sizeX = tapsX.outSize;
+    level.sizeY = tapsY.outSize;
+    job.img = &level;
+    spotParallel(_spotMipEncode, &job, level.sizeY,
+                 (size_t)level.sizeX*level.sizeY*img->sizeP);
+    job.img = img;
+    if (blocks) {
+      if (spotBCEncode(blocks, img->bcFormat, level.data.uc, level.sizeP,
+                       level.sizeX, level.sizeY)) {
+        spotErrorAdd("%s: couldn't encode level %u", me, li);
+        _spotMipTapsDone(&tapsX); _spotMipTapsDone(&tapsY);
+        break;
+      }
+      glCompressedTexImage2D(GL_TEXTURE_2D, li, spotBCGLFormat(img->bcFormat),
+                             level.sizeX, level.sizeY, 0,
+                             (GLsizei)spotBCSize(img->bcFormat, level.sizeX,
+                                                 level.sizeY), blocks);
+    } else if (arr) {
+      /* all the levels were allocated by spotImageArrayGLInit */
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, li, 0, 0, layer, level.sizeX,
+                      level.sizeY, 1, dataFormat, type, level.data.v);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, li, spotImageGLInternalFormat(img),
+                   level.sizeX, level.sizeY, 0, dataFormat, type, level.data.v);
+    }
+    _spotMipTapsDone(&tapsX);
+    _spotMipTapsDone(&tapsY);
+    /* the next level is made from this one */
+    swap = cur; cur = next; next = swap;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  if (arr) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  } else {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, li-1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  free(level.data.v);
+  free(cur);
+  free(tmp);
+  free(next);
+  free(blocks);
+  return li < levelNum;
+}
+
+int spotImageMipGLInit(spotImage *img, int filter, int kind) {
+
+  return _spotMipGLInit(img, filter, kind, NULL, 0);
+}
+
+int spotImageArrayMipGLInit(spotImageArray *arr, unsigned int layer,
+                            spotImage *img, int filter, int kind) {
+  const char me[]="spotImageArrayMipGLInit";
+
+  if (!arr) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  return _spotMipGLInit(img, filter, kind, arr, layer);
+}
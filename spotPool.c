@@ -0,0 +1,179 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+/* marks the end of the free slot list */
+#define FREE_END 0xffffffffu
+
+/*
+** _spotPoolGrow: makes sure there is room for at least one more live item
+** and one more slot, doubling allocations as needed.  Only the bookkeeping
+** arrays move; the items themselves are never touched.
+*/
+static int _spotPoolGrow(spotPool *pool) {
+  const char me[]="_spotPoolGrow";
+  unsigned int newCap;
+  void **newItem;
+  spotHandle *newHandle;
+  unsigned int *newGen, *newIndx;
+
+  if (pool->num == pool->cap) {
+    newCap = pool->cap ? 2*pool->cap : 4;
+    newItem = (void **)realloc(pool->item, newCap*sizeof(void*));
+    if (!newItem) {
+      spotErrorAdd("%s: couldn't grow to %u items", me, newCap);
+      return 1;
+    }
+    pool->item = newItem;
+    newHandle = (spotHandle *)realloc(pool->handle, newCap*sizeof(spotHandle));
+    if (!newHandle) {
+      spotErrorAdd("%s: couldn't grow to %u handles", me, newCap);
+      return 1;
+    }
+    pool->handle = newHandle;
+    pool->cap = newCap;
+  }
+  if (FREE_END == pool->freeSlot && pool->slotNum == pool->slotCap) {
+    if (pool->slotCap > SPOT_HANDLE_SLOT_MAX/2) {
+      spotErrorAdd("%s: already have %u slots", me, pool->slotCap);
+      return 1;
+    }
+    newCap = pool->slotCap ? 2*pool->slotCap : 4;
+    newGen = (unsigned int *)realloc(pool->gen, newCap*sizeof(unsigned int));
+    if (!newGen) {
+      spotErrorAdd("%s: couldn't grow to %u slots", me, newCap);
+      return 1;
+    }
+    pool->gen = newGen;
+    newIndx = (unsigned int *)realloc(pool->indx, newCap*sizeof(unsigned int));
+    if (!newIndx) {
+      spotErrorAdd("%s: couldn't grow to %u slots", me, newCap);
+      return 1;
+    }
+    pool->indx = newIndx;
+    pool->slotCap = newCap;
+  }
+  return 0;
+}
+
+spotPool *spotPoolNew(unsigned int capHint) {
+  const char me[]="spotPoolNew";
+  spotPool *pool;
+
+  pool = (spotPool *)calloc(1, sizeof(spotPool));
+  if (!pool) {
+    spotErrorAdd("%s: allocation failure", me);
+    return NULL;
+  }
+  pool->freeSlot = FREE_END;
+  if (capHint) {
+    pool->item = (void **)calloc(capHint, sizeof(void*));
+    pool->handle = (spotHandle *)calloc(capHint, sizeof(spotHandle));
+    pool->gen = (unsigned int *)calloc(capHint, sizeof(unsigned int));
+    pool->indx = (unsigned int *)calloc(capHint, sizeof(unsigned int));
+    if (!( pool->item && pool->handle && pool->gen && pool->indx )) {
+      spotErrorAdd("%s: couldn't allocate for %u items", me, capHint);
+      return spotPoolNix(pool);
+    }
+    pool->cap = pool->slotCap = capHint;
+  }
+  return pool;
+}
+
+spotHandle spotPoolAdd(spotPool *pool, void *item) {
+  const char me[]="spotPoolAdd";
+  unsigned int slot;
+
+  if (!( pool && item )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)pool, item);
+    return SPOT_HANDLE_NONE;
+  }
+  if (_spotPoolGrow(pool)) {
+    spotErrorAdd("%s: couldn't make room", me);
+    return SPOT_HANDLE_NONE;
+  }
+  if (FREE_END != pool->freeSlot) {
+    /* re-use the most recently freed slot; its generation was already
+       bumped when it was freed */
+    slot = pool->freeSlot;
+    pool->freeSlot = pool->indx[slot];
+  } else {
+    slot = pool->slotNum++;
+    pool->gen[slot] = 1;
+  }
+  pool->indx[slot] = pool->num;
+  pool->item[pool->num] = item;
+  pool->handle[pool->num] = SPOT_HANDLE(pool->gen[slot], slot);
+  return pool->handle[pool->num++];
+}
+
+void *spotPoolGet(const spotPool *pool, spotHandle hh) {
+  unsigned int slot;
+
+  if (!pool || SPOT_HANDLE_NONE == hh) {
+    return NULL;
+  }
+  slot = SPOT_HANDLE_SLOT(hh);
+  if (slot >= pool->slotNum || pool->gen[slot] != SPOT_HANDLE_GEN(hh)) {
+    /* never handed out, or freed since */
+    return NULL;
+  }
+  return pool->item[pool->indx[slot]];
+}
+
+void *spotPoolItem(const spotPool *pool, unsigned int ii) {
+
+  return (pool && ii < pool->num) ? pool->item[ii] : NULL;
+}
+
+void *spotPoolRemove(spotPool *pool, spotHandle hh) {
+  unsigned int slot, ii, last;
+  void *ret;
+
+  if (!( ret = spotPoolGet(pool, hh) )) {
+    return NULL;
+  }
+  slot = SPOT_HANDLE_SLOT(hh);
+  ii = pool->indx[slot];
+  /* keep live items dense: move the last one into the hole */
+  last = pool->num - 1;
+  if (ii != last) {
+    pool->item[ii] = pool->item[last];
+    pool->handle[ii] = pool->handle[last];
+    pool->indx[SPOT_HANDLE_SLOT(pool->handle[ii])] = ii;
+  }
+  pool->num--;
+  /* invalidate outstanding handles to this slot, skipping generation 0 so
+     that no valid handle is ever equal to SPOT_HANDLE_NONE */
+  pool->gen[slot] = (pool->gen[slot] + 1) & SPOT_HANDLE_GEN_MAX;
+  if (!pool->gen[slot]) {
+    pool->gen[slot] = 1;
+  }
+  pool->indx[slot] = pool->freeSlot;
+  pool->freeSlot = slot;
+  return ret;
+}
+
+spotPool *spotPoolNix(spotPool *pool) {
+
+  if (pool) {
+    free(pool->item);
+    free(pool->handle);
+    free(pool->gen);
+    free(pool->indx);
+    free(pool);
+  }
+  return NULL;
+}
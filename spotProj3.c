@@ -28,64 +28,190 @@
    (m2)[7] = -_SPOT_M2_DET(m1,0,1,6,7), \
    (m2)[8] =  _SPOT_M2_DET(m1,0,1,3,4))
 
+/* makes img->textureId a new (bound) cube map texture, with the parameters
+   of all our cube maps */
+static void _spotCubeMapTexNew(spotImage *img) {
 
-static int isPowerOfTwo(unsigned int x) {
-  return ((x != 0) && !(x & (x - 1)));
+  glGenTextures(1, &(img->textureId));
+  glBindTexture(GL_TEXTURE_CUBE_MAP, img->textureId);
+  /* courtesy http://www.opengl.org/wiki/Common_Mistakes */
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR); 
+  return;
 }
 
 int spotImageCubeMapGLInit(spotImage *img) {
   const char me[]="spotImageCubeMapGLInit";
-  unsigned int sizeY, sizeImage;
-  GLenum type;
+  const unsigned char *pixels;
+  unsigned int sizeY, sizeImage, fi;
+  GLenum type, internalFormat;
 
   if (3 != img->sizeP) {
     spotErrorAdd("%s: can only handle RGB cube map images (not sizeP %u)", 
                  me, img->sizeP);
     return 1;
   }
-  if (!isPowerOfTwo(img->sizeX)) {
-    spotErrorAdd("%s: image X dimension %u not power of two", me, img->sizeX);
-    return 1;
-  }
   sizeY = img->sizeY/6; /* actual size along Y */
-  if (!( img->sizeY == 6*sizeY && isPowerOfTwo(sizeY) )) {
+  /* the faces can be any size, as long as they're square */
+  if (!( img->sizeY == 6*sizeY && sizeY == img->sizeX )) {
     spotErrorAdd("%s: image Y dimension %u not multiple of 6, "
-                 "or %u/6=%u not power of two", me, img->sizeY, 
-                 img->sizeY, sizeY);
+                 "or %u/6=%u not X dimension %u", me, img->sizeY, 
+                 img->sizeY, sizeY, img->sizeX);
+    return 1;
+  }
+  if (img->bcFormat && sizeY % 4) {
+    /* else the blocks of one face would run into the next */
+    spotErrorAdd("%s: can't compress faces of height %u", me, sizeY);
     return 1;
   }
 
+  if (spotImageGLUnpackBegin(img, &pixels)) {
+    spotErrorAdd("%s: couldn't get pixel data", me);
+    return 1;
+  }
   type = (1 == img->sizeC
           ? GL_UNSIGNED_BYTE
           : GL_UNSIGNED_SHORT);
-  glGenTextures(1, &(img->textureId));
-  glBindTexture(GL_TEXTURE_CUBE_MAP, img->textureId);
-  /* courtesy http://www.opengl.org/wiki/Common_Mistakes */
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR); 
+  internalFormat = spotImageGLInternalFormat(img);
+  _spotCubeMapTexNew(img);
 
+  if (img->bcFormat) {
+    /* the faces follow one another in the blocks as in the pixels, and
+       the face targets are consecutive, in the same +X,-X,+Y,-Y,+Z,-Z order */
+    sizeImage = (unsigned int)spotBCSize(img->bcFormat, img->sizeX, sizeY);
+    for (fi=0; fi<6; fi++) {
+      glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + fi, 0,
+                             spotBCGLFormat(img->bcFormat), img->sizeX, sizeY,
+                             0, sizeImage, pixels + fi*sizeImage);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    spotImageGLUnpackEnd(img);
+    return 0;
+  }
   sizeImage = (img->sizeC)*(img->sizeP)*(img->sizeX)*sizeY;
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGBA8, img->sizeX, sizeY,
-               0, GL_RGB, type, img->data.uc + 0*sizeImage);
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGBA8, img->sizeX, sizeY,
-               0, GL_RGB, type, img->data.uc + 1*sizeImage);
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGBA8, img->sizeX, sizeY,
-               0, GL_RGB, type, img->data.uc + 2*sizeImage);
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGBA8, img->sizeX, sizeY,
-               0, GL_RGB, type, img->data.uc + 3*sizeImage);
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGBA8, img->sizeX, sizeY,
-               0, GL_RGB, type, img->data.uc + 4*sizeImage);
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGBA8, img->sizeX, sizeY,
-               0, GL_RGB, type, img->data.uc + 5*sizeImage);
+  /* RGB rows of non-power-of-two faces needn't be a multiple of 4 bytes */
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, internalFormat, img->sizeX, sizeY,
+               0, GL_RGB, type, pixels + 0*sizeImage);
+  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, internalFormat, img->sizeX, sizeY,
+               0, GL_RGB, type, pixels + 1*sizeImage);
+  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, internalFormat, img->sizeX, sizeY,
+               0, GL_RGB, type, pixels + 2*sizeImage);
+  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, internalFormat, img->sizeX, sizeY,
+               0, GL_RGB, type, pixels + 3*sizeImage);
+  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, internalFormat, img->sizeX, sizeY,
+               0, GL_RGB, type, pixels + 4*sizeImage);
+  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, internalFormat, img->sizeX, sizeY,
+               0, GL_RGB, type, pixels + 5*sizeImage);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
   glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  spotImageGLUnpackEnd(img);
 
   return 0;
 }
 
+int spotImageCubeMapFacesGLInit(spotImage *img, const char *const fname[6]) {
+  const char me[]="spotImageCubeMapFacesGLInit";
+  spotImage *face[6];
+  spotImageLoad *load[6];
+  const unsigned char *pixels;
+  unsigned int fi, size, bad;
+  GLenum type;
+
+  if (!( img && fname )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)img, (void*)fname);
+    return 1;
+  }
+  if (img->textureId) {
+    spotErrorAdd("%s: image already has texture %u", me, img->textureId);
+    return 1;
+  }
+  /* start decoding all six before waiting for any */
+  bad = 0;
+  for (fi=0; fi<6; fi++) {
+    load[fi] = NULL;
+    if (!( face[fi] = spotImageNew() )) {
+      spotErrorAdd("%s: couldn't allocate face %u", me, fi);
+      bad = 1; continue;
+    }
+    face[fi]->bcFormat = img->bcFormat;
+    if (!( load[fi] = spotImageLoadPNGAsync(face[fi], fname[fi], NULL) )) {
+      spotErrorAdd("%s: couldn't start loading \"%s\"", me, fname[fi]);
+      bad = 1;
+    }
+  }
+  for (fi=0; fi<6; fi++) {
+    if (load[fi] && spotImageLoadWait(load[fi])) {
+      spotErrorAdd("%s: trouble loading \"%s\"", me, fname[fi]);
+      bad = 1;
+    }
+  }
+  size = bad ? 0 : face[0]->sizeX;
+  for (fi=0; !bad && fi<6; fi++) {
+    if (!( 3 == face[fi]->sizeP && face[0]->sizeC == face[fi]->sizeC )) {
+      spotErrorAdd("%s: \"%s\" isn't RGB with %u-bit channels like \"%s\"",
+                   me, fname[fi], 8*face[0]->sizeC, fname[0]);
+      bad = 1;
+    } else if (!( size == face[fi]->sizeX && size == face[fi]->sizeY )) {
+      spotErrorAdd("%s: \"%s\" is %u x %u, not %u x %u like \"%s\"", me,
+                   fname[fi], face[fi]->sizeX, face[fi]->sizeY, size, size,
+                   fname[0]);
+      bad = 1;
+    }
+  }
+  if (!bad && img->bcFormat && size % 4) {
+    spotErrorAdd("%s: can't compress faces of size %u", me, size);
+    bad = 1;
+  }
+
+  if (!bad) {
+    type = (1 == face[0]->sizeC
+            ? GL_UNSIGNED_BYTE
+            : GL_UNSIGNED_SHORT);
+    _spotCubeMapTexNew(img);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    /* each face goes up straight from where it was decoded to; the face
+       targets are consecutive, in the same +X,-X,+Y,-Y,+Z,-Z order */
+    for (fi=0; !bad && fi<6; fi++) {
+      if (spotImageGLUnpackBegin(face[fi], &pixels)) {
+        spotErrorAdd("%s: couldn't get pixel data of \"%s\"", me, fname[fi]);
+        bad = 1; continue;
+      }
+      if (img->bcFormat) {
+        glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + fi, 0,
+                               spotBCGLFormat(img->bcFormat), size, size, 0,
+                               (GLsizei)spotBCSize(img->bcFormat, size, size),
+                               pixels);
+      } else {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + fi, 0,
+                     spotImageGLInternalFormat(face[0]), size, size, 0,
+                     GL_RGB, type, pixels);
+      }
+      spotImageGLUnpackEnd(face[fi]);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    if (bad) {
+      glDeleteTextures(1, &(img->textureId));
+      img->textureId = 0;
+    } else {
+      /* the sizes of the tall image that the faces would have made */
+      img->sizeC = face[0]->sizeC;
+      img->sizeP = 3;
+      img->sizeX = size;
+      img->sizeY = 6*size;
+    }
+  }
+  for (fi=0; fi<6; fi++) {
+    spotImageNix(face[fi]);
+  }
+  return bad;
+}
+
 int spotGeomTransform(spotGeom *sgeom, const GLfloat vertXform[16]) {
   const char me[]="spotGeomTransform";
   GLfloat tangXform[9], normXform[9];
@@ -131,3 +257,58 @@ int spotGeomColorRGB(spotGeom *sgeom, const GLfloat RGB[3]) {
   
   return 0;
 }
+
+spotProgramJob *spotProj3ProgramSubmitTo(GLuint program,
+                                         const char *const *defines,
+                                         const char *vertFname,
+                                         const char *fragFname) {
+
+  return spotProgramSubmitTo(program, defines, vertFname, fragFname,
+                             "vertPos", spotVertAttrIndx_xyz,
+                             "vertNorm", spotVertAttrIndx_norm,
+                             "vertTex2", spotVertAttrIndx_tex2,
+                             "vertRgb", spotVertAttrIndx_rgb,
+                             "vertTang", spotVertAttrIndx_tang,
+                             /* input name, attribute index pairs
+                                MUST BE TERMINATED with NULL */
+                             NULL);
+}
+
+void spotProj3ProgramLinked(GLuint program) {
+  GLuint block;
+  GLint loc;
+
+  /* the irradiance is the same for all programs, so they all read it from
+     one buffer */
+  block = glGetUniformBlockIndex(program, "Irradiance");
+  if (GL_INVALID_INDEX != block) {
+    glUniformBlockBinding(program, block, SPOT_PROJ3_IRRADIANCE_BINDING);
+  }
+  /* sampler units are state of the program, so they're set once here */
+  glUseProgram(program);
+  if (-1 != (loc = glGetUniformLocation(program, "cubeMap"))) {
+    glUniform1i(loc, spotProj3Unit_cubeMap);
+  }
+  if (-1 != (loc = glGetUniformLocation(program, "samplerA"))) {
+    glUniform1i(loc, spotProj3Unit_samplerA);
+  }
+  if (-1 != (loc = glGetUniformLocation(program, "samplerB"))) {
+    glUniform1i(loc, spotProj3Unit_samplerB);
+  }
+  if (-1 != (loc = glGetUniformLocation(program, "samplerArray"))) {
+    glUniform1i(loc, spotProj3Unit_samplerArray);
+  }
+  return;
+}
+
+GLuint spotProj3IrradianceNew(GLsizeiptr size, const GLvoid *data,
+                              GLenum usage) {
+  GLuint buff;
+
+  glGenBuffers(1, &buff);
+  glBindBuffer(GL_UNIFORM_BUFFER, buff);
+  glBufferData(GL_UNIFORM_BUFFER, size, data, usage);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, SPOT_PROJ3_IRRADIANCE_BINDING, buff);
+  return buff;
+}
@@ -0,0 +1,216 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+/* how long (in nanoseconds) to wait for the GPU at a time, before
+   checking again */
+#define WAIT_NS 1000000000
+
+spotStream *spotStreamNew(GLsizeiptr regionSize, unsigned int regionNum) {
+  const char me[]="spotStreamNew";
+  spotStream *ss;
+
+  if (!( regionSize > 0 && regionNum > 0 )) {
+    spotErrorAdd("%s: got bad region size %ld or count %u", me,
+                 (long)regionSize, regionNum);
+    return NULL;
+  }
+  ss = (spotStream *)calloc(1, sizeof(spotStream));
+  if (!ss) {
+    spotErrorAdd("%s: allocation failure", me);
+    return NULL;
+  }
+  ss->fence = (GLsync *)calloc(regionNum, sizeof(GLsync));
+  if (!ss->fence) {
+    spotErrorAdd("%s: couldn't allocate %u fences", me, regionNum);
+    free(ss); return NULL;
+  }
+  ss->regionSize = SPOT_ALIGN_UP(regionSize);
+  ss->regionNum = regionNum;
+  ss->region = 0;
+  ss->used = 0;
+  glGenBuffers(1, &(ss->buffId));
+  glBindBuffer(GL_ARRAY_BUFFER, ss->buffId);
+  /* allocated once here, and never again */
+  glBufferData(GL_ARRAY_BUFFER, ss->regionSize*regionNum, NULL,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return ss;
+}
+
+void *spotStreamMap(spotStream *ss, GLsizeiptr size, GLintptr *offset) {
+  const char me[]="spotStreamMap";
+  void *ret;
+
+  if (!( ss && offset )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)ss, (void*)offset);
+    return NULL;
+  }
+  size = SPOT_ALIGN_UP(size);
+  if (ss->used + size > ss->regionSize) {
+    spotErrorAdd("%s: %ld more bytes won't fit in this frame's %ld-byte "
+                 "region (%ld already used)", me, (long)size,
+                 (long)ss->regionSize, (long)ss->used);
+    return NULL;
+  }
+  *offset = ss->region*ss->regionSize + ss->used;
+  glBindBuffer(GL_ARRAY_BUFFER, ss->buffId);
+  /* No need for the driver to synchronize: spotStreamFrameEnd has already
+     waited until the GPU is done with this region */
+  ret = glMapBufferRange(GL_ARRAY_BUFFER, *offset, size,
+                         (GL_MAP_WRITE_BIT
+                          | GL_MAP_UNSYNCHRONIZED_BIT
+                          | GL_MAP_INVALIDATE_RANGE_BIT));
+  if (!ret) {
+    spotErrorAdd("%s: glMapBufferRange failed: %s", me,
+                 spotGLErrorString(glGetError()));
+    return NULL;
+  }
+  ss->used += size;
+  return ret;
+}
+
+int spotStreamUnmap(spotStream *ss) {
+  const char me[]="spotStreamUnmap";
+
+  if (!ss) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, ss->buffId);
+  if (GL_TRUE != glUnmapBuffer(GL_ARRAY_BUFFER)) {
+    spotErrorAdd("%s: buffer contents were lost", me);
+    return 1;
+  }
+  return 0;
+}
+
+int spotStreamPush(spotStream *ss, const void *data, GLsizeiptr size,
+                   GLintptr *offset) {
+  const char me[]="spotStreamPush";
+  void *mem;
+
+  if (!( mem = spotStreamMap(ss, size, offset) )) {
+    spotErrorAdd("%s: couldn't map %ld bytes", me, (long)size);
+    return 1;
+  }
+  memcpy(mem, data, size);
+  if (spotStreamUnmap(ss)) {
+    spotErrorAdd("%s: problem unmapping", me);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+** _spotStreamWait: waits until the GPU is done with region ri (if it was
+** used), and forgets its fence
+*/
+static int _spotStreamWait(spotStream *ss, unsigned int ri) {
+  const char me[]="_spotStreamWait";
+  GLenum ret;
+
+  if (!ss->fence[ri]) {
+    return 0;
+  }
+  do {
+    ret = glClientWaitSync(ss->fence[ri], GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_NS);
+  } while (GL_TIMEOUT_EXPIRED == ret);
+  glDeleteSync(ss->fence[ri]);
+  ss->fence[ri] = 0;
+  if (GL_WAIT_FAILED == ret) {
+    spotErrorAdd("%s: waiting on region %u failed: %s", me, ri,
+                 spotGLErrorString(glGetError()));
+    return 1;
+  }
+  return 0;
+}
+
+int spotStreamGrow(spotStream *ss, GLsizeiptr regionSize) {
+  const char me[]="spotStreamGrow";
+  unsigned int ri;
+  int bad;
+
+  if (!ss) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  regionSize = SPOT_ALIGN_UP(regionSize);
+  if (regionSize <= ss->regionSize) {
+    return 0;
+  }
+  if (ss->used) {
+    spotErrorAdd("%s: can't grow in the middle of a frame", me);
+    return 1;
+  }
+  /* the GPU may still be reading any region; the data in them is dead
+     after this anyway, since it's re-sent every frame */
+  bad = 0;
+  for (ri=0; ri<ss->regionNum; ri++) {
+    bad |= _spotStreamWait(ss, ri);
+  }
+  if (bad) {
+    spotErrorAdd("%s: trouble waiting for GPU", me);
+    return 1;
+  }
+  ss->regionSize = regionSize;
+  ss->region = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, ss->buffId);
+  glBufferData(GL_ARRAY_BUFFER, ss->regionSize*ss->regionNum, NULL,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return 0;
+}
+
+int spotStreamFrameEnd(spotStream *ss) {
+  const char me[]="spotStreamFrameEnd";
+
+  if (!ss) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 1;
+  }
+  if (!ss->used) {
+    /* nothing written this frame, so nothing for the GPU to be done with;
+       the same region is used next time */
+    return 0;
+  }
+  /* mark where the GPU's reading of this frame's region will be done */
+  ss->fence[ss->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ss->region = (ss->region + 1) % ss->regionNum;
+  ss->used = 0;
+  /* with enough regions this is normally already signaled, so it only
+     blocks if the CPU gets regionNum frames ahead of the GPU */
+  if (_spotStreamWait(ss, ss->region)) {
+    spotErrorAdd("%s: trouble with region %u", me, ss->region);
+    return 1;
+  }
+  return 0;
+}
+
+spotStream *spotStreamNix(spotStream *ss) {
+  unsigned int ii;
+
+  if (ss) {
+    for (ii=0; ii<ss->regionNum; ii++) {
+      if (ss->fence[ii]) {
+        glDeleteSync(ss->fence[ii]);
+      }
+    }
+    glDeleteBuffers(1, &(ss->buffId));
+    free(ss->fence);
+    free(ss);
+  }
+  return NULL;
+}
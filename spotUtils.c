@@ -15,11 +15,18 @@
 #include "spot.h"
 
 #include <sys/time.h>  /* for time functions */
+#include <sys/stat.h>  /* for mkdir */
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>    /* for sysconf */
 
 #define PLENTY_BIG_WE_HOPE 2048
 
 static char **_spotError = NULL;
 static unsigned int _spotErrorNum = 0;
+/* guards _spotError and _spotErrorNum, since errors can be added by
+   threads other than the one that prints them (e.g. spotImageLoadPNGAsync) */
+static pthread_mutex_t _spotErrorLock = PTHREAD_MUTEX_INITIALIZER;
 
 /*
 ** returns current time in seconds (with millisecond resolution) as a double
@@ -139,6 +146,62 @@ char *spotStrdup(const char *s) {
   return ret;
 }
 
+/* spotParallel ranges with less work than this aren't worth a thread */
+#define PARALLEL_WORK (1 << 16)
+
+typedef struct {
+  void (*func)(void *data, unsigned int row0, unsigned int row1);
+  void *data;
+  unsigned int row0, row1;
+} _spotParallelRange;
+
+static void *_spotParallelMain(void *arg) {
+  _spotParallelRange *range;
+
+  range = (_spotParallelRange *)arg;
+  range->func(range->data, range->row0, range->row1);
+  return NULL;
+}
+
+void spotParallel(void (*func)(void *data, unsigned int row0, unsigned int row1),
+                  void *data, unsigned int rowNum, size_t work) {
+  pthread_t thread[SPOT_PARALLEL_MAX];
+  _spotParallelRange range[SPOT_PARALLEL_MAX];
+  unsigned int ti, threadNum, started;
+  long cores;
+
+  if (!rowNum) {
+    return;
+  }
+  cores = sysconf(_SC_NPROCESSORS_ONLN);
+  threadNum = (unsigned int)SPOT_CLAMP(1, cores, SPOT_PARALLEL_MAX);
+  threadNum = SPOT_MIN(threadNum, (unsigned int)SPOT_MIN(work/PARALLEL_WORK + 1,
+                                                         SPOT_PARALLEL_MAX));
+  threadNum = SPOT_MIN(threadNum, rowNum);
+  for (ti=0; ti<threadNum; ti++) {
+    range[ti].func = func;
+    range[ti].data = data;
+    range[ti].row0 = (unsigned int)((size_t)rowNum*ti/threadNum);
+    range[ti].row1 = (unsigned int)((size_t)rowNum*(ti+1)/threadNum);
+  }
+  started = 1;
+  for (ti=1; ti<threadNum; ti++) {
+    if (pthread_create(thread + ti, NULL, _spotParallelMain, range + ti)) {
+      break;
+    }
+    started++;
+  }
+  _spotParallelMain(range + 0);
+  for (ti=1; ti<started; ti++) {
+    pthread_join(thread[ti], NULL);
+  }
+  /* any range whose thread couldn't be started is done here */
+  for (ti=started; ti<threadNum; ti++) {
+    _spotParallelMain(range + ti);
+  }
+  return;
+}
+
 void spotErrorAdd(const char *fmt, ...) {
   char errstr[PLENTY_BIG_WE_HOPE];
   char **newerr;
@@ -146,9 +209,10 @@ void spotErrorAdd(const char *fmt, ...) {
   unsigned int eidx;
 
   va_start(args, fmt);
-  vsprintf(errstr, fmt, args);
+  vsnprintf(errstr, PLENTY_BIG_WE_HOPE, fmt, args);
   va_end(args);
   
+  pthread_mutex_lock(&_spotErrorLock);
   newerr = (char**)calloc(_spotErrorNum+1, sizeof(char*));
   for (eidx=0; eidx<_spotErrorNum; eidx++) {
     newerr[eidx] = _spotError[eidx];
@@ -157,12 +221,14 @@ void spotErrorAdd(const char *fmt, ...) {
   free(_spotError);
   _spotError = newerr;
   _spotErrorNum++;
+  pthread_mutex_unlock(&_spotErrorLock);
   return;
 }
 
 void spotErrorPrint(void) {
   unsigned int eidx;
 
+  pthread_mutex_lock(&_spotErrorLock);
   if (_spotErrorNum) {
     fprintf(stderr, "ERROR ***\n");
     for (eidx=_spotErrorNum; eidx>=1; eidx--) {
@@ -170,12 +236,14 @@ void spotErrorPrint(void) {
     }
     fprintf(stderr, "ERROR ***\n");
   }
+  pthread_mutex_unlock(&_spotErrorLock);
   return;
 }
 
 void spotErrorClear(void) {
   unsigned int eidx;
   
+  pthread_mutex_lock(&_spotErrorLock);
   if (_spotErrorNum) {
     for (eidx=0; eidx<_spotErrorNum; eidx++) {
       free(_spotError[eidx]);
@@ -184,6 +252,7 @@ void spotErrorClear(void) {
     _spotError = NULL;
     _spotErrorNum = 0;
   }
+  pthread_mutex_unlock(&_spotErrorLock);
   return;
 }
 
@@ -221,10 +290,82 @@ char *spotReadFile(const char *fname) {
   return ret;
 }
 
+int spotGLExtension(const char *name) {
+  GLint num, ii;
+
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num);
+  for (ii=0; ii<num; ii++) {
+    if (!strcmp(name, (const char *)glGetStringi(GL_EXTENSIONS, ii))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* starts compiling a shader; whether it worked is learned (and waited for,
+   if need be) by _spotShaderCheck.  defines (or NULL) is a string of
+   "#define" lines, which are put in right after the "#version" line, and
+   followed by a "#line" to keep the compiler's line numbers right */
+static GLuint _spotShaderSubmit(GLint shtype, const char *shaderTxt,
+                                const char *defines) {
+  GLuint shaderId;
+  const GLchar *str[4];
+  GLint len[4];
+  char line[64];
+  const char *ver, *rest, *cc;
+  unsigned int lineNum;
+
+  shaderId = glCreateShader(shtype);
+  if (!( defines && defines[0] )) {
+    glShaderSource(shaderId, 1, (const GLchar **)(&shaderTxt), NULL);
+  } else {
+    /* nothing but comments and white space may come before #version,
+       and defines have to come after it */
+    rest = shaderTxt;
+    if ((ver = strstr(shaderTxt, "#version"))) {
+      rest = strchr(ver, '\n');
+      rest = rest ? rest + 1 : ver + strlen(ver);
+    }
+    lineNum = 1;
+    for (cc = shaderTxt; cc < rest; cc++) {
+      lineNum += '\n' == *cc;
+    }
+    sprintf(line, "#line %u\n", lineNum);
+    str[0] = shaderTxt; len[0] = (GLint)(rest - shaderTxt);
+    str[1] = defines;   len[1] = (GLint)strlen(defines);
+    str[2] = line;      len[2] = (GLint)strlen(line);
+    str[3] = rest;      len[3] = (GLint)strlen(rest);
+    glShaderSource(shaderId, 4, str, len);
+  }
+  glCompileShader(shaderId);
+  return shaderId;
+}
+
+/* returns 0 if the shader compiled, else records the compiler log and
+   returns 1 */
+static int _spotShaderCheck(GLuint shaderId) {
+  const char me[]="spotShaderNew";
+  GLint status;
+
+  glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
+  if (GL_FALSE == status) {
+    GLint logSize;
+    char *logMsg;
+    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &logSize);
+    if (logSize) {
+      logMsg = (char*)malloc(logSize);
+      glGetShaderInfoLog(shaderId, logSize, NULL, logMsg);
+      spotErrorAdd("%s: shader compiler error:\n%s", me, logMsg);
+      free(logMsg);
+    }
+    return 1;
+  }
+  return 0;
+}
+
 GLint spotShaderNew(GLint shtype, const char *filename) {
   const char me[]="spotShaderNew";
   GLuint shaderId;
-  GLint status;
   char *shaderTxt;
 
   if (!( GL_VERTEX_SHADER == shtype
@@ -238,87 +379,451 @@ GLint spotShaderNew(GLint shtype, const char *filename) {
     spotErrorAdd("%s: trouble reading from \"%s\"", me, filename);
     return 0;
   }
-  shaderId = glCreateShader(shtype);
-  glShaderSource(shaderId, 1, (const GLchar **)(&shaderTxt), NULL);
-  glCompileShader(shaderId);
-  glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
-  if (GL_FALSE == status) {
-    GLint logSize;
-    char *logMsg;
-    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &logSize);
-    if (logSize) {
-      logMsg = (char*)malloc(logSize);
-      glGetShaderInfoLog(shaderId, logSize, NULL, logMsg);
-      spotErrorAdd("%s: shader compiler error:\n%s", me, logMsg);
-      glDeleteShader(shaderId);
-      free(logMsg);
-    }
+  shaderId = _spotShaderSubmit(shtype, shaderTxt, NULL);
+  free(shaderTxt);
+  if (_spotShaderCheck(shaderId)) {
+    glDeleteShader(shaderId);
     return 0;
   }
   return shaderId;
 }
 
-GLint spotProgramNew(const char *vertFileName,
-                     const char *fragFileName,
-                     ...) {
-  const char me[]="spotProgramBuild";
-  va_list vargs;
-  GLuint program, vertId=0, fragId=0, varIndx;
-  GLint status;
-  const char *varName;
-  
-  if (!(vertId = spotShaderNew(GL_VERTEX_SHADER, vertFileName))) {
-    spotErrorAdd("%s: vertex shader error", me);
+/*
+** The program binary cache.  A linked program is stored in
+** _spotProgramCacheDir, in a file named by a hash of everything that went
+** into it: both shader sources, the attribute bindings, and the strings
+** identifying the GL driver.  A file starts with CACHE_MAGIC, then the hash
+** (to catch the odd truncated or misnamed file), the binary format, and the
+** binary length, followed by the binary itself.
+*/
+#define CACHE_MAGIC "SPOTPRG1"
+#define CACHE_ATTR_MAX 32
+
+/* same value for the ARB_parallel_shader_compile GL_COMPLETION_STATUS_ARB */
+#ifndef GL_COMPLETION_STATUS_KHR
+#  define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static char *_spotProgramCacheDir = NULL;
+
+void spotProgramCacheDirSet(const char *dir) {
+  free(_spotProgramCacheDir);
+  _spotProgramCacheDir = spotStrdup(dir);
+}
+
+unsigned long long spotHash(unsigned long long hh, const void *data, size_t len) {
+  const unsigned char *cc = (const unsigned char *)data;
+  size_t ii;
+
+  for (ii=0; ii<len; ii++) {
+    hh ^= cc[ii];
+    hh *= 0x100000001b3ULL;
+  }
+  return hh;
+}
+
+int spotHashFile(unsigned long long *hh, const char *fname) {
+  unsigned char buff[65536];
+  size_t len;
+  FILE *file;
+
+  if (!(file = fopen(fname, "rb"))) {
+    return 1;
+  }
+  while ((len = fread(buff, 1, sizeof(buff), file))) {
+    *hh = spotHash(*hh, buff, len);
+  }
+  fclose(file);
+  return 0;
+}
+
+static unsigned long long _spotHashStr(unsigned long long hh,
+                                       const char *str) {
+  /* including the '\0', so that "ab","c" and "a","bc" differ */
+  return spotHash(hh, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+/* whether glGetProgramBinary/glProgramBinary can be used; learned once */
+static int _spotProgramBinaryCan(void) {
+  static int can = -1;
+  GLint major, minor, formatNum;
+
+  if (-1 == can) {
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    can = 0;
+    if (major > 4 || (4 == major && minor >= 1)
+        || spotGLExtension("GL_ARB_get_program_binary")) {
+      /* some drivers have the API but can't actually save any binaries */
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatNum);
+      can = formatNum > 0;
+    }
+  }
+  return can;
+}
+
+/* whether the driver still lists format among GL_PROGRAM_BINARY_FORMATS; a
+   binary saved by some other driver (or version) may be in one it doesn't */
+static int _spotProgramBinaryFormatCan(GLenum format) {
+  GLint ii, formatNum, *formats;
+  int can = 0;
+
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatNum);
+  if (formatNum > 0 && (formats = (GLint *)malloc(formatNum*sizeof(GLint)))) {
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+    for (ii=0; ii<formatNum && !can; ii++) {
+      can = (GLenum)formats[ii] == format;
+    }
+    free(formats);
+  }
+  return can;
+}
+
+static char *_spotProgramCachePath(unsigned long long hash) {
+  char *path;
+  size_t len;
+
+  len = strlen(_spotProgramCacheDir) + 1 + 16 + strlen(".bin") + 1;
+  if ((path = (char *)malloc(len))) {
+    sprintf(path, "%s/%016llx.bin", _spotProgramCacheDir, hash);
+  }
+  return path;
+}
+
+/* links program from the cache, returning 1 if that worked, or 0 if there
+   isn't a usable binary (which is not an error) */
+static int _spotProgramCacheLoad(GLuint program, unsigned long long hash) {
+  char *path, magic[sizeof(CACHE_MAGIC)-1];
+  unsigned long long fhash;
+  GLenum format;
+  GLint len, status;
+  void *bin;
+  FILE *file;
+  int ret = 0;
+
+  if (!( path = _spotProgramCachePath(hash) )) {
     return 0;
   }
-  if (!(fragId = spotShaderNew(GL_FRAGMENT_SHADER, fragFileName))) {
-    spotErrorAdd("%s: fragment shader error", me);
-    glDeleteShader(vertId); 
+  file = fopen(path, "rb");
+  free(path);
+  if (!file) {
     return 0;
   }
-  program = glCreateProgram();
-  glAttachShader(program, vertId);
-  glAttachShader(program, fragId);
+  bin = NULL;
+  if (1 == fread(magic, sizeof(magic), 1, file)
+      && !memcmp(magic, CACHE_MAGIC, sizeof(magic))
+      && 1 == fread(&fhash, sizeof(fhash), 1, file) && fhash == hash
+      && 1 == fread(&format, sizeof(format), 1, file)
+      && _spotProgramBinaryFormatCan(format)
+      && 1 == fread(&len, sizeof(len), 1, file) && len > 0
+      && (bin = malloc(len))
+      && 1 == fread(bin, len, 1, file)) {
+    glProgramBinary(program, format, bin, len);
+    /* with the format checked above, glProgramBinary shouldn't raise
+       GL_INVALID_ENUM, but if it does that is just a cache miss. Only the
+       one error is read, rather than draining (and so hiding) whatever
+       else GL has noted */
+    if (GL_INVALID_ENUM == glGetError()) {
+      status = GL_FALSE;
+    } else {
+      /* the driver rejects binaries it no longer likes (e.g. after an
+         update that kept the same version string) by failing the link;
+         the program can still be compiled and linked as usual after that */
+      glGetProgramiv(program, GL_LINK_STATUS, &status);
+    }
+    ret = GL_FALSE != status;
+  }
+  free(bin);
+  fclose(file);
+  return ret;
+}
+
+/* saves the binary of a linked program to the cache; failing to do so only
+   costs a compile next time, so it is noted on stderr but not an error */
+static void _spotProgramCacheSave(GLuint program, unsigned long long hash) {
+  const char me[]="spotProgramNew";
+  char *path, *tmpPath;
+  GLenum format;
+  GLint len;
+  void *bin;
+  FILE *file;
+  int bad;
+
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+  if (!( len > 0 && (bin = malloc(len)) )) {
+    return;
+  }
+  glGetProgramBinary(program, len, &len, &format, bin);
+  path = _spotProgramCachePath(hash);
+  tmpPath = path ? (char *)malloc(strlen(path) + strlen(".tmp") + 1) : NULL;
+  if (!tmpPath) {
+    free(path); free(bin);
+    return;
+  }
+  if (mkdir(_spotProgramCacheDir, 0755) && EEXIST != errno) {
+    fprintf(stderr, "%s: couldn't create program cache directory "
+            "\"%s\": %s\n", me, _spotProgramCacheDir, strerror(errno));
+    free(tmpPath); free(path); free(bin);
+    return;
+  }
+  /* written under another name and then renamed, so that another process
+     starting up at the same time never sees half a file */
+  sprintf(tmpPath, "%s.tmp", path);
+  bad = 1;
+  if ((file = fopen(tmpPath, "wb"))) {
+    bad = !( 1 == fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC)-1, 1, file)
+             && 1 == fwrite(&hash, sizeof(hash), 1, file)
+             && 1 == fwrite(&format, sizeof(format), 1, file)
+             && 1 == fwrite(&len, sizeof(len), 1, file)
+             && 1 == fwrite(bin, len, 1, file) );
+    bad |= !!fclose(file);
+    bad = bad || rename(tmpPath, path);
+  }
+  if (bad) {
+    fprintf(stderr, "%s: couldn't save program binary to \"%s\"\n",
+            me, path);
+    remove(tmpPath);
+  }
+  free(tmpPath); free(path); free(bin);
+}
+
+/* whether the GL can be asked if a program is done compiling and linking,
+   without waiting for it; learned once */
+static int _spotProgramParallelCan(void) {
+  static int can = -1;
+
+  if (-1 == can) {
+    /* the ARB version is the same thing under a different name */
+    can = (spotGLExtension("GL_KHR_parallel_shader_compile")
+           || spotGLExtension("GL_ARB_parallel_shader_compile"));
+  }
+  return can;
+}
+
+static spotProgramJob *_spotProgramSubmitV(GLuint program,
+                                           const char *const *defines,
+                                           const char *vertFileName,
+                                           const char *fragFileName,
+                                           va_list vargs) {
+  const char me[]="spotProgramSubmit";
+  spotProgramJob *job;
+  GLuint varIndx[CACHE_ATTR_MAX];
+  const char *varName[CACHE_ATTR_MAX], *name;
+  unsigned int varNum, ii;
+  char *vertTxt=NULL, *fragTxt=NULL, *defTxt=NULL;
+  size_t defLen;
 
   /* process var-args, consisting of pairs of
      1) const char *"variableName"
      2)  GLuint attrIndx
      arguments, until "variableName" is NULL
   */
-  va_start(vargs, fragFileName);
-  for (varName = va_arg(vargs, const char *);
-       varName; 
-       varName = va_arg(vargs, const char *)) {
-    varIndx = va_arg(vargs, GLuint);
-    glBindAttribLocation(program, varIndx, varName);
+  for (varNum = 0;
+       varNum <= CACHE_ATTR_MAX && (name = va_arg(vargs, const char *));
+       varNum++) {
+    if (varNum < CACHE_ATTR_MAX) {
+      varName[varNum] = name;
+      varIndx[varNum] = va_arg(vargs, GLuint);
+    }
+  }
+  if (varNum > CACHE_ATTR_MAX) {
+    spotErrorAdd("%s: can't bind more than %d attributes", me,
+                 CACHE_ATTR_MAX);
+    return NULL;
+  }
+
+  if (!( (vertTxt = spotReadFile(vertFileName))
+         && (fragTxt = spotReadFile(fragFileName)) )) {
+    spotErrorAdd("%s: trouble reading \"%s\" or \"%s\"", me,
+                 vertFileName, fragFileName);
+    free(vertTxt);
+    return NULL;
+  }
+  /* each of the defines ("NAME" or "NAME value") becomes a "#define" line */
+  defLen = 1;
+  for (ii=0; defines && defines[ii]; ii++) {
+    defLen += strlen("#define \n") + strlen(defines[ii]);
+  }
+  if (!( (job = (spotProgramJob *)calloc(1, sizeof(spotProgramJob)))
+         && (defTxt = (char *)malloc(defLen)) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    free(job); free(vertTxt); free(fragTxt);
+    return NULL;
+  }
+  defTxt[0] = '\0';
+  for (ii=0; defines && defines[ii]; ii++) {
+    strcat(defTxt, "#define ");
+    strcat(defTxt, defines[ii]);
+    strcat(defTxt, "\n");
+  }
+
+  job->program = program ? program : glCreateProgram();
+  job->cache = _spotProgramCacheDir && _spotProgramBinaryCan();
+  if (job->cache) {
+    job->hash = _spotHashStr(SPOT_HASH_START, vertTxt);
+    job->hash = _spotHashStr(job->hash, fragTxt);
+    job->hash = _spotHashStr(job->hash, defTxt);
+    for (ii=0; ii<varNum; ii++) {
+      job->hash = _spotHashStr(job->hash, varName[ii]);
+      job->hash = spotHash(job->hash, varIndx + ii, sizeof(GLuint));
+    }
+    job->hash = _spotHashStr(job->hash, (const char *)glGetString(GL_VENDOR));
+    job->hash = _spotHashStr(job->hash,
+                             (const char *)glGetString(GL_RENDERER));
+    job->hash = _spotHashStr(job->hash, (const char *)glGetString(GL_VERSION));
+    if (_spotProgramCacheLoad(job->program, job->hash)) {
+      /* already linked; nothing to save */
+      job->cache = 0;
+      free(vertTxt); free(fragTxt); free(defTxt);
+      return job;
+    }
+  }
+
+  /* Nothing here waits on the compiler: the compile and link status are
+     only asked for by spotProgramFinish */
+  job->vertId = _spotShaderSubmit(GL_VERTEX_SHADER, vertTxt, defTxt);
+  job->fragId = _spotShaderSubmit(GL_FRAGMENT_SHADER, fragTxt, defTxt);
+  free(vertTxt);
+  free(fragTxt);
+  free(defTxt);
+  glAttachShader(job->program, job->vertId);
+  glAttachShader(job->program, job->fragId);
+  for (ii=0; ii<varNum; ii++) {
+    glBindAttribLocation(job->program, varIndx[ii], varName[ii]);
   }
+  if (job->cache) {
+    glProgramParameteri(job->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
+  glLinkProgram(job->program);
+  return job;
+}
+
+spotProgramJob *spotProgramSubmit(const char *vertFileName,
+                                  const char *fragFileName,
+                                  ...) {
+  va_list vargs;
+  spotProgramJob *job;
+
+  va_start(vargs, fragFileName);
+  job = _spotProgramSubmitV(0, NULL, vertFileName, fragFileName, vargs);
+  va_end(vargs);
+  return job;
+}
+
+spotProgramJob *spotProgramSubmitTo(GLuint program,
+                                    const char *const *defines,
+                                    const char *vertFileName,
+                                    const char *fragFileName,
+                                    ...) {
+  va_list vargs;
+  spotProgramJob *job;
+
+  va_start(vargs, fragFileName);
+  job = _spotProgramSubmitV(program, defines, vertFileName, fragFileName,
+                            vargs);
   va_end(vargs);
+  return job;
+}
+
+int spotProgramReady(const spotProgramJob *job) {
+  GLint done;
+
+  if (!job) {
+    return 1;
+  }
+  if (!_spotProgramParallelCan()) {
+    return -1;
+  }
+  glGetProgramiv(job->program, GL_COMPLETION_STATUS_KHR, &done);
+  return GL_FALSE != done;
+}
+
+GLint spotProgramFinish(spotProgramJob *job) {
+  const char me[]="spotProgramBuild";
+  GLuint program;
+  GLint status;
+  int bad;
 
-  glLinkProgram(program);
+  if (!job) {
+    spotErrorAdd("%s: got NULL pointer", me);
+    return 0;
+  }
+  program = job->program;
+  bad = 0;
+  if (job->vertId && _spotShaderCheck(job->vertId)) {
+    spotErrorAdd("%s: vertex shader error", me);
+    bad = 1;
+  } else if (job->fragId && _spotShaderCheck(job->fragId)) {
+    spotErrorAdd("%s: fragment shader error", me);
+    bad = 1;
+  }
+  /* shaders no longer needed post-linking */
+  if (job->vertId) glDeleteShader(job->vertId);
+  if (job->fragId) glDeleteShader(job->fragId);
 
   /* Make sure link worked too */
-  glGetProgramiv(program, GL_LINK_STATUS, &status);
-  if (GL_FALSE == status) {
-    GLint logSize;
-    char *logMsg;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
-    if (logSize) {
-      logMsg = (char*)malloc(logSize);
-      glGetProgramInfoLog(program, logSize, NULL, logMsg);
-      spotErrorAdd("%s: linking error:\n%s", me, logMsg);
-      glDeleteShader(vertId); 
-      glDeleteShader(fragId); 
-      free(logMsg);
-      glDeleteProgram(program);
+  if (!bad) {
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (GL_FALSE == status) {
+      GLint logSize;
+      char *logMsg;
+      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
+      if (logSize) {
+        logMsg = (char*)malloc(logSize);
+        glGetProgramInfoLog(program, logSize, NULL, logMsg);
+        spotErrorAdd("%s: linking error:\n%s", me, logMsg);
+        free(logMsg);
+      }
+      bad = 1;
     }
+  }
+  if (bad) {
+    glDeleteProgram(program);
+    program = 0;
+  } else if (job->cache) {
+    _spotProgramCacheSave(program, job->hash);
+  }
+  free(job);
+  return program;
+}
+
+GLint spotProgramNew(const char *vertFileName,
+                     const char *fragFileName,
+                     ...) {
+  const char me[]="spotProgramBuild";
+  va_list vargs;
+  spotProgramJob *job;
+
+  va_start(vargs, fragFileName);
+  job = _spotProgramSubmitV(0, NULL, vertFileName, fragFileName, vargs);
+  va_end(vargs);
+  if (!job) {
+    spotErrorAdd("%s: couldn't start building program", me);
     return 0;
   }
+  return spotProgramFinish(job);
+}
 
-  /* shaders no longer needed post-linking */
-  glDeleteShader(vertId);
-  glDeleteShader(fragId);
-    
-  return program;
+unsigned int spotProgramAttrMask(GLuint program) {
+  GLint num, ii, size, loc;
+  GLenum type;
+  GLsizei len;
+  GLchar name[128];
+  unsigned int mask;
+
+  mask = 0;
+  num = 0;
+  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &num);
+  for (ii=0; ii<num; ii++) {
+    glGetActiveAttrib(program, ii, sizeof(name), &len, &size, &type, name);
+    /* built-ins like gl_VertexID are listed too, but have location -1 */
+    loc = glGetAttribLocation(program, name);
+    if (0 <= loc && loc < SPOT_VERT_ATTR_NUM) {
+      mask |= 1u << loc;
+    }
+  }
+  return mask;
 }
 
 /* based these strings on "man glGetError */
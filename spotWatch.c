@@ -0,0 +1,155 @@
+/*
+  spot: Utilities for UChicago CMSC 23700 Intro to Computer Graphics
+  Copyright (C) 2012  University of Chicago
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software, to deal in the software without
+  restriction, including without limitation the rights to use, copy,
+  modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the software, and to permit persons to whom the software is
+  furnished to do so, subject to the following condition: the above
+  copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the software.
+*/
+
+#include "spot.h"
+
+#ifdef __linux__
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#  include <errno.h>
+/* Editors often save by writing a new file and renaming it over the old
+   one, which an inotify watch on the old file would never see; so it is
+   the directory that is watched, for files that are finished being written
+   or that are moved or created in it */
+#  define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+#endif
+
+spotWatch *spotWatchNew(void) {
+  const char me[]="spotWatchNew";
+  spotWatch *sw;
+
+#ifdef __linux__
+  sw = (spotWatch *)calloc(1, sizeof(spotWatch));
+  if (!sw) {
+    spotErrorAdd("%s: allocation failure", me);
+    return NULL;
+  }
+  if (-1 == (sw->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC))) {
+    spotErrorAdd("%s: inotify_init1 failed: %s", me, strerror(errno));
+    free(sw);
+    return NULL;
+  }
+#else
+  spotErrorAdd("%s: watching files needs inotify (Linux)", me);
+  sw = NULL;
+#endif
+  return sw;
+}
+
+int spotWatchAdd(spotWatch *sw, const char *fname) {
+  const char me[]="spotWatchAdd";
+#ifdef __linux__
+  char *dir, *slash;
+  const char *base;
+  int wd;
+  void *mem;
+
+  if (!( sw && fname )) {
+    spotErrorAdd("%s: got NULL pointer (%p %p)", me, (void*)sw, (void*)fname);
+    return -1;
+  }
+  if ((slash = strrchr(fname, '/'))) {
+    dir = (char *)malloc(slash - fname + 2);
+    if (!dir) {
+      spotErrorAdd("%s: allocation failure", me);
+      return -1;
+    }
+    /* "/x" is in the root directory */
+    memcpy(dir, fname, slash == fname ? 1 : slash - fname);
+    dir[slash == fname ? 1 : slash - fname] = '\0';
+    base = slash + 1;
+  } else {
+    dir = spotStrdup(".");
+    base = fname;
+  }
+  /* asking again for a directory already watched gives the same wd */
+  wd = inotify_add_watch(sw->fd, dir, WATCH_MASK);
+  if (-1 == wd) {
+    spotErrorAdd("%s: couldn't watch directory \"%s\": %s", me, dir,
+                 strerror(errno));
+    free(dir);
+    return -1;
+  }
+  free(dir);
+  if (!( (mem = realloc(sw->wd, (sw->num+1)*sizeof(int)))
+         && (sw->wd = (int *)mem)
+         && (mem = realloc(sw->base, (sw->num+1)*sizeof(char *)))
+         && (sw->base = (char **)mem)
+         && (mem = realloc(sw->changed, (sw->num+1)*sizeof(int)))
+         && (sw->changed = (int *)mem)
+         && (sw->base[sw->num] = spotStrdup(base)) )) {
+    spotErrorAdd("%s: allocation failure", me);
+    return -1;
+  }
+  sw->wd[sw->num] = wd;
+  sw->changed[sw->num] = 0;
+  return sw->num++;
+#else
+  spotErrorAdd("%s: watching files needs inotify (Linux)", me);
+  return -1;
+#endif
+}
+
+unsigned int spotWatchPoll(spotWatch *sw) {
+  unsigned int ii, ret;
+#ifdef __linux__
+  /* aligned as inotify_event requires */
+  char buff[4096]
+    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  ssize_t len;
+  char *pos;
+
+  if (!sw) {
+    return 0;
+  }
+  /* non-blocking: stops when there are no more events to read */
+  while ((len = read(sw->fd, buff, sizeof(buff))) > 0) {
+    for (pos = buff; pos < buff + len; pos += sizeof(*ev) + ev->len) {
+      ev = (const struct inotify_event *)pos;
+      if (!ev->len) {
+        continue;
+      }
+      for (ii=0; ii<sw->num; ii++) {
+        if (sw->wd[ii] == ev->wd && !strcmp(sw->base[ii], ev->name)) {
+          sw->changed[ii] = 1;
+        }
+      }
+    }
+  }
+#endif
+  ret = 0;
+  for (ii=0; sw && ii<sw->num; ii++) {
+    ret += !!sw->changed[ii];
+  }
+  return ret;
+}
+
+spotWatch *spotWatchNix(spotWatch *sw) {
+  unsigned int ii;
+
+  if (sw) {
+#ifdef __linux__
+    close(sw->fd);
+#endif
+    for (ii=0; ii<sw->num; ii++) {
+      free(sw->base[ii]);
+    }
+    free(sw->wd);
+    free(sw->base);
+    free(sw->changed);
+    free(sw);
+  }
+  return NULL;
+}
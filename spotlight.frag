@@ -15,6 +15,8 @@ uniform float Zv;
 uniform float Zspread;
 
 uniform sampler2D samplerA;
+uniform sampler2DArray samplerArray; // with -a, all the textures, as layers
+uniform int layer;                   // the layer with this object's texture, or -1 for samplerA
 
 in vec2 fragTex;
 in vec3 vnrm;
@@ -74,7 +76,7 @@ void main() {
 	vec3 m = spotUp * dot(spotUp, normalize(l-s));
 	tc.x = rad * sin(m.y);
 	tc.y = rad * cos(m.x);
-	color.rgb = Il * texture(samplerA, tc).rgb;
+	color.rgb = Il * (layer >= 0 ? texture(samplerArray, vec3(tc, layer)) : texture(samplerA, tc)).rgb;
 //	color.r=color.g=color.b=Il;
 	//color.rgb = Il * color.rgb;
 }
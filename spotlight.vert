@@ -2,10 +2,9 @@
 
 // Vertex shader for phong/gouraud shading 
 
-uniform mat4 modelMatrix;
+uniform mat4 modelViewMatrix;  // viewMatrix * modelMatrix
+uniform mat4 mvpMatrix;        // projMatrix * viewMatrix * modelMatrix
 uniform mat3 normalMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
 uniform vec3 lightDir;  // assumed to be unit-length (already normalized)
 uniform vec3 lightColor;
 uniform vec3 objColor;
@@ -34,7 +33,7 @@ out vec3 vertPos2;
 void main() {
 
   // transform vertices 
-  gl_Position = projMatrix * viewMatrix * modelMatrix * vertPos;
+  gl_Position = mvpMatrix * vertPos;
   
   // calculate surface normal in view coords
   vnrm = normalize(normalMatrix * vertNorm);
@@ -43,7 +42,7 @@ void main() {
   fragTex = vertTex2;
 
 	vec3 zero; zero.z=zero.y=zero.z=0;
-	vec3 p = (viewMatrix * modelMatrix * vertPos).xyz;
+	vec3 p = (modelViewMatrix * vertPos).xyz;
 	l = normalize(p-spotPoint);
 	s = normalize(zero-spotPoint);
 
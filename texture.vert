@@ -4,12 +4,18 @@
 
 #define PI 3.14159265358979323846264338327
 
+#ifdef GOURAUD_MODE
+const int gouraudMode = GOURAUD_MODE;
+#else
 uniform int gouraudMode;
+#endif
+#ifdef SEAM_FIX
+const int seamFix = SEAM_FIX;
+#else
 uniform int seamFix;
-uniform mat4 modelMatrix;
+#endif
+uniform mat4 mvpMatrix;        // projMatrix * viewMatrix * modelMatrix
 uniform mat3 normalMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
 uniform vec3 lightDir;  // assumed to be unit-length (already normalized)
 uniform vec3 lightColor;
 uniform vec3 objColor;
@@ -27,10 +33,24 @@ out vec4 fragColor;
 out vec3 texCoord;
 out vec3 vnrm;
 
+// diffuse irradiance from the cube map (over pi, so white gives 1), as 9 spherical harmonic
+// coefficients with their constants folded in; see spotImageCubeMapSH
+layout(std140) uniform Irradiance {
+  vec4 irradianceSH[9];
+};
+
+vec3 irradiance(vec3 n) {
+  return irradianceSH[0].rgb
+    + irradianceSH[1].rgb*n.y + irradianceSH[2].rgb*n.z + irradianceSH[3].rgb*n.x
+    + irradianceSH[4].rgb*(n.x*n.y) + irradianceSH[5].rgb*(n.y*n.z)
+    + irradianceSH[6].rgb*(3.0*n.z*n.z - 1.0) + irradianceSH[7].rgb*(n.x*n.z)
+    + irradianceSH[8].rgb*(n.x*n.x - n.y*n.y);
+}
+
 void main() {
 
   // transform vertices 
-  gl_Position = projMatrix * viewMatrix * modelMatrix * vertPos;
+  gl_Position = mvpMatrix * vertPos;
 
   // set up texture coordinate
   if (seamFix!=0) { // without seam
@@ -53,7 +73,7 @@ void main() {
     float ndotr = max(0, dot(nrm, reflection));
   
     // calculate diffuse, ambient and specular components
-    vec3 amb  = Ka * objColor;
+    vec3 amb  = Ka * objColor * irradiance(nrm);
     vec3 diff = Kd * objColor * lightColor * ndotl;
     vec3 spec = Ks * lightColor * pow(ndotr, shexp);
   
@@ -16,6 +16,8 @@ extern "C" {
 #endif
 
 #include <AntTweakBar.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "spot.h"
 
@@ -35,12 +37,28 @@ extern "C" {
 #define ID_BUMP 4
 #define ID_PARALLAX 5
 #define ID_SPOTLIGHT 6
+// NOTE: the cheap program that is drawn with while the one asked for is still compiling
+#define ID_FALLBACK ID_SIMPLE
+// NOTE: where `spotProgramNew' keeps linked program binaries between runs
+#define SHADER_CACHE_DIR ".shadercache"
 
+// NOTE: a program is built on first use (see `contextProgram'), and is drawn with once Ready
+enum ProgramStates {ProgramUnbuilt, ProgramBuilding, ProgramReady, ProgramBroken};
+// NOTE: each program also has variants, built from the same shaders with #defines that fix the
+//       uniforms named by enum VariantBits (see `contextProgramVariant'); programIds[i +
+//       PROGRAM_STRIDE*(1 + bits)] is the variant of programIds[i] for those bits
+enum VariantBits {VariantGouraud=1, VariantSeamFix=2};
+#define VARIANT_NUM 4
+#define PROGRAM_STRIDE (NUM_PROGRAMS+1)
+#define PROGRAM_SLOTS (PROGRAM_STRIDE*(1+VARIANT_NUM))
+#define PROGRAM_BASE(i) ((i) % PROGRAM_STRIDE)
 enum BumpMappingModes {Disabled, Bump, Parallax};
 enum FilteringModes {Nearest, Linear, NearestWithMipmap, LinearWithMipmap};
 enum Objects {Sphere, Softcube, Cube};
-enum CubeMaps {CubeSample, CubeCool, CubePlace};
+enum CubeMaps {CubeSample, CubeCool, CubePlace, CubeFaces};
 enum Shaders {PhongShader, CubeShader, SpotlightShader};
+enum Textures {TexRgb, TexNorm, TexHght, TexCheck};
+enum ImageKinds {ImageColor, ImageNormal, ImageCubeMap};
 
 /*
 ** The camera_t is a suggested storage place for all the parameters associated
@@ -103,6 +121,8 @@ typedef struct {
   GLint viewMatrix;   /* possible name of view matrix in vertex shader */
   GLint inverseViewMatrix;   /* possible name of view matrix in vertex shader */
   GLint projMatrix;   /* possible name of projection matrix in vertex shader */
+  GLint modelViewMatrix; /* viewMatrix * modelMatrix, computed once per object */
+  GLint mvpMatrix;    /* projMatrix * viewMatrix * modelMatrix, likewise */
   /* ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ */
   GLint spotPoint;    /* point in view space coords that spot comes from */
   GLint penumbra; 
@@ -118,9 +138,118 @@ typedef struct {
   GLint samplerC;     /* possible name of texture sampler in fragment shader */
   GLint samplerD;     /* possible name of texture sampler in fragment shader */
   GLint cubeMap;     /* possible name of texture sampler in fragment shader */
+  GLint samplerArray; /* sampler of the texture array (with -a) in fragment shader */
+  GLint layer;        /* layer of samplerArray with the object's texture, or -1 */
   GLint Zu, Zv, Zspread;
 } uniloc_t;
 
+/*
+** The unishadow_t holds, for one program, the values last given to each of the uniforms of a
+** uniloc_t (indexed by the field's position there), so that contextRender can skip uploading a
+** value the program already has.  A uniform's value is only known once we've set it
+*/
+#define UNISHADOW_NUM (sizeof(uniloc_t)/sizeof(GLint))
+#define UNISHADOW_MAX 16  /* floats in the largest uniform we set (a mat4) */
+typedef struct {
+  GLfloat value[UNISHADOW_NUM][UNISHADOW_MAX];
+  unsigned char known[UNISHADOW_NUM];
+} unishadow_t;
+
+/*
+** The frame_t is a snapshot of everything contextRender needs to draw one frame: contextUpdate
+** does all the CPU work (animation, camera and model matrices) to fill one in, and contextRender
+** only reads it to issue GL calls.  When running with a separate update thread, three of these
+** are passed around by a frameTriple_t (see frame.h), so each is immutable while it is rendered.
+*/
+typedef struct {
+  spotHandle geomH;       /* its geom, which contextRender looks up (see drawGeom) */
+  unsigned int slot;      /* slot of geomH, for the "gi" uniform */
+  GLint layer;            /* layer of the texture array with its texture, or -1 */
+  GLfloat modelMatrix[16], /* from set_model_transform */
+    normalMatrix[9],      /* from updateNormals of modelMatrix */
+    modelMatrixN[16],     /* modelMatrix after norm_M4 */
+    normalMatrixN[9],     /* from updateNormals of modelMatrixN */
+    modelViewMatrix[16],  /* the view matrix times modelMatrix */
+    mvpMatrix[16],        /* the projection matrix times modelViewMatrix */
+    modelViewMatrixN[16], /* likewise for modelMatrixN */
+    mvpMatrixN[16];
+  GLfloat objColor[3], Ka, Kd, Ks, shexp;
+} frameObject_t;
+
+typedef struct {
+  GLuint program,         /* program to use */
+    cubeMapTex,           /* texture ids to bind (or 0) */
+    rgbTex,
+    arrayTex;             /* texture array of the packed 2D textures (with -a) */
+  GLint minFilter, magFilter; /* filtering for rgbTex (or arrayTex) */
+  GLfloat bgColor[3],
+    viewMatrix[16], inverseViewMatrix[16], projMatrix[16],
+    lightDir[3], lightColor[3],
+    spotPoint[3], spotUp[3], penumbra, rStart, rEnd;
+  int gouraudMode, seamFix;
+  int cubeMapId;          /* the cube map (enum CubeMaps) to light with, for ambient */
+  unsigned int sceneGeomOffset; /* first object drawn the second time around */
+  frameObject_t *object;  /* objectNum objects to draw */
+  unsigned int objectNum,
+    objectCap;            /* allocated length of object */
+  int running,            /* copy of context_t->running */
+    animating;            /* the next frame will differ even without input */
+  unsigned int inputSeen; /* value of context_t->inputSent when this was made */
+} frame_t;
+
+/*
+** Three frame_t's, so that the update thread can write one while the render thread reads
+** another, with the third holding the most recently finished one.  Only the index of that
+** third one is shared (atomically); "back" belongs to the update thread and "front" to the
+** render thread.
+*/
+typedef struct {
+  frame_t frame[3];
+  atomic_uint middle;     /* index of middle frame, plus FRAME_FRESH if not yet rendered,
+                             plus the enum Requests bits that go with it, shifted up by
+                             FRAME_REQUEST_SHIFT (so they're handed over together) */
+  unsigned int back,      /* frame being written by update thread */
+    front;                /* frame being read by render thread */
+} frameTriple_t;
+
+/*
+** An input event from a GLFW callback that wasn't handled by AntTweakBar, captured with all
+** the GLFW state (mouse position, shift keys, time) it needs so that it can be handled later,
+** possibly on another thread
+*/
+enum InputTypes {InputKey, InputMouseButton, InputMousePos, InputResize};
+typedef struct {
+  int type,               /* from enum InputTypes */
+    a, b;                 /* key and action, button and action, or width and height */
+  int x, y,               /* mouse position */
+    shift;                /* shift was down */
+  double time;            /* spotTime() when it happened */
+} input_t;
+
+/*
+** Lock-free single-producer (GLFW callbacks) single-consumer (update thread) queue of input
+** events; head and tail only ever increase, and are taken modulo INPUT_QUEUE_LEN to index ev
+*/
+#define INPUT_QUEUE_LEN 256
+typedef struct {
+  input_t ev[INPUT_QUEUE_LEN];
+  atomic_uint head,       /* next to pop; only changed by consumer */
+    tail;                 /* next to push; only changed by producer */
+} inputQueue_t;
+
+/*
+** Things input handlers need done that involve the GL context or AntTweakBar, and hence have
+** to happen on the render thread (see contextRequest)
+*/
+enum Requests {
+  RequestScreenshot = 1<<0,        /* save the next frame drawn */
+  RequestTweakBar = 1<<1,          /* updateTweakBarVars(ctx->tweakBarScene) */
+  RequestTweakBarPos = 1<<2,       /* keep tweak bar at the right edge after resize */
+  RequestPerVertexTexturing = 1<<3, /* perVertexTexturing() */
+  RequestRecord = 1<<4,            /* start or stop saving every frame drawn */
+  RequestGeoms = 1<<5              /* contextGeomsSettle(): GL set-up and removal of geoms */
+};
+
 /*
 ** The context_t is a suggested storage place for what might otherwise be
 ** separate global variables (globals obscure the flow of information and are
@@ -135,16 +264,78 @@ typedef struct {
 typedef struct {
   const char *vertFname,  /* file name of vertex shader */
     *fragFname;           /* file name of fragment shader */
-  spotGeom **geom;        /* array of spotGeom's to render */
-  GLint gi;               /* index of spotGeom object currently in use */
-  unsigned int geomNum;   /* length of geom */
-  spotImage **image;      /* array of texture images to use */
-  unsigned int imageNum;  /* length of image */
+  spotPool *geom;         /* pool of spotGeom's to render */
+  spotArena *arena;       /* holds the CPU-side arrays of the scene's geoms */
+  spotStream *stream;     /* ring buffer for per-frame vertex data */
+  spotHandle gi;          /* handle of spotGeom object currently in use */
+  spotHandle objectH[3];  /* handles of the objects named by enum Objects */
+  spotPool *image;        /* pool of texture images to use */
+  spotHandle textureH[4], /* handles of the 2D textures named by enum Textures */
+    cubeMapH[4];          /* handles of the cube maps named by enum CubeMaps */
+  int pack;               /* pack same-sized 2D textures into texArray (with -a) */
+  spotImageArray *texArray; /* the packed 2D textures, or NULL */
+  int texLayer[4];        /* per enum Textures: its layer in texArray, or -1 */
+  int objectTex[3];       /* per enum Objects: the 2D texture (enum Textures) it shows */
+  GLfloat cubeMapSH[4][9][4]; /* per enum CubeMaps: the irradiance it lights with, from
+                             spotImageCubeMapSH (or white, if it didn't load) */
+  GLuint irradianceBuffer; /* uniform buffer for the "Irradiance" block of the shaders */
+  int irradianceId;       /* the cube map whose cubeMapSH is in irradianceBuffer, or -1 */
   GLfloat bgColor[3];     /* background color */
   GLfloat lightDir[3];    /* direction pointing to light (at infinity) */
   GLfloat lightColor[3];  /* color of light */
   int running;            /* we exit when this is zero */
+  int glReady;            /* contextGLInit has been called */
+  int dirty,              /* something changed, so the next frame must be drawn */
+    continuous;           /* draw every frame regardless (e.g. for benchmarking) */
+  /* ---------------------- Saving frames */
+  spotCapture *capture;   /* reads back the frames to save, and saves them in the background */
+  int captureNext,        /* save the next frame drawn ('D') */
+    recording,            /* save every frame drawn ('R') */
+    captureNum;           /* number of the next "%05d.png" to save to, or -1 until the first */
+  /* ---------------------- Splitting update from render */
+  int threaded;           /* contextUpdate runs on its own thread (updateThread) */
+  frameTriple_t frames;   /* snapshots from contextUpdate for contextRender */
+  inputQueue_t input;     /* input events waiting for the update thread */
+  atomic_uint inputSent;  /* number of input events so far (queued or handled by the tweak bar) */
+  int requestNext;        /* enum Requests bits to go with the next frame from the update thread */
+  int tweakBarScene;      /* argument for RequestTweakBar */
+  spotHandle *geomRemove; /* geoms for RequestGeoms to remove */
+  unsigned int geomRemoveNum, geomRemoveCap;
+  spotGeom **drawGeom;    /* render thread only: the geoms of the frame being drawn */
+  unsigned int drawGeomCap;
+  GLuint unilocProgram;   /* program that uniloc currently points to the locations of */
+  pthread_t updateThread;
+  pthread_mutex_t lock;   /* held by the update thread while it changes the context, and by the
+                             render thread around AntTweakBar, which reads and writes it too */
+  pthread_mutex_t wantLock; /* protects want and updateStop */
+  pthread_cond_t wantCond; /* signaled when want or updateStop is set */
+  int want,               /* render thread wants another frame */
+    updateStop;           /* update thread should finish */
   GLint program;          /* the linked shader program */
+  /* ---------------------- Compiling in the background */
+  spotProgramJob *programJob[PROGRAM_SLOTS]; /* per programIds slot: non-NULL while that
+                             program is ProgramBuilding */
+  int programState[PROGRAM_SLOTS]; /* per programIds slot: enum ProgramStates */
+  unsigned int programNum, /* number of programs (not counting variants) in use */
+    programPending;       /* number of non-NULL programJob */
+  atomic_ullong programWant; /* bit i: programIds[i] has been asked for, so it should be built */
+  int programFallback;    /* the last frame was drawn with the fallback in place of another */
+  int prewarm;            /* build programs nobody has asked for yet, when otherwise idle */
+  int reload;             /* rebuild programs when their shader files are saved */
+  spotWatch *watch;       /* notices when shader files are saved (if reload) */
+  int programWatch[PROGRAM_STRIDE][2]; /* per program (not variant): watch index of its vertex and
+                             fragment shader file */
+  spotProgramJob *programReload[PROGRAM_SLOTS]; /* per programIds slot: non-NULL while a
+                             new program is being built to replace it */
+  GLuint programRetired[PROGRAM_SLOTS]; /* per programIds slot: the program it had before the
+                             last reload (or 0) */
+  int variants;           /* draw with specialized variants when they're ready (not with -u) */
+  int compress;           /* load textures block compressed (with -z) */
+  int programVariable[PROGRAM_STRIDE]; /* per program: enum VariantBits of the uniforms it uses
+                             (so that variants for the others would be the same), or -1 if
+                             not known yet */
+  double programTime;     /* when contextGLInit started building programs (0 once the
+                             startup ones are ready) */
   int winSizeX, winSizeY; /* size of rendering window */
 
   int tbarSizeX,          /* initial width of tweak bar */
@@ -153,7 +344,16 @@ typedef struct {
 
   camera_t camera,        /* a camera */
     spotlight;            /* a spotlight */
-  uniloc_t uniloc;        /* store of uniform locations */
+  uniloc_t unilocs[PROGRAM_SLOTS]; /* per programIds slot: its uniform locations, learned
+                             when it links */
+  const uniloc_t *uniloc; /* those of the program being drawn with */
+  unsigned int programAttrs[PROGRAM_SLOTS]; /* per programIds slot: mask of the vertex
+                             attributes (bit 1 << spotVertAttrIndx_*) its shaders read */
+  unsigned int attrMask;  /* that of the program being drawn with */
+  unishadow_t unishadows[PROGRAM_SLOTS]; /* per programIds slot: its uniform values */
+  unishadow_t *unishadow; /* those of the program being drawn with */
+  unsigned long uniformMiss, /* uniform values uploaded since the scene was set */
+    uniformHit;           /* and not uploaded, since the program already had them */
   model_t model;
 
   int lastX, lastY;       /* coordinates of last known mouse position */
@@ -170,6 +370,8 @@ typedef struct {
   enum BumpMappingModes bumpMappingMode;
   enum FilteringModes filteringMode;
   GLint minFilter, magFilter;
+  GLuint filterTex;       /* texture that filterMin, filterMag were last set on (render thread) */
+  GLint filterMin, filterMag;
   TwBar *tbar;            /* pointer to the parameter "tweak bar" */
   /* (any other information about the state of mouse or keyboard
      input, geometry, camera, transforms, or anything else that may